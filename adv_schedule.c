@@ -0,0 +1,181 @@
+#include "ble_stack.h"
+#include "adv_schedule.h"
+#include "wakeup.h"
+
+#if defined(ADV_SCHEDULE) && ADV_SCHEDULE == 1
+
+#if !defined(ROTATION_JOURNAL) || ROTATION_JOURNAL != 1
+#error "ADV_SCHEDULE needs the rotation journal of ROTATION_JOURNAL=1 to keep the time across resets"
+#endif
+
+#define SECONDS_PER_WEEK ((uint64_t)ADV_SCHEDULE_MINUTES_PER_WEEK * 60)
+
+// 1970-01-01 was a Thursday, three days into the week of the schedule.
+#define EPOCH_WEEK_OFFSET_S (3 * 24 * 60 * 60)
+
+#define TICKS_PER_SECOND COMPAT_APP_TIMER_FREQUENCY
+
+adv_schedule_stats_t adv_schedule_stats;
+
+static adv_schedule_entry_t m_entries[ADV_SCHEDULE_MAX_ENTRIES];
+static uint8_t m_entry_count = 0;
+static int32_t m_drift_ppm;
+
+// Local time at wakeup_start().
+static uint64_t m_start_s;
+
+static const char *const m_day_names[7] = {"Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun"};
+
+// RTC ticks to real ticks: an RTC running drift_ppm fast counts
+// 1 + drift_ppm / 10^6 ticks per real one.
+static uint64_t real_ticks(uint64_t ticks)
+{
+    return ticks - (int64_t)ticks * m_drift_ppm / (1000000 + m_drift_ppm);
+}
+
+// Seconds into the week of the schedule.
+static uint32_t week_seconds(uint64_t local_s)
+{
+    return (local_s + EPOCH_WEEK_OFFSET_S) % SECONDS_PER_WEEK;
+}
+
+// Entry in force at a time of the week: the last one started, or the last of
+// the previous week.
+static uint8_t entry_at(uint32_t week_s)
+{
+    uint8_t entry = m_entry_count - 1;
+
+    for (uint8_t i = 0; i < m_entry_count && (uint32_t)m_entries[i].start_min * 60 <= week_s; i++)
+    {
+        entry = i;
+    }
+
+    return entry;
+}
+
+bool adv_schedule_init(const uint8_t *p_data, const uint8_t *p_end, uint32_t elapsed_s)
+{
+    adv_schedule_header_t header;
+
+    m_entry_count = 0;
+
+    // Right behind the key records, so not aligned.
+    if (p_end - p_data < (ptrdiff_t)sizeof(header))
+    {
+        COMPAT_NRF_LOG_INFO("[SCHEDULE] No room for a schedule");
+        return false;
+    }
+    memcpy(&header, p_data, sizeof(header));
+
+    if (memcmp(header.magic, ADV_SCHEDULE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != ADV_SCHEDULE_VERSION ||
+        header.count == 0 || header.count > ADV_SCHEDULE_MAX_ENTRIES ||
+        p_end - p_data < (ptrdiff_t)(sizeof(header) + header.count * sizeof(adv_schedule_entry_t)) ||
+        header.drift_ppm < -ADV_SCHEDULE_MAX_DRIFT_PPM || header.drift_ppm > ADV_SCHEDULE_MAX_DRIFT_PPM)
+    {
+        COMPAT_NRF_LOG_INFO("[SCHEDULE] No valid schedule header");
+        return false;
+    }
+
+    memcpy(m_entries, p_data + sizeof(header), header.count * sizeof(adv_schedule_entry_t));
+
+    // In order within the week, as the patch step writes them.
+    for (uint8_t i = 0; i < header.count; i++)
+    {
+        if (m_entries[i].start_min >= ADV_SCHEDULE_MINUTES_PER_WEEK ||
+            (i > 0 && m_entries[i].start_min <= m_entries[i - 1].start_min))
+        {
+            COMPAT_NRF_LOG_INFO("[SCHEDULE] Entry %d out of order", i);
+            return false;
+        }
+    }
+
+    m_entry_count = header.count;
+    m_drift_ppm = header.drift_ppm;
+    m_start_s = (uint64_t)header.provisioned + elapsed_s;
+    adv_schedule_stats.entry = UINT8_MAX;
+
+    uint32_t week_s = week_seconds(m_start_s);
+    COMPAT_NRF_LOG_INFO("[SCHEDULE] %d entries, starting %s %02d:%02d, RTC %d ppm fast",
+                        m_entry_count, m_day_names[week_s / 86400], week_s / 3600 % 24, week_s / 60 % 60,
+                        m_drift_ppm);
+    return true;
+}
+
+uint64_t adv_schedule_local_time(uint64_t ticks)
+{
+    return m_start_s + real_ticks(ticks) / TICKS_PER_SECOND;
+}
+
+uint64_t adv_schedule_next(uint64_t ticks)
+{
+    if (m_entry_count == 0)
+    {
+        return WAKEUP_NEVER;
+    }
+
+    uint64_t local_s = adv_schedule_local_time(ticks);
+    uint32_t week_s = week_seconds(local_s);
+    uint8_t next = (entry_at(week_s) + 1) % m_entry_count;
+
+    uint64_t start_s = local_s - week_s + (uint64_t)m_entries[next].start_min * 60;
+    if (start_s <= local_s)
+    {
+        start_s += SECONDS_PER_WEEK;
+    }
+
+    // Back to RTC ticks, then the first tick at or after the start: the
+    // rounding of the correction may be a tick off either way.
+    uint64_t real = (start_s - m_start_s) * TICKS_PER_SECOND;
+    uint64_t next_ticks = real + (int64_t)real * m_drift_ppm / 1000000;
+    while (adv_schedule_local_time(next_ticks) < start_s)
+    {
+        next_ticks++;
+    }
+    while (next_ticks > ticks + 1 && adv_schedule_local_time(next_ticks - 1) >= start_s)
+    {
+        next_ticks--;
+    }
+
+    return next_ticks;
+}
+
+bool adv_schedule_config(uint64_t ticks, const ble_adv_config_t *p_base, ble_adv_config_t *p_config)
+{
+    *p_config = *p_base;
+
+    if (m_entry_count == 0)
+    {
+        return false;
+    }
+
+    uint32_t week_s = week_seconds(adv_schedule_local_time(ticks));
+    uint8_t entry = entry_at(week_s);
+    const adv_schedule_entry_t *p_entry = &m_entries[entry];
+
+    if (p_entry->interval_ms != 0)
+    {
+        p_config->interval_ms = p_entry->interval_ms;
+    }
+    if (p_entry->tx_power != ADV_SCHEDULE_TX_POWER_BOOT)
+    {
+        p_config->tx_power = ble_tx_power_at_most(p_entry->tx_power);
+    }
+
+    adv_schedule_stats.switches += entry != adv_schedule_stats.entry;
+    adv_schedule_stats.entry = entry;
+
+    if (p_entry->flags & ADV_SCHEDULE_OFF)
+    {
+        COMPAT_NRF_LOG_INFO("[SCHEDULE] %s %02d:%02d, entry %d: off",
+                            m_day_names[week_s / 86400], week_s / 3600 % 24, week_s / 60 % 60, entry);
+        return true;
+    }
+
+    COMPAT_NRF_LOG_INFO("[SCHEDULE] %s %02d:%02d, entry %d: every %d ms at %d dBm",
+                        m_day_names[week_s / 86400], week_s / 3600 % 24, week_s / 60 % 60, entry,
+                        p_config->interval_ms, p_config->tx_power);
+    return false;
+}
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef _ADV_SCHEDULE_H_
+#define _ADV_SCHEDULE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// ble_adv_config_t comes from ble_stack.h, include it first.
+
+#if defined(ADV_SCHEDULE) && ADV_SCHEDULE == 1
+
+// Weekly advertising schedule, written behind the key table (or the master key) by
+// tools/adv_records.py --schedule when the image is patched, along with the
+// local time of the patch. The firmware keeps the wall-clock time from the
+// RTC from there, and switches advertising profiles at the minutes of the
+// week the entries start at. Each entry holds until the next one, the last
+// one into the first one of the next week.
+//
+// The time counts from the patch and stands still while the tag is
+// unpowered: the tag is meant to be powered up right after patching, or
+// patched with the time it is going to be powered up at. Across resets it
+// resumes from the rotations in the rotation journal, up to a batch of
+// rotations behind.
+#define ADV_SCHEDULE_MAGIC "HSKS"
+#define ADV_SCHEDULE_VERSION 1
+
+#define ADV_SCHEDULE_MAX_ENTRIES 64
+#define ADV_SCHEDULE_MINUTES_PER_WEEK (7 * 24 * 60)
+
+// Entry TX power that keeps the one of the boot configuration.
+#define ADV_SCHEDULE_TX_POWER_BOOT INT8_MAX
+
+// Entry flags.
+#define ADV_SCHEDULE_OFF 0x01
+
+// Largest drift correction taken from the header. The LFRC is calibrated by
+// the SoftDevice to within 500 ppm; more means a bad measurement.
+#define ADV_SCHEDULE_MAX_DRIFT_PPM 1000
+
+typedef struct {
+    uint8_t magic[4];
+    uint8_t version;
+    uint8_t count;          // Entries following the header
+    int16_t drift_ppm;      // How much faster the RTC of this tag runs than real time
+    uint32_t provisioned;   // Local time of the patch, in seconds since 1970-01-01 00:00
+} adv_schedule_header_t;
+
+_Static_assert(sizeof(adv_schedule_header_t) == 12, "adv_schedule_header_t must match the layout written by tools/adv_records.py.");
+
+typedef struct {
+    uint16_t start_min;     // Minute of the week the entry starts at, 0 is Monday 00:00
+    uint16_t interval_ms;   // Advertising interval, 0 for the one of the boot configuration
+    int8_t tx_power;        // TX power in dBm, or ADV_SCHEDULE_TX_POWER_BOOT
+    uint8_t flags;          // ADV_SCHEDULE_*
+} adv_schedule_entry_t;
+
+_Static_assert(sizeof(adv_schedule_entry_t) == 6, "adv_schedule_entry_t must match the layout written by tools/adv_records.py.");
+
+typedef struct {
+    uint32_t switches;      // Entries switched to since boot
+    uint8_t entry;          // Entry in force
+} adv_schedule_stats_t;
+
+extern adv_schedule_stats_t adv_schedule_stats;
+
+/**@brief Function for loading the schedule, and the time it starts from.
+ *
+ * @param[in] p_data     Schedule header, right behind the key table.
+ * @param[in] p_end      End of the key table region.
+ * @param[in] elapsed_s  Seconds from the patch to wakeup_start(), as far as the firmware knows.
+ *
+ * @return true if there is a valid schedule.
+ */
+bool adv_schedule_init(const uint8_t *p_data, const uint8_t *p_end, uint32_t elapsed_s);
+
+/**@brief Function for getting the next entry start after a time, for the wake-up scheduler.
+ *
+ * @param[in] ticks  RTC ticks since wakeup_start().
+ *
+ * @return RTC ticks since wakeup_start() of the next entry start, WAKEUP_NEVER without a schedule.
+ */
+uint64_t adv_schedule_next(uint64_t ticks);
+
+/**@brief Function for getting the advertising configuration in force at a time.
+ *
+ * @param[in]  ticks     RTC ticks since wakeup_start().
+ * @param[in]  p_base    Boot configuration the entries change.
+ * @param[out] p_config  Configuration of the entry in force.
+ *
+ * @return true if the entry has advertising off.
+ */
+bool adv_schedule_config(uint64_t ticks, const ble_adv_config_t *p_base, ble_adv_config_t *p_config);
+
+/**@brief Function for getting the local time, corrected for the drift of the RTC.
+ *
+ * @param[in] ticks  RTC ticks since wakeup_start().
+ *
+ * @return Local time in seconds since 1970-01-01 00:00.
+ */
+uint64_t adv_schedule_local_time(uint64_t ticks);
+
+#endif
+
+#endif
@@ -0,0 +1,82 @@
+#include "battery_curve.h"
+
+#if BATTERY_CURVE == BATTERY_CURVE_LINEAR
+// The mapping the firmware has always used.
+static const battery_curve_point_t m_curve[] = {
+    {3300, 100},
+    {1800, 0},
+};
+#elif BATTERY_CURVE == BATTERY_CURVE_CR2032
+// Li/MnO2 coin cells hold close to 3 V for most of their life, then fall off
+// steeply; the drop under a radio event grows as the cell empties.
+static const battery_curve_point_t m_curve[] = {
+    {3000, 100},
+    {2900, 90},
+    {2800, 70},
+    {2700, 45},
+    {2600, 25},
+    {2500, 15},
+    {2400, 8},
+    {2200, 3},
+    {2000, 0},
+};
+#elif BATTERY_CURVE == BATTERY_CURVE_CR2477
+static const battery_curve_point_t m_curve[] = {
+    {3000, 100},
+    {2950, 90},
+    {2850, 70},
+    {2750, 45},
+    {2650, 25},
+    {2550, 12},
+    {2450, 6},
+    {2250, 2},
+    {2000, 0},
+};
+#elif BATTERY_CURVE == BATTERY_CURVE_AAA2
+// Alkaline cells fall steadily from 1.6 V to 0.9 V each.
+static const battery_curve_point_t m_curve[] = {
+    {3200, 100},
+    {3000, 85},
+    {2800, 65},
+    {2600, 45},
+    {2400, 25},
+    {2200, 10},
+    {2000, 3},
+    {1800, 0},
+};
+#elif BATTERY_CURVE == BATTERY_CURVE_LIPO
+// VDD sits at the regulator output while the cell is above about 3.4 V, the
+// last 15% or so of its charge, and follows the cell down from there.
+static const battery_curve_point_t m_curve[] = {
+    {3300, 100},
+    {3250, 15},
+    {3200, 8},
+    {3100, 4},
+    {3000, 0},
+};
+#else
+#error "Unknown BATTERY_CURVE"
+#endif
+
+#define CURVE_POINTS (sizeof(m_curve) / sizeof(m_curve[0]))
+
+uint8_t battery_curve_percent(uint16_t vbatt_mv)
+{
+    if (vbatt_mv >= m_curve[0].mv)
+    {
+        return m_curve[0].percent;
+    }
+
+    for (uint8_t i = 1; i < CURVE_POINTS; i++)
+    {
+        const battery_curve_point_t *p_low = &m_curve[i];
+        if (vbatt_mv >= p_low->mv)
+        {
+            const battery_curve_point_t *p_high = &m_curve[i - 1];
+            return p_low->percent + (uint32_t)(vbatt_mv - p_low->mv) * (p_high->percent - p_low->percent) /
+                                        (p_high->mv - p_low->mv);
+        }
+    }
+
+    return m_curve[CURVE_POINTS - 1].percent;
+}
@@ -0,0 +1,33 @@
+#ifndef _BATTERY_CURVE_H_
+#define _BATTERY_CURVE_H_
+
+#include <stdint.h>
+
+// Discharge curves the battery percentage can be read from, selected with
+// BATTERY_CURVE=BATTERY_CURVE_<name> (the BATTERY_CURVE Makefile variable).
+#define BATTERY_CURVE_LINEAR  0     // Straight line from 1.8 V (0%) to 3.3 V (100%)
+#define BATTERY_CURVE_CR2032  1     // Lithium coin cell, at the low currents of a tag
+#define BATTERY_CURVE_CR2477  2     // Larger lithium coin cell, flatter under the same load
+#define BATTERY_CURVE_AAA2    3     // Two alkaline AAA cells in series
+#define BATTERY_CURVE_LIPO    4     // 1S LiPo behind a 3.3 V low-dropout regulator
+
+#ifndef BATTERY_CURVE
+#define BATTERY_CURVE BATTERY_CURVE_LINEAR
+#endif
+
+// Point of a discharge curve. Curves are tables of these, by falling voltage;
+// the charge between two points is interpolated linearly.
+typedef struct {
+    uint16_t mv;
+    uint8_t percent;
+} battery_curve_point_t;
+
+/**@brief Function for looking up the charge left at a battery voltage.
+ *
+ * @details Integer only, so it pulls in no floating point code.
+ *
+ * @return Charge in percent, clamped to the ends of the curve.
+ */
+uint8_t battery_curve_percent(uint16_t vbatt_mv);
+
+#endif
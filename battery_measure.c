@@ -0,0 +1,142 @@
+#include "ble_stack.h"
+#include "battery_measure.h"
+
+#if defined(BATTERY_ASYNC) && BATTERY_ASYNC == 1
+
+#if NRF_SDK_VERSION < 15
+#error "BATTERY_ASYNC needs the SAADC (nRF52 targets)"
+#endif
+
+#include "app_scheduler.h"
+#include "nrfx_saadc.h"
+
+#define BATTERY_SAADC_CHANNEL 0
+
+// VDD through gain 1/6 against the internal 0.6 V reference, 12 bit.
+#define BATTERY_SAADC_FULL_SCALE_MV 3600
+#define BATTERY_SAADC_MAX_VALUE 4096
+
+battery_measure_stats_t battery_measure_stats;
+
+static battery_measure_handler_t m_handler;
+static bool m_busy = false;
+static nrf_saadc_value_t m_sample;
+
+static uint16_t m_history[BATTERY_HISTORY_LEN];
+static uint8_t m_history_len = 0;
+static uint8_t m_history_next = 0;
+
+// Median of the measurements so far, one or BATTERY_HISTORY_LEN of them.
+static uint16_t history_median(void)
+{
+    uint16_t sorted[BATTERY_HISTORY_LEN];
+
+    for (uint8_t i = 0; i < m_history_len; i++)
+    {
+        uint8_t j = i;
+        for (; j > 0 && sorted[j - 1] > m_history[i]; j--)
+        {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = m_history[i];
+    }
+
+    return sorted[(m_history_len - 1) / 2];
+}
+
+// Conversion result, run from the main loop.
+static void battery_measured_evt_handler(void *p_event_data, uint16_t event_size)
+{
+    nrf_saadc_value_t sample = *(const nrf_saadc_value_t *)p_event_data;
+
+    // Powered down until the next measurement.
+    nrfx_saadc_uninit();
+    m_busy = false;
+
+    uint16_t vbatt_mv = sample > 0 ? ((uint32_t)sample * BATTERY_SAADC_FULL_SCALE_MV) / BATTERY_SAADC_MAX_VALUE : 0;
+
+    m_history[m_history_next] = vbatt_mv;
+    m_history_next = (m_history_next + 1) % BATTERY_HISTORY_LEN;
+    if (m_history_len < BATTERY_HISTORY_LEN)
+    {
+        m_history_len++;
+    }
+    battery_measure_stats.measurements++;
+
+    // The first measurement gives the status at boot. The next ones only
+    // count once there are enough of them for the median to outvote a
+    // single low reading.
+    if (m_history_len > 1 && m_history_len < BATTERY_HISTORY_LEN)
+    {
+        COMPAT_NRF_LOG_INFO("[BATTERY] Measured %d mV, %d of %d for the median", vbatt_mv, m_history_len,
+                            BATTERY_HISTORY_LEN);
+        return;
+    }
+
+    uint16_t filtered_mv = history_median();
+    COMPAT_NRF_LOG_INFO("[BATTERY] Measured %d mV, median of last %d: %d mV", vbatt_mv, m_history_len, filtered_mv);
+
+    if (m_handler != NULL)
+    {
+        m_handler(filtered_mv);
+    }
+}
+
+// SAADC interrupt: hand the result over to the main loop.
+static void saadc_event_handler(nrfx_saadc_evt_t const *p_event)
+{
+    if (p_event->type != NRFX_SAADC_EVT_DONE)
+    {
+        return;
+    }
+
+    nrf_saadc_value_t sample = p_event->data.done.p_buffer[0];
+    uint32_t err_code = app_sched_event_put(&sample, sizeof(sample), battery_measured_evt_handler);
+    APP_ERROR_CHECK(err_code);
+}
+
+void battery_measure_init(battery_measure_handler_t handler)
+{
+    m_handler = handler;
+}
+
+void battery_measure_start(void)
+{
+    uint32_t err_code;
+
+    if (m_busy)
+    {
+        battery_measure_stats.busy++;
+        return;
+    }
+
+    // Low power mode keeps the SAADC off until the sample task, the 8x
+    // oversampling averages away the noise of a single conversion. In burst
+    // mode one sample task runs all 8 conversions.
+    nrfx_saadc_config_t config = NRFX_SAADC_DEFAULT_CONFIG;
+    config.resolution = NRF_SAADC_RESOLUTION_12BIT;
+    config.oversample = NRF_SAADC_OVERSAMPLE_8X;
+    config.low_power_mode = true;
+
+    nrf_saadc_channel_config_t channel_config = NRFX_SAADC_DEFAULT_CHANNEL_CONFIG_SE(NRF_SAADC_INPUT_VDD);
+    channel_config.gain = NRF_SAADC_GAIN1_6;
+    channel_config.reference = NRF_SAADC_REFERENCE_INTERNAL;
+    channel_config.acq_time = NRF_SAADC_ACQTIME_10US;
+    channel_config.burst = NRF_SAADC_BURST_ENABLED;
+
+    err_code = nrfx_saadc_init(&config, saadc_event_handler);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = nrfx_saadc_channel_init(BATTERY_SAADC_CHANNEL, &channel_config);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = nrfx_saadc_buffer_convert(&m_sample, 1);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = nrfx_saadc_sample();
+    APP_ERROR_CHECK(err_code);
+
+    m_busy = true;
+}
+
+#endif
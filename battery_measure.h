@@ -0,0 +1,37 @@
+#ifndef _BATTERY_MEASURE_H_
+#define _BATTERY_MEASURE_H_
+
+#include <stdint.h>
+
+#if defined(BATTERY_ASYNC) && BATTERY_ASYNC == 1
+
+// Measurements the reported voltage is the median of, so a single reading
+// taken during a current spike can't flip the battery status. After the one
+// at boot, no voltage is reported until there are that many.
+#define BATTERY_HISTORY_LEN 3
+
+typedef void (*battery_measure_handler_t)(uint16_t vbatt_mv);
+
+typedef struct {
+    uint32_t measurements;  // Conversions completed
+    uint32_t busy;          // Requests made while a conversion was in flight, dropped
+} battery_measure_stats_t;
+
+extern battery_measure_stats_t battery_measure_stats;
+
+/**@brief Function for setting the handler that receives the filtered battery voltage. */
+void battery_measure_init(battery_measure_handler_t handler);
+
+/**@brief Function for starting a battery measurement in the background.
+ *
+ * @details Returns right away. The SAADC is initialised for one oversampled
+ *          conversion of VDD and uninitialised again once it is done; the
+ *          handler is called from the main loop with the first measurement,
+ *          then with the median of the last BATTERY_HISTORY_LEN measurements
+ *          once there are that many.
+ */
+void battery_measure_start(void);
+
+#endif
+
+#endif
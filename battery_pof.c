@@ -0,0 +1,244 @@
+#include "ble_stack.h"
+#include "battery_pof.h"
+
+#if defined(BATTERY_POF) && BATTERY_POF == 1
+
+#if !defined(POWER_GOVERNOR) || POWER_GOVERNOR != 1
+#error "BATTERY_POF needs the advertising steps of POWER_GOVERNOR=1"
+#endif
+
+#if defined(BATTERY_ASYNC) && BATTERY_ASYNC == 1
+#error "BATTERY_POF confirms its warnings with a single synchronous reading, build it with BATTERY_ASYNC=0"
+#endif
+
+#include "app_scheduler.h"
+#include "battery_curve.h"
+#include "nrf_soc.h"
+
+#if NRF_SDK_VERSION >= 15
+#include "nrf_sdh_soc.h"
+
+#define BATTERY_POF_SOC_OBSERVER_PRIO 1
+#endif
+
+typedef struct {
+    uint16_t mv;
+    uint8_t threshold;
+} pof_threshold_t;
+
+// Thresholds of the comparator, by falling voltage.
+static const pof_threshold_t m_thresholds[] = {
+#if defined(NRF51)
+    {2700, NRF_POWER_THRESHOLD_V27},
+    {2500, NRF_POWER_THRESHOLD_V25},
+    {2300, NRF_POWER_THRESHOLD_V23},
+    {2100, NRF_POWER_THRESHOLD_V21},
+#else
+    {2800, NRF_POWER_THRESHOLD_V28},
+    {2700, NRF_POWER_THRESHOLD_V27},
+    {2600, NRF_POWER_THRESHOLD_V26},
+    {2500, NRF_POWER_THRESHOLD_V25},
+    {2400, NRF_POWER_THRESHOLD_V24},
+    {2300, NRF_POWER_THRESHOLD_V23},
+    {2200, NRF_POWER_THRESHOLD_V22},
+    {2100, NRF_POWER_THRESHOLD_V21},
+    {2000, NRF_POWER_THRESHOLD_V20},
+    {1900, NRF_POWER_THRESHOLD_V19},
+    {1800, NRF_POWER_THRESHOLD_V18},
+    {1700, NRF_POWER_THRESHOLD_V17},
+#endif
+};
+
+#define THRESHOLD_COUNT (sizeof(m_thresholds) / sizeof(m_thresholds[0]))
+#define NO_THRESHOLD UINT8_MAX
+
+// Battery percentage set_battery() turns into each status.
+static const uint8_t m_level_percent[BATTERY_POF_LEVELS] = {
+    100,
+    BATTERY_FULL_ABOVE,
+    BATTERY_MEDIUM_ABOVE,
+    BATTERY_LOW_ABOVE,
+};
+
+battery_pof_stats_t battery_pof_stats;
+
+static battery_pof_handler_t m_handler;
+
+// Index in m_thresholds each status is taken at, NO_THRESHOLD for full and
+// for statuses that start below the lowest threshold.
+static uint8_t m_level_threshold[BATTERY_POF_LEVELS];
+
+// Level the armed threshold steps to, and whether its warning is queued or
+// waiting for the battery reading to confirm it.
+static uint8_t m_armed_level;
+static volatile bool m_pending = false;
+
+// Set once a reading dismissed a warning: the cell sags below the threshold
+// under load, and would warn again on the next pulse. Its warnings are
+// ignored until the next daily reading arms the comparator again.
+static volatile bool m_backoff = false;
+
+// Lowest voltage the curve reads above a percentage at.
+static uint16_t curve_mv_above(uint8_t percent)
+{
+    uint16_t low = 0;
+    uint16_t high = UINT16_MAX;
+
+    while (low < high)
+    {
+        uint16_t mid = low + (high - low) / 2;
+        if (battery_curve_percent(mid) > percent)
+        {
+            high = mid;
+        }
+        else
+        {
+            low = mid + 1;
+        }
+    }
+
+    return low;
+}
+
+// Highest threshold at or below the voltage a status starts under, so the
+// warning only comes once the status has been reached.
+static uint8_t threshold_below(uint16_t mv)
+{
+    for (uint8_t i = 0; i < THRESHOLD_COUNT; i++)
+    {
+        if (m_thresholds[i].mv <= mv)
+        {
+            return i;
+        }
+    }
+
+    return NO_THRESHOLD;
+}
+
+// Main loop: the supply dropped below the armed threshold. Statuses sharing
+// it are all reached at once. Warnings stay ignored until the handler's
+// reading arms the comparator again.
+static void pof_evt_handler(void *p_event_data, uint16_t event_size)
+{
+    uint8_t level = m_armed_level;
+
+    battery_pof_stats.warnings++;
+
+    while (level + 1 < BATTERY_POF_LEVELS && m_level_threshold[level + 1] == m_level_threshold[m_armed_level])
+    {
+        level++;
+    }
+
+    COMPAT_NRF_LOG_INFO("[POF] Supply below %d mV", battery_pof_stats.threshold_mv);
+    m_handler(m_level_percent[level]);
+}
+
+// SoC event interrupt: hand the warning over to the main loop, once until it
+// is confirmed or dismissed. The comparator keeps warning while the supply
+// stays low, and on every radio pulse a fresh coin cell sags under.
+static void pof_soc_evt(uint32_t evt_id)
+{
+    if (evt_id != NRF_EVT_POWER_FAILURE_WARNING)
+    {
+        return;
+    }
+
+    if (m_backoff)
+    {
+        battery_pof_stats.suppressed++;
+        return;
+    }
+
+    if (m_pending)
+    {
+        return;
+    }
+
+    m_pending = true;
+    uint32_t err_code = app_sched_event_put(NULL, 0, pof_evt_handler);
+    APP_ERROR_CHECK(err_code);
+}
+
+#if NRF_SDK_VERSION >= 15
+static void battery_pof_on_soc_evt(uint32_t evt_id, void *p_context)
+{
+    pof_soc_evt(evt_id);
+}
+
+NRF_SDH_SOC_OBSERVER(m_battery_pof_soc_observer, BATTERY_POF_SOC_OBSERVER_PRIO,
+                     battery_pof_on_soc_evt, NULL);
+#else
+void battery_pof_on_sys_evt(uint32_t evt_id)
+{
+    pof_soc_evt(evt_id);
+}
+#endif
+
+void battery_pof_init(battery_pof_handler_t handler)
+{
+    m_handler = handler;
+    m_level_threshold[0] = NO_THRESHOLD;
+    battery_pof_stats.level_mv[0] = 0;
+
+    for (uint8_t level = 1; level < BATTERY_POF_LEVELS; level++)
+    {
+        uint16_t mv = curve_mv_above(m_level_percent[level]);
+        uint8_t threshold = threshold_below(mv);
+
+        m_level_threshold[level] = threshold;
+        battery_pof_stats.level_mv[level] = threshold == NO_THRESHOLD ? 0 : m_thresholds[threshold].mv;
+        COMPAT_NRF_LOG_INFO("[POF] Status %d below %d mV, warned at %d mV",
+                            level, mv, battery_pof_stats.level_mv[level]);
+    }
+}
+
+void battery_pof_arm(uint8_t battery_status)
+{
+    uint32_t err_code;
+    uint8_t level = battery_status >> 6;
+
+    // Lower statuses start at lower voltages: once one has no threshold,
+    // none below it has.
+    uint8_t next = level + 1;
+
+    // A warning the status didn't follow was a sag under load, and the
+    // next pulse will warn again: back off until the next daily reading.
+    bool transient = m_pending && next == m_armed_level;
+    if (transient)
+    {
+        battery_pof_stats.transients++;
+        COMPAT_NRF_LOG_INFO("[POF] Warnings ignored until the next reading");
+    }
+    m_backoff = transient;
+    m_pending = false;
+
+    if (next >= BATTERY_POF_LEVELS || m_level_threshold[next] == NO_THRESHOLD)
+    {
+        if (battery_pof_stats.threshold_mv != 0)
+        {
+            COMPAT_NRF_LOG_INFO("[POF] No lower status, comparator off");
+        }
+        battery_pof_stats.threshold_mv = 0;
+        err_code = sd_power_pof_enable(0);
+        APP_ERROR_CHECK(err_code);
+        return;
+    }
+
+    const pof_threshold_t *p_threshold = &m_thresholds[m_level_threshold[next]];
+    m_armed_level = next;
+    if (battery_pof_stats.threshold_mv == p_threshold->mv)
+    {
+        return;
+    }
+
+    battery_pof_stats.threshold_mv = p_threshold->mv;
+
+    err_code = sd_power_pof_threshold_set(p_threshold->threshold);
+    APP_ERROR_CHECK(err_code);
+    err_code = sd_power_pof_enable(1);
+    APP_ERROR_CHECK(err_code);
+
+    COMPAT_NRF_LOG_INFO("[POF] Armed at %d mV for status %d", p_threshold->mv, next);
+}
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef _BATTERY_POF_H_
+#define _BATTERY_POF_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(BATTERY_POF) && BATTERY_POF == 1
+
+// Battery status from the power-fail comparator between the daily ADC
+// readings. Each reading arms the comparator at the supply voltage the next
+// lower status starts at, rounded down to a threshold it supports. The
+// comparator watches VDD all the time, at no CPU wake-up until it trips. It
+// also trips on the radio pulses a coin cell sags under, so a warning only
+// takes the tag to the lower status once a battery reading a while later
+// agrees; otherwise it is dismissed, and as the cell will sag again on the
+// next pulse, further warnings are ignored until the next daily reading.
+//
+// The comparator only warns of falling voltages: the status only goes back up
+// with a daily reading.
+
+// Statuses from full to critically low, as in the status byte.
+#define BATTERY_POF_LEVELS 4
+
+typedef void (*battery_pof_handler_t)(uint8_t battery_level);
+
+typedef struct {
+    uint32_t warnings;          // Warnings taken
+    uint32_t transients;        // Warnings the battery reading didn't confirm
+    uint32_t suppressed;        // Warnings ignored after a transient until the next daily reading
+    uint16_t threshold_mv;      // Threshold armed, 0 with the comparator off
+    uint16_t level_mv[BATTERY_POF_LEVELS];  // Threshold each status is taken at, 0 if the comparator can't
+} battery_pof_stats_t;
+
+extern battery_pof_stats_t battery_pof_stats;
+
+/**@brief Function for working out the thresholds of each status from the discharge curve.
+ *
+ * @details Logs them.
+ *
+ * @param[in] handler  Called from the main loop with a battery percentage of the
+ *                     status a warning stands for. Further warnings are ignored
+ *                     until battery_pof_arm() is called again, with the status
+ *                     the battery reading confirms or the one before.
+ */
+void battery_pof_init(battery_pof_handler_t handler);
+
+/**@brief Function for arming the comparator below a battery status, or turning it off below the last threshold.
+ *
+ * @details Takes warnings again. Called with the status unchanged after a
+ *          warning, counts it as transient and ignores warnings until it is
+ *          called again.
+ *
+ * @param[in] battery_status  STATUS_FLAG_*_BATTERY bits of the status byte.
+ */
+void battery_pof_arm(uint8_t battery_status);
+
+#if NRF_SDK_VERSION < 15
+/**@brief Function for handling the SoftDevice system events, the power failure warning among them.
+ */
+void battery_pof_on_sys_evt(uint32_t evt_id);
+#endif
+
+#endif
+
+#endif
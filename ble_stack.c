@@ -9,92 +9,377 @@ uint8_t adv_handle = BLE_GAP_ADV_SET_HANDLE_NOT_SET;
 #endif
 
 uint8_t status_flag = 0;
-uint8_t bt_addr[6] = {0xFF, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF};
-uint8_t offline_finding_adv[] = {
-	0x1e,		/* Length (30) */
-	0xff,		/* Manufacturer Specific Data (type 0xff) */
-	0x4c, 0x00, /* Company ID (Apple) */
-	0x12, 0x19, /* Offline Finding type and length */
-	0x00,		/* State */
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-	0x00, /* First two bits */
-	0x00, /* Hint (0x00) */
+// Payloads of the current record with the status byte applied, only used
+// while status_flag is non-zero. Otherwise the record is advertised from flash.
+// There are two so a status update can be built in the one the SoftDevice
+// isn't reading and swapped in while advertising keeps running.
+uint8_t offline_finding_adv[2][ADV_RECORD_DATA_LEN];
+size_t offline_finding_adv_len = ADV_RECORD_DATA_LEN;
+
+// Record being advertised and the payload handed to the SoftDevice for it.
+static const adv_record_t *current_record = NULL;
+static const uint8_t *published_adv = NULL;
+
+#if defined(GAPLESS_ROTATION) && GAPLESS_ROTATION == 1
+rotation_gap_t rotation_gap;
+
+// Record to switch to at the end of the current advertising event.
+static const adv_record_t * volatile pending_record = NULL;
+// End of the last advertising event on the old key, while a gap is measured.
+static uint32_t gap_start_ticks;
+static volatile bool gap_measuring = false;
+#endif
+
+#if defined(ADV_FULL_POWER_EVERY)
+// Advertising events since advertising last started or changed keys, counted
+// at the radio notification after each one, and whether the main loop has yet
+// to set the TX power of the next one.
+static volatile uint32_t tx_schedule_events = 0;
+static volatile bool tx_schedule_queued = false;
+#endif
+
+
+// TX power currently applied to the advertising set, INT8_MIN if none yet.
+static int8_t applied_tx_power = INT8_MIN;
+
+// Advertising parameters in use, and the ones to switch to with the next key.
+static ble_adv_config_t adv_config = {
+    .interval_ms = ADVERTISING_INTERVAL,
+    .tx_power = BLE_MAX_TX_POWER,
+    .duration_s = ADV_BURST_DURATION,
+    .channels = ADV_CHANNELS,
+    .channel = ADV_CHANNEL,
 };
-size_t offline_finding_adv_len = sizeof(offline_finding_adv);
+static ble_adv_config_t pending_adv_config;
+static bool adv_config_pending = false;
 
+// Advertising stopped by ble_advertising_pause(), keys and configurations
+// wait for the resume.
+static bool adv_paused = false;
 
-// Set maximum transmit power for advertising or connection
-void ble_set_max_tx_power(void)
+// Offset from channel 37 of the channel the next start of ADV_CHANNELS_ROTATE uses.
+static uint8_t adv_channel_rotation = 0;
+
+#if NRF_SDK_VERSION >= 15
+#define ADV_INTERVAL_MIN BLE_GAP_ADV_INTERVAL_MIN
+#else
+// Before Bluetooth 5, non-connectable advertising can't go below 100 ms.
+#define ADV_INTERVAL_MIN BLE_GAP_ADV_NONCON_INTERVAL_MIN
+#endif
+
+// TX power levels the radio supports, see sd_ble_gap_tx_power_set().
+#if defined(NRF51)
+static const int8_t tx_power_levels[] = { -30, -20, -16, -12, -8, -4, 0, 4 };
+#elif defined(NRF52840_XXAA)
+static const int8_t tx_power_levels[] = { -40, -20, -16, -12, -8, -4, 0, 2, 3, 4, 5, 6, 7, 8 };
+#else
+static const int8_t tx_power_levels[] = { -40, -20, -16, -12, -8, -4, 0, 3, 4 };
+#endif
+
+// Apply a transmit power to advertising. The setting sticks to the advertising
+// set (SDK15) or the stack (SDK12), so unchanged values skip the SoftDevice.
+static void ble_apply_tx_power(int8_t tx_power)
 {
     uint32_t err_code;
-    // Set the transmit power to the maximum allowed by the hardware.
-    static int8_t max_tx_power = -1;
-
-    if (max_tx_power == -1) {
-        int8_t powers[] = { 8, 7, 6, 5, 4 };  // List of possible power levels
-        size_t num_powers = sizeof(powers) / sizeof(powers[0]);
-
-        for (size_t i = 0; i < num_powers; i++) {
-            int8_t tx_power = powers[i];
-            #if NRF_SDK_VERSION >= 15
-            err_code = sd_ble_gap_tx_power_set(BLE_GAP_TX_POWER_ROLE_ADV, adv_handle, tx_power);
-            #else
-            err_code = sd_ble_gap_tx_power_set(tx_power);
-            #endif
-
-            if (err_code == NRF_SUCCESS) {
-                max_tx_power = tx_power;
-                COMPAT_NRF_LOG_INFO("ble_set_max_tx_power: %d dBm", max_tx_power);
-                break;
-            } else {
-                COMPAT_NRF_LOG_INFO("ble_set_max_tx_power: %d dBm failed", tx_power);
-            }
+
+    if (tx_power == applied_tx_power) {
+        return;
+    }
+
+    #if NRF_SDK_VERSION >= 15
+    err_code = sd_ble_gap_tx_power_set(BLE_GAP_TX_POWER_ROLE_ADV, adv_handle, tx_power);
+    #else
+    err_code = sd_ble_gap_tx_power_set(tx_power);
+    #endif
+    APP_ERROR_CHECK(err_code);
+
+    applied_tx_power = tx_power;
+    COMPAT_NRF_LOG_INFO("ble_apply_tx_power: %d dBm", tx_power);
+}
+
+// Set maximum transmit power for advertising
+void ble_set_max_tx_power(void)
+{
+    ble_apply_tx_power(BLE_MAX_TX_POWER);
+}
+
+// Highest TX power level the radio supports up to tx_power, the lowest one below that.
+int8_t ble_tx_power_at_most(int8_t tx_power)
+{
+    int8_t level = tx_power_levels[0];
+    for (size_t i = 0; i < sizeof(tx_power_levels); i++) {
+        if (tx_power_levels[i] <= tx_power && tx_power_levels[i] <= BLE_MAX_TX_POWER) {
+            level = tx_power_levels[i];
+        }
+    }
+    return level;
+}
+
+#if defined(ADV_FULL_POWER_EVERY)
+// TX power of the events between the full-power ones, for a configured tx_power.
+int8_t ble_adv_low_tx_power(int8_t tx_power)
+{
+    return ble_tx_power_at_most(MIN(ADV_LOW_TX_POWER, tx_power));
+}
+#endif
+
+// TX power of the next advertising event.
+static int8_t adv_tx_power_next(void)
+{
+    #if defined(ADV_FULL_POWER_EVERY)
+        if (tx_schedule_events % ADV_FULL_POWER_EVERY != 0) {
+            return ble_adv_low_tx_power(adv_config.tx_power);
         }
+    #endif
+    return adv_config.tx_power;
+}
 
-        // If none of the power levels succeeded, handle the error
-        if (max_tx_power == -1) {
-            APP_ERROR_CHECK(err_code);  // Will trigger an error since err_code is not NRF_SUCCESS
+static bool tx_power_supported(int8_t tx_power)
+{
+    for (size_t i = 0; i < sizeof(tx_power_levels); i++) {
+        if (tx_power_levels[i] == tx_power) {
+            return tx_power <= BLE_MAX_TX_POWER;
         }
-    } else {
-        // max_tx_power has been determined previously, set it directly
-        #if NRF_SDK_VERSION >= 15
-        err_code = sd_ble_gap_tx_power_set(BLE_GAP_TX_POWER_ROLE_ADV, adv_handle, max_tx_power);
-        #else
-        err_code = sd_ble_gap_tx_power_set(max_tx_power);
-        #endif
+    }
+    return false;
+}
+
+static bool adv_channels_valid(const ble_adv_config_t *p_config)
+{
+    switch (p_config->channels) {
+        case ADV_CHANNELS_ALL:
+        case ADV_CHANNELS_ROTATE:
+            return true;
+        case ADV_CHANNELS_SINGLE:
+            return p_config->channel >= ADV_CHANNEL_FIRST && p_config->channel <= ADV_CHANNEL_LAST;
+        default:
+            return false;
+    }
+}
+
+/*
+ * Write the primary channels of the configuration in use into adv_params, right
+ * before advertising starts. ADV_CHANNELS_ROTATE moves on to the next channel
+ * with every start: restarting after every event would wake the CPU each time
+ * and have the SoftDevice send the next event at once, not an interval later.
+ */
+static void ble_adv_channel_mask_update(void)
+{
+    // Channels to leave out, bit 0 for channel 37.
+    uint8_t off;
+
+    switch (adv_config.channels) {
+        case ADV_CHANNELS_SINGLE:
+            off = 0x07 & ~(1 << (adv_config.channel - ADV_CHANNEL_FIRST));
+            break;
+        case ADV_CHANNELS_ROTATE:
+            off = 0x07 & ~(1 << adv_channel_rotation);
+            adv_channel_rotation = (adv_channel_rotation + 1) % 3;
+            break;
+        default:
+            off = 0;
+            break;
+    }
+
+    #if NRF_SDK_VERSION >= 15
+        // Bits 37 to 39 of the 40 bit channel mask.
+        memset(adv_params.channel_mask, 0, sizeof(adv_params.channel_mask));
+        adv_params.channel_mask[4] = off << 5;
+    #else
+        adv_params.channel_mask.ch_37_off = (off >> 0) & 1;
+        adv_params.channel_mask.ch_38_off = (off >> 1) & 1;
+        adv_params.channel_mask.ch_39_off = (off >> 2) & 1;
+    #endif
+}
+
+// Number of primary channels every advertising event of a configuration uses.
+static uint8_t adv_channel_count(const ble_adv_config_t *p_config)
+{
+    return p_config->channels == ADV_CHANNELS_ALL ? 3 : 1;
+}
+
+static void log_adv_channels(void)
+{
+    static const char *const names[] = { "all channels", "channel", "rotating channel" };
+    uint8_t count = adv_channel_count(&adv_config);
+
+    COMPAT_NRF_LOG_INFO("Advertising on %s %d: radio on for about %d us per event (%d us on all channels)",
+            names[adv_config.channels], adv_config.channels == ADV_CHANNELS_SINGLE ? adv_config.channel : count,
+            count * ADV_CHANNEL_RADIO_US, 3 * ADV_CHANNEL_RADIO_US);
+}
+
+// Write the interval and duration of the configuration in use into adv_params.
+static void ble_adv_params_update(void)
+{
+    adv_params.interval = MSEC_TO_UNITS(adv_config.interval_ms, UNIT_0_625_MS);
+    #if NRF_SDK_VERSION >= 15
+        adv_params.duration = adv_config.duration_s * 100;   // 10 ms units
+    #else
+        adv_params.timeout = adv_config.duration_s;
+    #endif
+}
+
+/*
+ * Switch to the configuration set since the last key change, if any.
+ *
+ * @returns true if adv_params changed
+ */
+static bool ble_adv_config_take(void)
+{
+    if (!adv_config_pending) {
+        return false;
+    }
+    adv_config_pending = false;
+
+    bool params_changed = pending_adv_config.interval_ms != adv_config.interval_ms ||
+                          pending_adv_config.duration_s != adv_config.duration_s ||
+                          pending_adv_config.channels != adv_config.channels ||
+                          pending_adv_config.channel != adv_config.channel;
+    adv_config = pending_adv_config;
+    ble_adv_params_update();
+
+    COMPAT_NRF_LOG_INFO("Advertising every %d ms at %d dBm for %d s (0: always)",
+            adv_config.interval_ms, adv_config.tx_power, adv_config.duration_s);
+    log_adv_channels();
+    return params_changed;
+}
+
+// Stop advertising, if it is running.
+static void ble_adv_stop(void)
+{
+    #if NRF_SDK_VERSION >= 15
+        uint32_t err_code = sd_ble_gap_adv_stop(adv_handle);
+    #else
+        uint32_t err_code = sd_ble_gap_adv_stop();
+    #endif
+    // Invalid state is fine if the advertising duration ran out
+    if (err_code != NRF_ERROR_INVALID_STATE) {
         APP_ERROR_CHECK(err_code);
     }
 }
 
+// Restart advertising with adv_params, the address and data stay as they are.
+static void ble_adv_restart(void)
+{
+    uint32_t err_code;
+
+    if (adv_paused) {
+        return;
+    }
+
+    ble_adv_channel_mask_update();
+
+    #if defined(ADV_FULL_POWER_EVERY)
+        tx_schedule_events = 0;
+    #endif
+
+    ble_adv_stop();
+    #if NRF_SDK_VERSION >= 15
+        // Configuring without data clears it, so the published payload goes
+        // along with the new parameters. The set is stopped, so it may be the
+        // buffer it already uses.
+        ble_gap_adv_data_t adv_data;
+        memset(&adv_data, 0, sizeof(adv_data));
+        adv_data.adv_data.p_data = (uint8_t *)published_adv;
+        adv_data.adv_data.len = offline_finding_adv_len;
+        err_code = sd_ble_gap_adv_set_configure(&adv_handle, published_adv != NULL ? &adv_data : NULL, &adv_params);
+        APP_ERROR_CHECK(err_code);
+        err_code = sd_ble_gap_adv_start(adv_handle, APP_BLE_CONN_CFG_TAG);
+        APP_ERROR_CHECK(err_code);
+    #else
+        err_code = sd_ble_gap_adv_start(&adv_params);
+        APP_ERROR_CHECK(err_code);
+    #endif
+}
+
+/*
+ * Change the advertising interval, TX power, duration and channels. They take effect
+ * with the next key, at the end of an advertising event with
+ * GAPLESS_ROTATION, or right away with ble_adv_config_apply().
+ *
+ * @returns NRF_ERROR_INVALID_PARAM if the radio or SoftDevice can't do them
+ */
+uint32_t ble_adv_config_set(const ble_adv_config_t *p_config)
+{
+    uint32_t interval = MSEC_TO_UNITS((uint32_t)p_config->interval_ms, UNIT_0_625_MS);
+
+    if (interval < ADV_INTERVAL_MIN || interval > BLE_GAP_ADV_INTERVAL_MAX ||
+        p_config->duration_s > BLE_ADV_DURATION_MAX_S || !tx_power_supported(p_config->tx_power) ||
+        !adv_channels_valid(p_config)) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    pending_adv_config = *p_config;
+    adv_config_pending = true;
+    return NRF_SUCCESS;
+}
+
+/*
+ * Get the advertising configuration, the one waiting for the next key if
+ * there is one.
+ */
+void ble_adv_config_get(ble_adv_config_t *p_config)
+{
+    *p_config = adv_config_pending ? pending_adv_config : adv_config;
+}
+
+/*
+ * Apply the configuration set since the last key change to the current key
+ * now, restarting advertising if the interval or duration changed.
+ */
+void ble_adv_config_apply(void)
+{
+    // Before the first key, it is picked up by ble_set_advertisement_key.
+    if (current_record == NULL) {
+        return;
+    }
+
+    if (ble_adv_config_take()) {
+        ble_adv_restart();
+    }
+    ble_apply_tx_power(adv_tx_power_next());
+}
+
 /*
- * set_addr_from_key will set the bluetooth address from the first 6 bytes of the key used to be advertised
+ * Advertise the current key again, for the configured duration. Applies the
+ * configuration set since the last key change.
  */
-static void set_addr_from_key(const char *key)
+void ble_advertising_restart(void)
 {
-	/* copy first 6 bytes */
-	bt_addr[5] = key[0] | 0b11000000;
-	bt_addr[4] = key[1];
-	bt_addr[3] = key[2];
-	bt_addr[2] = key[3];
-	bt_addr[1] = key[4];
-	bt_addr[0] = key[5];
+    if (current_record == NULL) {
+        return;
+    }
+
+    ble_adv_config_take();
+    ble_adv_restart();
+    ble_apply_tx_power(adv_tx_power_next());
 }
 
 /*
- * fill_adv_template_from_key will set the advertising data based on the remaining bytes from the advertised key
+ * Stop advertising until resumed. Keys and configurations set in the meantime
+ * go on air with the resume, which advertises for the configured duration.
  */
-static void fill_adv_template_from_key(const char *key)
+void ble_advertising_pause(bool pause)
 {
-	memcpy(&offline_finding_adv[7], &key[6], 22);
-	offline_finding_adv[29] = key[0] >> 6;
+    if (pause == adv_paused) {
+        return;
+    }
+    adv_paused = pause;
+
+    if (pause) {
+        ble_adv_stop();
+        COMPAT_NRF_LOG_INFO("Advertising paused");
+    } else if (current_record != NULL) {
+        // Before the first key, that starts advertising.
+        ble_advertising_restart();
+        COMPAT_NRF_LOG_INFO("Advertising resumed");
+    }
 }
 
 /**
  * Set the Bluetooth MAC address.
  */
-static void ble_set_mac_address(uint8_t *addr)
+static void ble_set_mac_address(const uint8_t *addr)
 {
     ble_gap_addr_t gap_addr;
     uint32_t err_code;
@@ -123,6 +408,160 @@ static void ble_set_mac_address(uint8_t *addr)
 }
 
 
+/**
+ * Get the payload to advertise for a record with the given status byte.
+ *
+ * The payload is built in the RAM buffer that isn't published right now. The
+ * S130 copies the payload, so with a zero status it advertises the record
+ * straight from flash. The S132 reads the buffer in place with EasyDMA, which
+ * only reaches RAM.
+ */
+static const uint8_t *ble_build_adv_payload(const adv_record_t *record, uint8_t status)
+{
+    #if NRF_SDK_VERSION < 15
+        if (status == 0) {
+            return record->data;
+        }
+    #endif
+
+    uint8_t *p_adv = offline_finding_adv[published_adv == offline_finding_adv[0] ? 1 : 0];
+    memcpy(p_adv, record->data, offline_finding_adv_len);
+    p_adv[6] = status;
+    return p_adv;
+}
+
+/**
+ * Swap the payload of the running advertising set. The address and the
+ * advertising parameters stay as they are, so advertising doesn't stop.
+ */
+static void ble_publish_adv_payload(const uint8_t *p_adv)
+{
+    uint32_t err_code;
+
+    #if NRF_SDK_VERSION >= 15
+        // Passing no parameters only replaces the data. The SoftDevice needs a
+        // new buffer for that and releases the old one when the call returns.
+        ble_gap_adv_data_t adv_data;
+        memset(&adv_data, 0, sizeof(adv_data));
+        adv_data.adv_data.p_data = (uint8_t *)p_adv;
+        adv_data.adv_data.len = offline_finding_adv_len;
+        err_code = sd_ble_gap_adv_set_configure(&adv_handle, &adv_data, NULL);
+    #else
+        // The S130 copies the payload and uses it from the next event on.
+        err_code = sd_ble_gap_adv_data_set(p_adv, offline_finding_adv_len, NULL, 0);
+    #endif
+    APP_ERROR_CHECK(err_code);
+
+    published_adv = p_adv;
+}
+
+#if (defined(GAPLESS_ROTATION) && GAPLESS_ROTATION == 1) || defined(ADV_FULL_POWER_EVERY)
+/*
+ * Radio notifications are only enabled from the rotation request until the
+ * first advertising event on the new key, so the device doesn't wake up after
+ * every advertising event. The TX power schedule keeps them on.
+ */
+static void radio_notification_enable(bool enable)
+{
+    #if defined(ADV_FULL_POWER_EVERY)
+        enable = true;
+    #endif
+
+    uint32_t err_code = sd_radio_notification_cfg_set(
+            enable ? NRF_RADIO_NOTIFICATION_TYPE_INT_ON_INACTIVE : NRF_RADIO_NOTIFICATION_TYPE_NONE,
+            NRF_RADIO_NOTIFICATION_DISTANCE_NONE);
+    APP_ERROR_CHECK(err_code);
+}
+
+static void radio_notification_init(void)
+{
+    uint32_t err_code;
+
+    err_code = sd_nvic_ClearPendingIRQ(RADIO_NOTIFICATION_IRQn);
+    APP_ERROR_CHECK(err_code);
+
+    // The handler only queues an event for the main loop.
+    err_code = sd_nvic_SetPriority(RADIO_NOTIFICATION_IRQn, APP_IRQ_PRIORITY_LOW);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = sd_nvic_EnableIRQ(RADIO_NOTIFICATION_IRQn);
+    APP_ERROR_CHECK(err_code);
+}
+
+#if defined(GAPLESS_ROTATION) && GAPLESS_ROTATION == 1
+/**
+ * Runs from the main loop after the radio went idle at the end of an
+ * advertising event, with the app_timer counter at that time. The next event
+ * is a full advertising interval away, so the key is swapped here without
+ * cutting an event short.
+ */
+static void radio_inactive_evt_handler(void *p_event_data, uint16_t event_size)
+{
+    uint32_t event_end = *(const uint32_t *)p_event_data;
+
+    if (pending_record != NULL) {
+        const adv_record_t *record = pending_record;
+        pending_record = NULL;
+
+        gap_start_ticks = event_end;
+        gap_measuring = true;
+        ble_set_advertisement_key(record);
+    } else if (gap_measuring) {
+        // First event on the new key is over.
+        uint32_t gap = COMPAT_APP_TIMER_CNT_DIFF(event_end, gap_start_ticks);
+        gap_measuring = false;
+        radio_notification_enable(false);
+
+        rotation_gap.count++;
+        rotation_gap.last_ticks = gap;
+        rotation_gap.max_ticks = MAX(rotation_gap.max_ticks, gap);
+
+        COMPAT_NRF_LOG_INFO("Rotation gap: %d ms (max %d ms, advertising interval %d ms)",
+                COMPAT_APP_TIMER_TICKS_TO_MS(gap),
+                COMPAT_APP_TIMER_TICKS_TO_MS(rotation_gap.max_ticks),
+                adv_config.interval_ms);
+    }
+}
+#endif
+
+#if defined(ADV_FULL_POWER_EVERY)
+// Runs from the main loop between advertising events, to set the TX power of the next one.
+static void tx_schedule_evt_handler(void *p_event_data, uint16_t event_size)
+{
+    tx_schedule_queued = false;
+
+    if (current_record != NULL) {
+        ble_apply_tx_power(adv_tx_power_next());
+    }
+}
+#endif
+
+// Raised by the SoftDevice when the radio goes idle, see radio_notification_enable().
+void RADIO_NOTIFICATION_IRQHandler(void)
+{
+    uint32_t err_code;
+
+    #if defined(GAPLESS_ROTATION) && GAPLESS_ROTATION == 1
+        // Only a rotation in progress waits for the end of the event.
+        if (pending_record != NULL || gap_measuring) {
+            uint32_t event_end = COMPAT_APP_TIMER_CNT_GET();
+
+            err_code = app_sched_event_put(&event_end, sizeof(event_end), radio_inactive_evt_handler);
+            APP_ERROR_CHECK(err_code);
+        }
+    #endif
+
+    #if defined(ADV_FULL_POWER_EVERY)
+        // The power only changes for the full-power event and the one after it.
+        if (++tx_schedule_events % ADV_FULL_POWER_EVERY <= 1 && !tx_schedule_queued) {
+            tx_schedule_queued = true;
+            err_code = app_sched_event_put(NULL, 0, tx_schedule_evt_handler);
+            APP_ERROR_CHECK(err_code);
+        }
+    #endif
+}
+#endif
+
 /**@brief Function for initializing the Advertising functionality.
  *
  * @details Encodes the required advertising data and passes it to the stack.
@@ -132,13 +571,21 @@ void ble_advertising_init(void)
 {
     memset(&adv_params, 0, sizeof(adv_params));
 
+    #if (defined(GAPLESS_ROTATION) && GAPLESS_ROTATION == 1) || defined(ADV_FULL_POWER_EVERY)
+        radio_notification_init();
+    #endif
+    #if defined(ADV_FULL_POWER_EVERY)
+        radio_notification_enable(true);
+        COMPAT_NRF_LOG_INFO("TX power schedule: 1 in %d advertising events at %d dBm, the others at %d dBm",
+                ADV_FULL_POWER_EVERY, adv_config.tx_power, ble_adv_low_tx_power(adv_config.tx_power));
+    #endif
+
     #if NRF_SDK_VERSION >= 15
         // Set the advertising type to non-connectable.
         adv_params.properties.type = BLE_GAP_ADV_TYPE_NONCONNECTABLE_NONSCANNABLE_UNDIRECTED;
-        // Set advertising interval (in 0.625 ms units).
-        adv_params.interval = MSEC_TO_UNITS(ADVERTISING_INTERVAL, UNIT_0_625_MS);
-        // Set advertising timeout to zero (no timeout).
-        adv_params.duration = 0;
+        // Set advertising interval (in 0.625 ms units), duration and channels.
+        ble_adv_params_update();
+        ble_adv_channel_mask_update();
         // Set the filter policy to allow all.
         adv_params.filter_policy = BLE_GAP_ADV_FP_ANY;
         // No specific peer address.
@@ -149,29 +596,39 @@ void ble_advertising_init(void)
         // Call the API to configure and start advertising.
         int err_code = sd_ble_gap_adv_set_configure(&adv_handle, NULL, &adv_params);
         APP_ERROR_CHECK(err_code);
+
+        // The advertising set exists now, apply its TX power once.
+        ble_apply_tx_power(adv_tx_power_next());
     #else
         // Set the advertising parameters.
         adv_params.type = BLE_GAP_ADV_TYPE_ADV_NONCONN_IND;
         adv_params.p_peer_addr = NULL;
         adv_params.fp = BLE_GAP_ADV_FP_ANY;
-        // Set the advertising interval (in units of 0.625 ms).
-        adv_params.interval = MSEC_TO_UNITS(ADVERTISING_INTERVAL, UNIT_0_625_MS);
-        adv_params.timeout = 0;
+        // Set the advertising interval (in units of 0.625 ms), timeout and channels.
+        ble_adv_params_update();
+        ble_adv_channel_mask_update();
         sd_ble_gap_adv_start(&adv_params);
+
+        ble_apply_tx_power(adv_tx_power_next());
     #endif
+
+    log_adv_channels();
 }
 
 /*
  * set_advertisement_key will setup the key to be advertised
  *
- * @param[in] key public key to be advertised
+ * @param[in] record precomputed address and payload of the key to be advertised
  *
  * @returns raw data size
  */
-uint8_t ble_set_advertisement_key(const char *key)
+uint8_t ble_set_advertisement_key(const adv_record_t *record)
 {
-
     #if NRF_SDK_VERSION >= 15
+        // A new configuration goes on air with the new key, adv_params are
+        // configured with every key anyway.
+        ble_adv_config_take();
+
         if (adv_handle != BLE_GAP_ADV_SET_HANDLE_NOT_SET) {
             int err_code = sd_ble_gap_adv_stop(adv_handle);
             if (err_code != NRF_ERROR_INVALID_STATE) // Invalid state is fine if no advertisement is running
@@ -181,52 +638,99 @@ uint8_t ble_set_advertisement_key(const char *key)
         }
     #endif
 
-    set_addr_from_key(key);
-   	fill_adv_template_from_key(key);
+    // The record already carries a zero status byte; only a non-zero status
+    // needs a RAM copy of the payload.
+    const uint8_t *p_adv = ble_build_adv_payload(record, status_flag);
 
-	ble_set_mac_address(bt_addr);
+	ble_set_mac_address(record->addr);
 
     #if NRF_SDK_VERSION >= 15
         // Set advertising data
 	    ble_gap_adv_data_t adv_data;
         memset(&adv_data, 0, sizeof(adv_data));
-        // Set advertising data
-        adv_data.adv_data.p_data = offline_finding_adv;
+        // The SoftDevice only reads the payload, which may live in flash.
+        adv_data.adv_data.p_data = (uint8_t *)p_adv;
         adv_data.adv_data.len = offline_finding_adv_len;
         // No scan response data in this case (NULL and length 0).
         adv_data.scan_rsp_data.p_data = NULL;
         adv_data.scan_rsp_data.len = 0;
-        // Initialize advertising parameters as before (assumed to be done previously)
+        // Initialize advertising parameters as before, on the channels of this start
+        ble_adv_channel_mask_update();
         uint32_t err_code = sd_ble_gap_adv_set_configure(&adv_handle, &adv_data, &adv_params);
         APP_ERROR_CHECK(err_code);
 
         // Start advertising (also assumed done previously)
-        err_code = sd_ble_gap_adv_start(adv_handle, APP_BLE_CONN_CFG_TAG);
-        APP_ERROR_CHECK(err_code);
+        if (!adv_paused) {
+            err_code = sd_ble_gap_adv_start(adv_handle, APP_BLE_CONN_CFG_TAG);
+            APP_ERROR_CHECK(err_code);
+        }
     #else
-        uint32_t err_code = sd_ble_gap_adv_data_set(offline_finding_adv, offline_finding_adv_len, NULL, 0);
+        uint32_t err_code = sd_ble_gap_adv_data_set(p_adv, offline_finding_adv_len, NULL, 0);
 	    APP_ERROR_CHECK(err_code);
+
+        // The S130 keeps advertising across key changes. A new configuration
+        // needs a restart, and so do a duration that ran out since the last
+        // key and a rotating channel.
+        if (ble_adv_config_take() || adv_config.duration_s != 0 || adv_config.channels == ADV_CHANNELS_ROTATE) {
+            ble_adv_restart();
+        }
     #endif
 
-    // Set the maximum transmit power for advertising.
-    ble_set_max_tx_power();
+    current_record = record;
+    published_adv = p_adv;
+
+    #if defined(ADV_FULL_POWER_EVERY)
+        // The first event on a new key goes out at full power.
+        tx_schedule_events = 0;
+    #endif
+
+    // Set the transmit power for advertising.
+    ble_apply_tx_power(adv_tx_power_next());
 
 	return offline_finding_adv_len;
 }
 
+/*
+ * Switch advertising to a new key. With GAPLESS_ROTATION the switch waits for
+ * the end of the current advertising event; the first key is set right away.
+ *
+ * @param[in] record precomputed address and payload of the key to be advertised
+ */
+void ble_rotate_advertisement_key(const adv_record_t *record)
+{
+    #if defined(GAPLESS_ROTATION) && GAPLESS_ROTATION == 1
+        // With an advertising duration, or paused, there may be no event left to wait for.
+        if (current_record != NULL && adv_config.duration_s == 0 && !adv_paused) {
+            pending_record = record;
+            radio_notification_enable(true);
+            return;
+        }
+    #endif
+
+    ble_set_advertisement_key(record);
+}
+
+/*
+ * Publish a new status byte for the current key right away. Before the first
+ * key is advertised it is only picked up by ble_set_advertisement_key.
+ */
 void _set_status(uint8_t status)
 {
-	offline_finding_adv[6] = status;
+    if (current_record == NULL || published_adv[6] == status) {
+        return;
+    }
+
+    ble_publish_adv_payload(ble_build_adv_payload(current_record, status));
 }
 
 void set_battery(uint8_t battery_level)
 {
     status_flag &= (~STATUS_FLAG_BATTERY_MASK);
-    if(battery_level > 80){
+    if(battery_level > BATTERY_FULL_ABOVE){
         // do nothing
-    }else if(battery_level > 50){
+    }else if(battery_level > BATTERY_MEDIUM_ABOVE){
         status_flag |= STATUS_FLAG_MEDIUM_BATTERY;
-    }else if(battery_level > 30){
+    }else if(battery_level > BATTERY_LOW_ABOVE){
         status_flag |= STATUS_FLAG_LOW_BATTERY;
     }else{
         status_flag |= STATUS_FLAG_CRITICALLY_LOW_BATTERY;
@@ -236,6 +740,11 @@ void set_battery(uint8_t battery_level)
 	_set_status(status_flag);
 }
 
+uint8_t get_battery_status(void)
+{
+    return status_flag & STATUS_FLAG_BATTERY_MASK;
+}
+
 void set_status(uint8_t status)
 {
 	status_flag &= (~STATUS_FLAG_COUNTER_MASK);
@@ -39,11 +39,151 @@
 #define STATUS_FLAG_LOW_BATTERY            0b10000000
 #define STATUS_FLAG_CRITICALLY_LOW_BATTERY 0b11000000
 
+// Battery percentages above which set_battery() reports full, medium and low.
+#define BATTERY_FULL_ABOVE   80
+#define BATTERY_MEDIUM_ABOVE 50
+#define BATTERY_LOW_ABOVE    30
+
 #ifndef ADVERTISING_INTERVAL
 #define ADVERTISING_INTERVAL 1000
 #endif
 
+// Highest advertising TX power (dBm) accepted by each chip and SoftDevice,
+// so it doesn't have to be probed at runtime.
+#ifndef BLE_MAX_TX_POWER
+#if defined(NRF51) && defined(S130)
+#define BLE_MAX_TX_POWER 4
+#elif defined(NRF52810_XXAA) && defined(S112)
+#define BLE_MAX_TX_POWER 4
+#elif defined(NRF52832_XXAA) && defined(S132)
+#define BLE_MAX_TX_POWER 4
+#elif defined(NRF52840_XXAA) && defined(S140)
+#define BLE_MAX_TX_POWER 8
+#else
+#error "Unknown chip/SoftDevice combination, define BLE_MAX_TX_POWER."
+#endif
+#endif
+
+// Burst advertising: advertise for ADV_BURST_DURATION seconds, ADV_BURSTS
+// times per rotation interval, and leave the radio off in between. 0 to
+// advertise all the time.
+#ifndef ADV_BURST_DURATION
+#define ADV_BURST_DURATION 0
+#endif
+
+#ifndef ADV_BURSTS
+#define ADV_BURSTS 1
+#endif
+
+// TX power schedule: 1 in ADV_FULL_POWER_EVERY advertising events goes out at
+// the configured TX power, starting with the first one on each key, and the
+// others at ADV_LOW_TX_POWER (to the next level the radio supports, and never
+// above the configured power). The power is switched between events, at the
+// radio notification after each one. Undefined to send every event at the
+// configured power.
+#if defined(ADV_FULL_POWER_EVERY)
+#ifndef ADV_LOW_TX_POWER
+#define ADV_LOW_TX_POWER -12
+#endif
+_Static_assert(ADV_FULL_POWER_EVERY >= 2, "ADV_FULL_POWER_EVERY must be at least 2.");
+#endif
+
+// Primary advertising channel profiles: every event on all three channels,
+// on ADV_CHANNEL only, or on one channel that moves on each time advertising
+// starts (with every key and burst). Selected with ADV_CHANNELS=ADV_CHANNELS_<name>
+// (the ADV_CHANNELS Makefile variable), and at runtime with ble_adv_config_set().
+#define ADV_CHANNELS_ALL    0
+#define ADV_CHANNELS_SINGLE 1
+#define ADV_CHANNELS_ROTATE 2
+
+#ifndef ADV_CHANNELS
+#define ADV_CHANNELS ADV_CHANNELS_ALL
+#endif
+
+#ifndef ADV_CHANNEL
+#define ADV_CHANNEL 37
+#endif
+
+#define ADV_CHANNEL_FIRST 37
+#define ADV_CHANNEL_LAST  39
+
+// Radio time of one transmission of the advertising PDU on a channel, in us:
+// ramp-up, then preamble, access address, header, address, payload and CRC
+// (1 + 4 + 2 + 6 + 31 + 3 bytes) at 1 Mbps.
+#define ADV_RADIO_RAMP_UP_US 140
+#define ADV_PDU_AIR_US ((1 + 4 + 2 + ADV_RECORD_ADDR_LEN + ADV_RECORD_DATA_LEN + 3) * 8)
+#define ADV_CHANNEL_RADIO_US (ADV_RADIO_RAMP_UP_US + ADV_PDU_AIR_US)
+
+// Longest advertising duration, in seconds: the S132/S112 take it in 10 ms
+// units, the S130 in seconds.
+#if NRF_SDK_VERSION >= 15
+#define BLE_ADV_DURATION_MAX_S (UINT16_MAX / 100)
+#else
+#define BLE_ADV_DURATION_MAX_S 0x3FFF
+#endif
+
+#define ADV_RECORD_ADDR_LEN 6
+#define ADV_RECORD_DATA_LEN 31
+
+/*
+ * Advertising parameters that can change at runtime, see ble_adv_config_set().
+ * They start out as ADVERTISING_INTERVAL, BLE_MAX_TX_POWER, ADV_BURST_DURATION,
+ * ADV_CHANNELS and ADV_CHANNEL.
+ */
+typedef struct {
+    uint16_t interval_ms;   // Advertising interval
+    int8_t tx_power;        // Advertising TX power in dBm, a level the radio supports
+    uint16_t duration_s;    // Seconds to advertise for after each rotation, 0 to advertise all the time
+    uint8_t channels;       // ADV_CHANNELS_* profile
+    uint8_t channel;        // Channel of ADV_CHANNELS_SINGLE, 37 to 39
+} ble_adv_config_t;
+
+/*
+ * Ready-to-advertise record for one key, precomputed by tools/adv_records.py
+ * when the image is patched: the random static address (least significant
+ * byte first, as in ble_gap_addr_t) followed by the complete advertising
+ * payload with a zero status byte.
+ */
+typedef struct {
+    uint8_t addr[ADV_RECORD_ADDR_LEN];
+    uint8_t data[ADV_RECORD_DATA_LEN];
+} adv_record_t;
+
+#if (defined(GAPLESS_ROTATION) && GAPLESS_ROTATION == 1) || defined(ADV_FULL_POWER_EVERY)
+#include "nrf_nvic.h"
+#include "app_util_platform.h"
+#include "app_scheduler.h"
+#endif
+
+#if defined(GAPLESS_ROTATION) && GAPLESS_ROTATION == 1
+
+/*
+ * Time from the end of the last advertising event on the old key to the end
+ * of the first one on the new key, measured with radio notifications. As both
+ * ends are event ends, it is the time between the last transmission of the
+ * old key and the first of the new one.
+ */
+typedef struct {
+    uint32_t count;         // Rotations measured
+    uint32_t last_ticks;    // Gap of the last rotation, in app_timer ticks
+    uint32_t max_ticks;     // Largest gap seen
+} rotation_gap_t;
+
+extern rotation_gap_t rotation_gap;
+#endif
+
 void ble_advertising_init(void);
 void ble_set_max_tx_power(void);
+int8_t ble_tx_power_at_most(int8_t tx_power);
+#if defined(ADV_FULL_POWER_EVERY)
+int8_t ble_adv_low_tx_power(int8_t tx_power);
+#endif
+uint32_t ble_adv_config_set(const ble_adv_config_t *p_config);
+void ble_adv_config_get(ble_adv_config_t *p_config);
+void ble_adv_config_apply(void);
+void ble_advertising_restart(void);
+void ble_advertising_pause(bool pause);
 void set_battery(uint8_t battery_level);
-uint8_t ble_set_advertisement_key(const char *key);
\ No newline at end of file
+uint8_t get_battery_status(void);
+uint8_t ble_set_advertisement_key(const adv_record_t *record);
+void ble_rotate_advertisement_key(const adv_record_t *record);
\ No newline at end of file
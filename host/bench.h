@@ -0,0 +1,64 @@
+/*
+ * Shared part of the host benchmark, see bench_rotation.c.
+ *
+ * The checks of each feature are in bench_<feature>.c. They reach the statics
+ * of main.c, so they are included into the one translation unit that
+ * compiles it, behind the harness helpers declared here.
+ */
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef BENCH_VARIANT
+#define BENCH_VARIANT "host"
+#endif
+
+#ifndef BENCH_KEYS
+#define BENCH_KEYS 50
+#endif
+
+#define BENCH_DEFAULT_ROTATIONS 20000
+
+#if defined(ADV_SCHEDULE) && ADV_SCHEDULE == 1
+// Entries of the schedule in bench_schedule.c.
+#define BENCH_SCHEDULE_ENTRIES 4
+#define BENCH_SCHEDULE_LEN (sizeof(adv_schedule_header_t) + BENCH_SCHEDULE_ENTRIES * sizeof(adv_schedule_entry_t))
+#else
+#define BENCH_SCHEDULE_LEN 0
+#endif
+
+// Key table region with room for exactly BENCH_KEYS keys, and the schedule
+// behind them, which is less than a key.
+static uint8_t key_region[sizeof(adv_keys_header_t) + BENCH_KEYS * sizeof(adv_record_t) + BENCH_SCHEDULE_LEN]
+    __attribute__((section("adv_keys"), used, aligned(4)));
+
+#if defined(ROTATION_JOURNAL) && ROTATION_JOURNAL == 1
+#define BENCH_JOURNAL_SLOTS (SD_STUB_FLASH_PAGE_SIZE / sizeof(rotation_journal_record_t))
+
+// The two journal pages at the end of flash.
+static uint8_t journal_region[2 * SD_STUB_FLASH_PAGE_SIZE]
+    __attribute__((section("rotation_journal"), used, aligned(SD_STUB_FLASH_PAGE_SIZE)));
+#endif
+
+// RTC at the start of the wake-up scheduler, the rotations count from it.
+static uint32_t m_wakeup_start_ticks;
+
+/* Harness, bench_rotation.c */
+static uint64_t now_ns(void);
+static void key_to_record(const uint8_t key[28], adv_record_t *record);
+static void verify_advertised(int index);
+static void settle_rotation(void);
+static void fire_until_within(uint8_t job, uint32_t max_wakeups);
+static void fire_until(uint8_t job);
+static void fire_rotation_timer(void);
+static int on_air_index(void);
+static int check_adv_config_on_air(const ble_adv_config_t *p_config);
+
+/* Key table or master key, bench_keys.c */
+static void expected_key(int index, uint8_t key[28]);
+
+#endif // BENCH_H
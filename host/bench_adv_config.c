@@ -0,0 +1,168 @@
+/*
+ * Host benchmark: runtime advertising configuration and channel profiles, see bench.h.
+ */
+
+static int check_adv_config(void)
+{
+    static const ble_adv_config_t invalid[] = {
+        {.interval_ms = 10, .tx_power = 0, .duration_s = 0},
+        {.interval_ms = 20000, .tx_power = 0, .duration_s = 0},
+        {.interval_ms = 1000, .tx_power = 1, .duration_s = 0},
+        {.interval_ms = 1000, .tx_power = BLE_MAX_TX_POWER + 4, .duration_s = 0},
+        {.interval_ms = 1000, .tx_power = 0, .duration_s = BLE_ADV_DURATION_MAX_S + 1},
+        {.interval_ms = 1000, .tx_power = 0, .duration_s = 0, .channels = ADV_CHANNELS_SINGLE, .channel = 36},
+        {.interval_ms = 1000, .tx_power = 0, .duration_s = 0, .channels = ADV_CHANNELS_ROTATE + 1},
+    };
+    const ble_adv_config_t defaults = {
+        .interval_ms = ADVERTISING_INTERVAL, .tx_power = BLE_MAX_TX_POWER, .duration_s = ADV_BURST_DURATION,
+        .channels = ADV_CHANNELS, .channel = ADV_CHANNEL,
+    };
+    const ble_adv_config_t slow = {.interval_ms = 2000, .tx_power = -8, .duration_s = 0};
+    const ble_adv_config_t burst = {.interval_ms = 500, .tx_power = 0, .duration_s = 5};
+    ble_adv_config_t config;
+
+    if (check_adv_config_on_air(&defaults) != 0) {
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        if (ble_adv_config_set(&invalid[i]) != NRF_ERROR_INVALID_PARAM) {
+            fprintf(stderr, "%s: advertising configuration %u accepted\n", BENCH_VARIANT, (unsigned)i);
+            return 1;
+        }
+    }
+
+    // A new configuration waits for the next key.
+    sd_stub_reset_stats();
+    if (ble_adv_config_set(&slow) != NRF_SUCCESS || sd_stub_softdevice_calls() != 0 ||
+        check_adv_config_on_air(&defaults) != 0) {
+        fprintf(stderr, "%s: advertising configuration applied before the next key\n", BENCH_VARIANT);
+        return 1;
+    }
+    ble_adv_config_get(&config);
+    if (memcmp(&config, &slow, sizeof(config)) != 0) {
+        fprintf(stderr, "%s: pending advertising configuration not reported\n", BENCH_VARIANT);
+        return 1;
+    }
+    fire_rotation_timer();
+    settle_rotation();
+    if (check_adv_config_on_air(&slow) != 0) {
+        return 1;
+    }
+
+    // Or is applied to the current key. Advertising stops once the duration
+    // is over and comes back with the next key.
+    if (ble_adv_config_set(&burst) != NRF_SUCCESS) {
+        return 1;
+    }
+    ble_adv_config_apply();
+    if (check_adv_config_on_air(&burst) != 0) {
+        return 1;
+    }
+    // With the payload of the key on air.
+    verify_advertised(on_air_index());
+    sd_stub_reset_stats();
+    for (int i = 0; i < 4 * burst.duration_s * 1000 / burst.interval_ms && sd_stub_advertising; i++) {
+        sd_stub_adv_event();
+    }
+    uint32_t burst_events = sd_stub_stats.adv_events;
+    if (sd_stub_advertising || burst_events != burst.duration_s * 1000 / burst.interval_ms) {
+        fprintf(stderr, "%s: %u advertising events in a %u s burst\n", BENCH_VARIANT,
+                (unsigned)burst_events, (unsigned)burst.duration_s);
+        return 1;
+    }
+    fire_rotation_timer();
+    settle_rotation();
+    if (check_adv_config_on_air(&burst) != 0) {
+        return 1;
+    }
+
+    if (ble_adv_config_set(&defaults) != NRF_SUCCESS) {
+        return 1;
+    }
+    ble_adv_config_apply();
+    if (check_adv_config_on_air(&defaults) != 0) {
+        return 1;
+    }
+    verify_advertised(on_air_index());
+
+    printf("%-40s advertising configuration applied with the next key or on request, "
+           "%u events in a %u s burst\n", BENCH_VARIANT, (unsigned)burst_events, (unsigned)burst.duration_s);
+    return 0;
+}
+
+// Advertising events per transmission of the payload, over a few events.
+static uint32_t channels_per_event(void)
+{
+    const int events = 30;
+
+    sd_stub_reset_stats();
+    for (int i = 0; i < events && sd_stub_advertising; i++) {
+        sd_stub_adv_event();
+    }
+    return sd_stub_stats.adv_events == events ? sd_stub_stats.adv_channel_tx / events : 0;
+}
+
+static int check_adv_channels(void)
+{
+    ble_adv_config_t normal;
+    ble_adv_config_get(&normal);
+    ble_adv_config_t config = normal;
+    config.duration_s = 0;
+
+    // All three channels, then only channel 38.
+    config.channels = ADV_CHANNELS_ALL;
+    if (ble_adv_config_set(&config) != NRF_SUCCESS) {
+        return 1;
+    }
+    ble_adv_config_apply();
+    uint32_t all = channels_per_event();
+
+    config.channels = ADV_CHANNELS_SINGLE;
+    config.channel = 38;
+    if (ble_adv_config_set(&config) != NRF_SUCCESS) {
+        return 1;
+    }
+    ble_adv_config_apply();
+    uint32_t before = sd_stub_adv_channel_events[1];
+    uint32_t single = channels_per_event();
+    if (all != 3 || single != 1 || check_adv_config_on_air(&config) != 0 ||
+        sd_stub_adv_channel_events[1] - before != sd_stub_stats.adv_events) {
+        fprintf(stderr, "%s: %u and %u transmissions per event on all channels and channel 38\n",
+                BENCH_VARIANT, (unsigned)all, (unsigned)single);
+        return 1;
+    }
+
+    // A rotating channel moves on with every key, or burst, and covers all three.
+    config.channels = ADV_CHANNELS_ROTATE;
+    if (ble_adv_config_set(&config) != NRF_SUCCESS) {
+        return 1;
+    }
+    ble_adv_config_apply();
+    uint8_t seen = 0;
+    for (int i = 0; i < 3; i++) {
+        if (check_adv_config_on_air(&config) != 0 || (seen & sd_stub_adv_channels) != 0 ||
+            channels_per_event() != 1) {
+            fprintf(stderr, "%s: rotating channel repeated after %d keys\n", BENCH_VARIANT, i);
+            return 1;
+        }
+        seen |= sd_stub_adv_channels;
+#if ADV_BURST_DURATION > 0 && ADV_BURSTS > 1
+        fire_until(m_burst_job);
+#else
+        fire_rotation_timer();
+#endif
+        settle_rotation();
+    }
+
+    if (ble_adv_config_set(&normal) != NRF_SUCCESS) {
+        return 1;
+    }
+    ble_adv_config_apply();
+    if (check_adv_config_on_air(&normal) != 0) {
+        return 1;
+    }
+
+    printf("%-40s %u transmissions per event on all channels, %u on one: radio on for about %d us instead of %d\n",
+           BENCH_VARIANT, (unsigned)all, (unsigned)single, ADV_CHANNEL_RADIO_US, 3 * ADV_CHANNEL_RADIO_US);
+    return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * Host benchmark: battery curve and background measurement, see bench.h.
+ */
+
+#if defined(BATTERY_LEVEL) && BATTERY_LEVEL == 1
+// The percentage the firmware computed in double precision before the
+// discharge curves, 1.8 V to 3.3 V.
+static uint8_t linear_percent(uint16_t vbatt_mv)
+{
+    if (vbatt_mv < 1800) {
+        return 0;
+    }
+    uint16_t vbatt = MIN(vbatt_mv, 3300.0);
+    return (uint16_t)((vbatt - 1800.0) / (3300.0 - 1800.0) * 100);
+}
+
+static int check_battery_curve(void)
+{
+    static const uint8_t levels[] = {80, 50, 30};
+    uint16_t level_mv[sizeof(levels)] = {0};
+    uint8_t last = 0;
+    int max_delta = 0;
+
+    for (uint32_t mv = 0; mv <= 4000; mv++) {
+        uint8_t percent = battery_curve_percent(mv);
+        int delta = abs((int)percent - (int)linear_percent(mv));
+        if (percent > 100 || percent < last) {
+            fprintf(stderr, "%s: battery curve at %u mV gives %u%% after %u%%\n", BENCH_VARIANT,
+                    (unsigned)mv, percent, last);
+            return 1;
+        }
+#if BATTERY_CURVE == BATTERY_CURVE_LINEAR
+        // The integer curve may only round where the double math did.
+        if (delta > 1) {
+            fprintf(stderr, "%s: battery curve at %u mV gives %u%%, linear mapping %u%%\n", BENCH_VARIANT,
+                    (unsigned)mv, percent, linear_percent(mv));
+            return 1;
+        }
+#endif
+        for (size_t i = 0; i < sizeof(levels); i++) {
+            if (percent <= levels[i]) {
+                level_mv[i] = mv;
+            }
+        }
+        max_delta = MAX(max_delta, delta);
+        last = percent;
+    }
+
+    printf("%-40s battery curve %d: up to %d%% from the linear mapping, "
+           "medium below %u mV, low below %u mV, critical below %u mV\n",
+           BENCH_VARIANT, BATTERY_CURVE, max_delta, level_mv[0] + 1, level_mv[1] + 1, level_mv[2] + 1);
+    return 0;
+}
+#endif
+
+#if defined(BATTERY_ASYNC) && BATTERY_ASYNC == 1
+// Run one background measurement to completion, return the battery status flags.
+static uint8_t battery_measure_once(void)
+{
+    battery_measure_start();
+    settle_rotation();
+    return sd_stub_adv_data[6] & STATUS_FLAG_BATTERY_MASK;
+}
+
+// The first battery measurement must not hold up the first advertisement:
+// it is still running once the firmware sleeps, with the SAADC in low
+// power mode, oversampling in a single burst. It is powered down once done.
+static int check_battery_async_boot(void)
+{
+    if (!sd_stub_saadc_initialized || battery_measure_stats.measurements != 0 || sd_stub_stats.battery_reads != 0 ||
+        !sd_stub_saadc_config.low_power_mode || sd_stub_saadc_config.oversample != NRF_SAADC_OVERSAMPLE_8X ||
+        sd_stub_saadc_channel_config.burst != NRF_SAADC_BURST_ENABLED) {
+        fprintf(stderr, "%s: battery measurement not started in the background\n", BENCH_VARIANT);
+        return 1;
+    }
+    settle_rotation();
+    if (sd_stub_saadc_initialized || battery_measure_stats.measurements != 1 ||
+        (sd_stub_adv_data[6] & STATUS_FLAG_BATTERY_MASK) != STATUS_FLAG_MEDIUM_BATTERY) {
+        fprintf(stderr, "%s: battery measurement not completed\n", BENCH_VARIANT);
+        return 1;
+    }
+    // A low second reading, with only the one from boot to outvote it, must
+    // not change the status.
+    sd_stub_saadc_noise_mv = -1000;
+    battery_measure_start();
+    settle_rotation();
+    if (battery_measure_stats.measurements != 2 ||
+        (sd_stub_adv_data[6] & STATUS_FLAG_BATTERY_MASK) != STATUS_FLAG_MEDIUM_BATTERY) {
+        fprintf(stderr, "%s: noisy second battery reading changed the status\n", BENCH_VARIANT);
+        return 1;
+    }
+    return 0;
+}
+
+static int check_battery_async(void)
+{
+    uint32_t measurements = battery_measure_stats.measurements;
+
+    // A request made while a conversion is in flight is dropped.
+    battery_measure_start();
+    battery_measure_start();
+    settle_rotation();
+    if (battery_measure_stats.busy != 1 || battery_measure_stats.measurements != measurements + 1 ||
+        sd_stub_saadc_initialized) {
+        fprintf(stderr, "%s: overlapping battery measurement not dropped\n", BENCH_VARIANT);
+        return 1;
+    }
+
+    // A single low reading, as during a radio event, must not change the status.
+    for (int i = 0; i < BATTERY_HISTORY_LEN; i++) {
+        battery_measure_once();
+    }
+    uint8_t status = sd_stub_adv_data[6] & STATUS_FLAG_BATTERY_MASK;
+    sd_stub_saadc_noise_mv = -1000;
+    if (battery_measure_once() != status) {
+        fprintf(stderr, "%s: single noisy battery reading changed the status\n", BENCH_VARIANT);
+        return 1;
+    }
+
+    // A sustained one must, as soon as it is the median.
+    for (int i = 0; i < BATTERY_HISTORY_LEN; i++) {
+        battery_measure_once();
+    }
+    uint16_t vbatt_mv = sd_stub_vbatt_mv;
+    sd_stub_vbatt_mv = 2000;
+    int readings = 1;
+    while (battery_measure_once() != STATUS_FLAG_CRITICALLY_LOW_BATTERY && readings < BATTERY_HISTORY_LEN) {
+        readings++;
+    }
+    sd_stub_vbatt_mv = vbatt_mv;
+    if (readings != BATTERY_HISTORY_LEN / 2 + 1) {
+        fprintf(stderr, "%s: low battery reported after %d readings\n", BENCH_VARIANT, readings);
+        return 1;
+    }
+
+    printf("%-40s battery %u measurements, low status after %d readings\n",
+           BENCH_VARIANT, (unsigned)battery_measure_stats.measurements, readings);
+    return 0;
+}
+#endif
@@ -0,0 +1,180 @@
+/*
+ * Host benchmark: battery status from the power-fail comparator, see bench.h.
+ */
+
+#if defined(BATTERY_POF) && BATTERY_POF == 1
+// Highest comparator threshold at or below a voltage, 0 if there is none.
+static uint16_t pof_floor_mv(uint16_t mv)
+{
+#if defined(NRF51)
+    return mv < 2100 ? 0 : MIN(2700, 2100 + (mv - 2100) / 200 * 200);
+#else
+    return mv < 1700 ? 0 : MIN(2800, mv / 100 * 100);
+#endif
+}
+
+// Threshold expected below a battery status: the floor of the voltage the
+// next one starts under on the curve, 0 below critically low.
+static uint16_t pof_expected_mv(uint8_t level)
+{
+    static const uint8_t above[POWER_GOVERNOR_LEVELS] = {100, BATTERY_FULL_ABOVE, BATTERY_MEDIUM_ABOVE,
+                                                         BATTERY_LOW_ABOVE};
+    if (level + 1 >= POWER_GOVERNOR_LEVELS) {
+        return 0;
+    }
+    uint16_t mv = 5000;
+    while (mv > 0 && battery_curve_percent(mv - 1) > above[level + 1]) {
+        mv--;
+    }
+    return pof_floor_mv(mv);
+}
+
+// Fires the confirmation timer of a warning taken, for the battery reading of
+// the main loop.
+static int pof_confirm(uint16_t threshold_mv)
+{
+    if (!m_pof_confirm_timer_id->running || m_pof_confirm_timer_id->ticks != BATTERY_POF_CONFIRM_TICKS) {
+        fprintf(stderr, "%s: warning below %u mV not confirmed %u s later\n", BENCH_VARIANT,
+                (unsigned)threshold_mv, (unsigned)BATTERY_POF_CONFIRM_DELAY);
+        return 1;
+    }
+    sd_stub_reset_stats();
+    sd_stub_timer_fire(m_pof_confirm_timer_id);
+    settle_rotation();
+    return 0;
+}
+
+// The comparator steps the status and the governor down once a battery
+// reading confirms the supply dropped below the threshold armed, and leaves
+// them alone after a sag under load until the next daily reading.
+static int check_battery_pof(void)
+{
+    if (m_battery_job == UINT8_MAX) {
+        fprintf(stderr, "%s: no daily battery reading with the comparator\n", BENCH_VARIANT);
+        return 1;
+    }
+    if (!sd_stub_pof_enabled || sd_stub_pof_threshold_mv != pof_expected_mv(0) ||
+        battery_pof_stats.threshold_mv != sd_stub_pof_threshold_mv) {
+        fprintf(stderr, "%s: comparator %s at %u mV with a full battery, expected %u mV\n", BENCH_VARIANT,
+                sd_stub_pof_enabled ? "on" : "off", (unsigned)sd_stub_pof_threshold_mv,
+                (unsigned)pof_expected_mv(0));
+        return 1;
+    }
+
+    // A supply sagging to the threshold doesn't trip it.
+    if (sd_stub_supply_drop(sd_stub_pof_threshold_mv)) {
+        fprintf(stderr, "%s: comparator tripped at its threshold\n", BENCH_VARIANT);
+        return 1;
+    }
+
+    // A fresh coin cell sagging below the threshold during a radio pulse reads
+    // full again by the time it is confirmed: nothing changes, and the
+    // comparator stays armed where it was.
+    uint16_t full_mv = sd_stub_pof_threshold_mv;
+    ble_adv_config_t full;
+    governor_config(0, &full);
+    sd_stub_vbatt_mv = governor_level_mv[0];
+    if (!sd_stub_supply_drop(full_mv - 1)) {
+        fprintf(stderr, "%s: comparator did not trip below %u mV\n", BENCH_VARIANT, (unsigned)full_mv);
+        return 1;
+    }
+    settle_rotation();
+    if (pof_confirm(full_mv) != 0) {
+        return 1;
+    }
+    if ((sd_stub_adv_data[6] & STATUS_FLAG_BATTERY_MASK) != 0 || power_governor_stats.level != 0 ||
+        check_adv_config_on_air(&full) != 0 || sd_stub_stats.battery_reads != 1 ||
+        battery_pof_stats.transients != 1 || !sd_stub_pof_enabled || sd_stub_pof_threshold_mv != full_mv) {
+        fprintf(stderr, "%s: sag below %u mV under load changed the status\n", BENCH_VARIANT, (unsigned)full_mv);
+        return 1;
+    }
+
+    // The cell sags on every pulse: its warnings are only counted, without a
+    // reading, until the next daily one takes them again.
+    sd_stub_reset_stats();
+    if (!sd_stub_supply_drop(full_mv - 1) || !sd_stub_supply_drop(full_mv - 1)) {
+        fprintf(stderr, "%s: comparator off after a sag below %u mV\n", BENCH_VARIANT, (unsigned)full_mv);
+        return 1;
+    }
+    settle_rotation();
+    if (sd_stub_stats.sched_events != 0 || sd_stub_stats.battery_reads != 0 || m_pof_confirm_timer_id->running ||
+        battery_pof_stats.suppressed != 2) {
+        fprintf(stderr, "%s: warnings after a sag queued %u events, %u readings, %u suppressed\n", BENCH_VARIANT,
+                (unsigned)sd_stub_stats.sched_events, (unsigned)sd_stub_stats.battery_reads,
+                (unsigned)battery_pof_stats.suppressed);
+        return 1;
+    }
+    fire_until_within(m_battery_job, wakeup_count(WAKEUP_ALL_JOBS, DAY_TICKS));
+    settle_rotation();
+    if (!sd_stub_pof_enabled || sd_stub_pof_threshold_mv != full_mv) {
+        fprintf(stderr, "%s: comparator not armed at %u mV by the daily reading\n", BENCH_VARIANT, (unsigned)full_mv);
+        return 1;
+    }
+
+    uint32_t warnings = battery_pof_stats.warnings;
+    for (uint8_t level = 1; level < POWER_GOVERNOR_LEVELS; level++) {
+        uint16_t threshold_mv = sd_stub_pof_threshold_mv;
+        ble_adv_config_t expected;
+
+        // The interrupt queues one event for however many warnings, and calls
+        // neither the SoftDevice nor the ADC.
+        sd_stub_reset_stats();
+        if (!sd_stub_supply_drop(threshold_mv - 1) || !sd_stub_supply_drop(threshold_mv - 1) ||
+            sd_stub_stats.sched_events != 1 || sd_stub_softdevice_calls() != 0) {
+            fprintf(stderr, "%s: warning below %u mV queued %u events, %u sd calls\n", BENCH_VARIANT,
+                    (unsigned)threshold_mv, (unsigned)sd_stub_stats.sched_events,
+                    (unsigned)sd_stub_softdevice_calls());
+            return 1;
+        }
+
+        // The main loop reads the battery a while later, and takes the status
+        // and the step on air when it agrees, before the next key.
+        settle_rotation();
+        if (sd_stub_stats.battery_reads != 0 || power_governor_stats.level != level - 1) {
+            fprintf(stderr, "%s: warning below %u mV taken before its reading\n", BENCH_VARIANT,
+                    (unsigned)threshold_mv);
+            return 1;
+        }
+        sd_stub_vbatt_mv = governor_level_mv[level];
+        if (pof_confirm(threshold_mv) != 0) {
+            return 1;
+        }
+        governor_config(level, &expected);
+        if ((sd_stub_adv_data[6] & STATUS_FLAG_BATTERY_MASK) != level << 6 || power_governor_stats.level != level ||
+            check_adv_config_on_air(&expected) != 0 || sd_stub_stats.battery_reads != 1 ||
+            sd_stub_stats.saadc_sample != 0) {
+            fprintf(stderr, "%s: warning below %u mV did not step to status %u\n", BENCH_VARIANT,
+                    (unsigned)threshold_mv, (unsigned)level);
+            return 1;
+        }
+
+        // Armed again for the next status, off past the last one.
+        uint16_t next_mv = pof_expected_mv(level);
+        if (sd_stub_pof_enabled != (next_mv != 0) || (next_mv != 0 && sd_stub_pof_threshold_mv != next_mv) ||
+            battery_pof_stats.threshold_mv != next_mv) {
+            fprintf(stderr, "%s: comparator %s at %u mV at status %u, expected %u mV\n", BENCH_VARIANT,
+                    sd_stub_pof_enabled ? "on" : "off", (unsigned)sd_stub_pof_threshold_mv, (unsigned)level,
+                    (unsigned)next_mv);
+            return 1;
+        }
+    }
+    if (battery_pof_stats.warnings != warnings + POWER_GOVERNOR_LEVELS - 1 || battery_pof_stats.transients != 1 ||
+        battery_pof_stats.suppressed != 2) {
+        fprintf(stderr, "%s: %u warnings taken, expected %u\n", BENCH_VARIANT,
+                (unsigned)(battery_pof_stats.warnings - warnings), (unsigned)(POWER_GOVERNOR_LEVELS - 1));
+        return 1;
+    }
+
+    // A fresh battery, at the next reading, arms it again.
+    governor_battery(0);
+    if (!sd_stub_pof_enabled || sd_stub_pof_threshold_mv != pof_expected_mv(0)) {
+        fprintf(stderr, "%s: comparator not armed again with a fresh battery\n", BENCH_VARIANT);
+        return 1;
+    }
+
+    printf("%-40s comparator warnings at %u/%u/%u mV, each confirmed by a reading %u s later\n", BENCH_VARIANT,
+           (unsigned)battery_pof_stats.level_mv[1], (unsigned)battery_pof_stats.level_mv[2],
+           (unsigned)battery_pof_stats.level_mv[3], (unsigned)BATTERY_POF_CONFIRM_DELAY);
+    return 0;
+}
+#endif
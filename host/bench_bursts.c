@@ -0,0 +1,69 @@
+/*
+ * Host benchmark: advertising bursts, see bench.h.
+ */
+
+#if ADV_BURST_DURATION > 0
+// Advertising events until the burst is over, the radio is off after that.
+static uint32_t run_burst(void)
+{
+    uint32_t events = sd_stub_stats.adv_events;
+    for (int i = 0; i < 4 * ADV_BURST_DURATION * 1000 / ADVERTISING_INTERVAL && sd_stub_advertising; i++) {
+        sd_stub_adv_event();
+    }
+    return sd_stub_stats.adv_events - events;
+}
+
+static int check_adv_bursts(void)
+{
+    const uint32_t burst_events = ADV_BURST_DURATION * 1000 / ADVERTISING_INTERVAL;
+    int index = on_air_index();
+
+    // Every burst advertises the key of the rotation for its duration, and
+    // the radio stays off until the next one.
+    for (int burst = 1; burst <= ADV_BURSTS; burst++) {
+        verify_advertised(index);
+        uint32_t events = run_burst();
+        if (sd_stub_advertising || events < burst_events || events > burst_events + 1) {
+            fprintf(stderr, "%s: %u advertising events in burst %d, expected %u\n", BENCH_VARIANT,
+                    (unsigned)events, burst, (unsigned)burst_events);
+            return 1;
+        }
+        // Only the wake-ups of the intervals longer than the RTC can time in between.
+        uint32_t runs = wakeup_stats.runs[m_rotation_job];
+        while (m_wakeup_timer_id->ticks == WAKEUP_MAX_SLEEP_TICKS) {
+            sd_stub_timer_fire(m_wakeup_timer_id);
+            settle_rotation();
+            if (sd_stub_advertising) {
+                fprintf(stderr, "%s: advertising between bursts\n", BENCH_VARIANT);
+                return 1;
+            }
+        }
+        if (burst == ADV_BURSTS) {
+            fire_rotation_timer();
+        } else {
+            fire_until(m_burst_job);
+        }
+        if (wakeup_stats.runs[m_rotation_job] - runs != (burst == ADV_BURSTS)) {
+            fprintf(stderr, "%s: key rotated at burst %d\n", BENCH_VARIANT, burst + 1);
+            return 1;
+        }
+        settle_rotation();
+        if (!sd_stub_advertising) {
+            fprintf(stderr, "%s: burst %d not started\n", BENCH_VARIANT, burst + 1);
+            return 1;
+        }
+    }
+
+    // The last burst is the first one of the next key.
+    if (on_air_index() == index && key_count > 1) {
+        fprintf(stderr, "%s: key not rotated after %d bursts\n", BENCH_VARIANT, ADV_BURSTS);
+        return 1;
+    }
+    verify_advertised(on_air_index());
+
+    printf("%-40s %d bursts of %u advertising events per rotation, %u.%u%% of the time advertising\n",
+           BENCH_VARIANT, ADV_BURSTS, (unsigned)burst_events, (unsigned)BURST_DUTY_PERMILLE / 10,
+           (unsigned)BURST_DUTY_PERMILLE % 10);
+    return 0;
+}
+#endif
@@ -0,0 +1,74 @@
+/*
+ * Host benchmark: the fast-find button, see bench.h.
+ */
+
+#if defined(FAST_FIND_BUTTON_PIN)
+static int check_fast_find(void)
+{
+    ble_adv_config_t normal;
+    ble_adv_config_get(&normal);
+    ble_adv_config_t fast = normal;
+    fast.interval_ms = FAST_FIND_INTERVAL;
+    fast.duration_s = 0;
+
+    if (!sd_stub_buttons_enabled || sd_stub_button_count != 1 ||
+        sd_stub_buttons[0].active_state != FAST_FIND_BUTTON_ACTIVE_STATE ||
+        sd_stub_buttons[0].pull_cfg != FAST_FIND_BUTTON_PULL) {
+        fprintf(stderr, "%s: fast-find button not set up\n", BENCH_VARIANT);
+        return 1;
+    }
+    if (sd_stub_button_press(FAST_FIND_BUTTON_PIN + 1)) {
+        fprintf(stderr, "%s: button on the wrong pin\n", BENCH_VARIANT);
+        return 1;
+    }
+
+    // The button interrupt only queues the press.
+    sd_stub_reset_stats();
+    sd_stub_button_press(FAST_FIND_BUTTON_PIN);
+    if (sd_stub_stats.sched_events != 1 || sd_stub_softdevice_calls() != 0) {
+        fprintf(stderr, "%s: button press queued %u events, made %u sd calls\n", BENCH_VARIANT,
+                (unsigned)sd_stub_stats.sched_events, (unsigned)sd_stub_softdevice_calls());
+        return 1;
+    }
+    settle_rotation();
+    if (check_adv_config_on_air(&fast) != 0 || !m_fast_find_timer_id->running ||
+        m_fast_find_timer_id->ticks != FAST_FIND_TIMER_TICKS) {
+        fprintf(stderr, "%s: fast-find not started\n", BENCH_VARIANT);
+        return 1;
+    }
+
+    // It keeps advertising past the end of a burst.
+    sd_stub_reset_stats();
+    const uint32_t fast_events = FAST_FIND_DURATION * 1000 / FAST_FIND_INTERVAL;
+    for (uint32_t i = 0; i < fast_events && sd_stub_advertising; i++) {
+        sd_stub_adv_event();
+    }
+    if (sd_stub_stats.adv_events != fast_events || !sd_stub_advertising) {
+        fprintf(stderr, "%s: %u advertising events during fast-find, expected %u\n", BENCH_VARIANT,
+                (unsigned)sd_stub_stats.adv_events, (unsigned)fast_events);
+        return 1;
+    }
+
+    // Pressing again starts the time over without touching the radio.
+    sd_stub_reset_stats();
+    sd_stub_button_press(FAST_FIND_BUTTON_PIN);
+    settle_rotation();
+    if (sd_stub_softdevice_calls() != 0 || !m_fast_find_timer_id->running) {
+        fprintf(stderr, "%s: second press made %u sd calls\n", BENCH_VARIANT,
+                (unsigned)sd_stub_softdevice_calls());
+        return 1;
+    }
+
+    // Then back to the configuration from before.
+    sd_stub_timer_fire(m_fast_find_timer_id);
+    settle_rotation();
+    if (check_adv_config_on_air(&normal) != 0) {
+        fprintf(stderr, "%s: advertising configuration not restored after fast-find\n", BENCH_VARIANT);
+        return 1;
+    }
+
+    printf("%-40s fast-find: %u advertising events in %d s on a button press instead of %u\n", BENCH_VARIANT,
+           (unsigned)fast_events, FAST_FIND_DURATION, (unsigned)(FAST_FIND_DURATION * 1000 / normal.interval_ms));
+    return 0;
+}
+#endif
@@ -0,0 +1,21 @@
+/*
+ * Host benchmark: gapless rotation, see bench.h.
+ */
+
+#if defined(GAPLESS_ROTATION) && GAPLESS_ROTATION == 1
+// Every rotation of the timed run measured its gap, none longer than an
+// advertising interval.
+static int check_rotation_gap(long rotations)
+{
+    uint32_t gap_max_ms = COMPAT_APP_TIMER_TICKS_TO_MS(rotation_gap.max_ticks);
+    if (rotation_gap.count != rotations || gap_max_ms > ADVERTISING_INTERVAL) {
+        fprintf(stderr, "%s: %u of %ld rotation gaps measured, max %u ms\n", BENCH_VARIANT,
+                (unsigned)rotation_gap.count, rotations, (unsigned)gap_max_ms);
+        return 1;
+    }
+    printf("%-40s rotation gap max %u ms, last %u ms (advertising interval %d ms)\n",
+           BENCH_VARIANT, (unsigned)gap_max_ms,
+           (unsigned)COMPAT_APP_TIMER_TICKS_TO_MS(rotation_gap.last_ticks), ADVERTISING_INTERVAL);
+    return 0;
+}
+#endif
@@ -0,0 +1,111 @@
+/*
+ * Host benchmark: the power governor, see bench.h.
+ */
+
+#if defined(POWER_GOVERNOR) && POWER_GOVERNOR == 1
+// Advertising configuration of a governor step, from the one at boot.
+static void governor_config(uint8_t level, ble_adv_config_t *p_config)
+{
+    static const struct {
+        uint8_t interval_factor;
+        int8_t tx_drop;
+        uint16_t duration_s;
+    } steps[POWER_GOVERNOR_LEVELS] = {
+        {1, 0, 0},
+        {POWER_GOVERNOR_MEDIUM_INTERVAL_FACTOR, POWER_GOVERNOR_MEDIUM_TX_DROP, POWER_GOVERNOR_MEDIUM_DURATION},
+        {POWER_GOVERNOR_LOW_INTERVAL_FACTOR, POWER_GOVERNOR_LOW_TX_DROP, POWER_GOVERNOR_LOW_DURATION},
+        {POWER_GOVERNOR_CRITICAL_INTERVAL_FACTOR, POWER_GOVERNOR_CRITICAL_TX_DROP, POWER_GOVERNOR_CRITICAL_DURATION},
+    };
+    *p_config = (ble_adv_config_t){
+        .interval_ms = ADVERTISING_INTERVAL * steps[level].interval_factor,
+        .tx_power = BLE_MAX_TX_POWER - steps[level].tx_drop,
+        .duration_s = steps[level].duration_s ? steps[level].duration_s : ADV_BURST_DURATION,
+        .channels = ADV_CHANNELS,
+        .channel = ADV_CHANNEL,
+    };
+}
+
+// Battery voltages of each status on the linear curve: 100%, 73%, 40% and 13%.
+static const uint16_t governor_level_mv[POWER_GOVERNOR_LEVELS] = {3300, 2900, 2400, 2000};
+
+// A battery reading at a status, then the next key.
+static void governor_battery(uint8_t level)
+{
+    sd_stub_vbatt_mv = governor_level_mv[level];
+    battery_status_update(battery_voltage_percent(sd_stub_vbatt_mv), false);
+    set_and_advertise_next_key(NULL);
+    settle_rotation();
+}
+
+static int check_power_governor(void)
+{
+    // Down as the battery drains, then back up with a fresh one.
+    static const uint8_t sequence[] = {1, 2, 3, 0};
+    uint32_t changes = power_governor_stats.changes;
+    ble_adv_config_t expected;
+
+    if (power_governor_stats.level != 0) {
+        fprintf(stderr, "%s: governor at step %u with a full battery\n", BENCH_VARIANT,
+                (unsigned)power_governor_stats.level);
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(sequence); i++) {
+        governor_config(sequence[i], &expected);
+        governor_battery(sequence[i]);
+        if (power_governor_stats.level != sequence[i] || check_adv_config_on_air(&expected) != 0) {
+            fprintf(stderr, "%s: governor step %u not advertised\n", BENCH_VARIANT, (unsigned)sequence[i]);
+            return 1;
+        }
+    }
+    if (power_governor_stats.changes != changes + sizeof(sequence)) {
+        fprintf(stderr, "%s: governor changed step %u times, expected %u\n", BENCH_VARIANT,
+                (unsigned)(power_governor_stats.changes - changes), (unsigned)sizeof(sequence));
+        return 1;
+    }
+
+#if defined(FAST_FIND_BUTTON_PIN)
+    // A step taken during fast-find waits for it to end.
+    ble_adv_config_t fast;
+    governor_config(0, &fast);
+    fast.interval_ms = FAST_FIND_INTERVAL;
+    fast.duration_s = 0;
+    sd_stub_button_press(FAST_FIND_BUTTON_PIN);
+    settle_rotation();
+    governor_battery(2);
+    if (check_adv_config_on_air(&fast) != 0) {
+        fprintf(stderr, "%s: governor step taken during fast-find\n", BENCH_VARIANT);
+        return 1;
+    }
+    sd_stub_timer_fire(m_fast_find_timer_id);
+    settle_rotation();
+    governor_config(2, &expected);
+    if (check_adv_config_on_air(&expected) != 0) {
+        fprintf(stderr, "%s: governor step not taken after fast-find\n", BENCH_VARIANT);
+        return 1;
+    }
+    governor_battery(0);
+#endif
+
+    // Every step draws less, and the projected lifetime beats the boot configuration.
+    uint32_t total_hours = 0;
+    for (uint8_t level = 0; level < POWER_GOVERNOR_LEVELS; level++) {
+        if (level > 0 && power_governor_stats.current_na[level] > power_governor_stats.current_na[level - 1]) {
+            fprintf(stderr, "%s: governor step %u draws more than the one before\n", BENCH_VARIANT, (unsigned)level);
+            return 1;
+        }
+        total_hours += power_governor_stats.lifetime_hours[level];
+    }
+    if (total_hours <= power_governor_stats.lifetime_hours_fixed) {
+        fprintf(stderr, "%s: governor projects %u hours, %u without\n", BENCH_VARIANT, (unsigned)total_hours,
+                (unsigned)power_governor_stats.lifetime_hours_fixed);
+        return 1;
+    }
+
+    printf("%-40s governor %u/%u/%u/%u uA, %u days projected on %u mAh, %u days without\n", BENCH_VARIANT,
+           (unsigned)power_governor_stats.current_na[0] / 1000, (unsigned)power_governor_stats.current_na[1] / 1000,
+           (unsigned)power_governor_stats.current_na[2] / 1000, (unsigned)power_governor_stats.current_na[3] / 1000,
+           (unsigned)total_hours / 24, (unsigned)POWER_GOVERNOR_CAPACITY_MAH,
+           (unsigned)power_governor_stats.lifetime_hours_fixed / 24);
+    return 0;
+}
+#endif
@@ -0,0 +1,170 @@
+/*
+ * Host benchmark: the rotation journal, see bench.h.
+ */
+
+#if defined(ROTATION_JOURNAL) && ROTATION_JOURNAL == 1
+/**
+ * Reads the journal pages following the format described in rotation_journal.h,
+ * independently of rotation_journal.c. Returns the highest valid position, the
+ * elapsed rotations and the slot of its record, counts the valid and torn
+ * records and fails if a record follows an erased slot, as records are only
+ * ever appended.
+ */
+/**
+ * Words of a slot, counting the slots of the second page on from the first.
+ * Records don't straddle pages, the bytes behind the last slot stay erased.
+ */
+static uint32_t *journal_slot(uint32_t slot)
+{
+    return (uint32_t *)(journal_region + (slot / BENCH_JOURNAL_SLOTS) * SD_STUB_FLASH_PAGE_SIZE +
+                        (slot % BENCH_JOURNAL_SLOTS) * sizeof(rotation_journal_record_t));
+}
+
+static uint32_t journal_scan(uint32_t *p_valid, uint32_t *p_torn, uint32_t *p_slot, uint32_t *p_elapsed)
+{
+    uint32_t position = 0;
+
+    *p_valid = 0;
+    *p_torn = 0;
+    for (uint32_t page = 0; page < 2; page++) {
+        bool erased_seen = false;
+        for (uint32_t slot = page * BENCH_JOURNAL_SLOTS; slot < (page + 1) * BENCH_JOURNAL_SLOTS; slot++) {
+            const uint32_t *words = journal_slot(slot);
+            uint32_t value = words[0];
+            uint32_t elapsed = words[1];
+            uint32_t check = words[2];
+            if (value == UINT32_MAX && elapsed == UINT32_MAX && check == UINT32_MAX) {
+                erased_seen = true;
+                continue;
+            }
+            if (erased_seen) {
+                fprintf(stderr, "%s: journal record behind an erased slot\n", BENCH_VARIANT);
+                exit(1);
+            }
+            if ((value ^ elapsed ^ 0x324E524Au) != check) {
+                (*p_torn)++;
+            } else if ((*p_valid)++ == 0 || value > position) {
+                position = value;
+                *p_elapsed = elapsed;
+                *p_slot = slot;
+            }
+        }
+    }
+    return position;
+}
+
+static void journal_rotate(void)
+{
+    fire_rotation_timer();
+    settle_rotation();
+}
+
+static int check_journal(void)
+{
+    uint32_t valid, torn, slot, journaled;
+    uint32_t position = journal_scan(&valid, &torn, &slot, &journaled);
+    uint32_t writes = rotation_journal_stats.writes;
+    uint32_t erases = rotation_journal_stats.erases;
+
+    // One record per batch of rotations, holding the position of the key on
+    // air when it was written: resuming a batch past it may skip keys but
+    // never repeats one. Without a reset, every rotation is timed.
+    if (torn != 0 || writes != (rotation_position + ROTATION_JOURNAL_BATCH - 1) / ROTATION_JOURNAL_BATCH ||
+        position >= rotation_position || position + ROTATION_JOURNAL_BATCH < rotation_position ||
+        journaled != position) {
+        fprintf(stderr, "%s: journal at %u after %u rotations (%u writes, %u torn)\n", BENCH_VARIANT,
+                (unsigned)position, (unsigned)rotation_position, (unsigned)writes, (unsigned)torn);
+        return 1;
+    }
+
+    // A page is erased only once the other one is full, and the full page is
+    // kept until the next switch.
+    if (erases != (writes - 1) / BENCH_JOURNAL_SLOTS ||
+        valid != writes - erases * BENCH_JOURNAL_SLOTS + (erases ? BENCH_JOURNAL_SLOTS : 0)) {
+        fprintf(stderr, "%s: %u journal erases, %u records after %u writes\n", BENCH_VARIANT,
+                (unsigned)erases, (unsigned)valid, (unsigned)writes);
+        return 1;
+    }
+
+    uint32_t on_air = rotation_position - 1;
+    uint32_t resumed, elapsed;
+    if (!rotation_journal_init(&resumed, &elapsed) || resumed != position + ROTATION_JOURNAL_BATCH ||
+        elapsed != position) {
+        fprintf(stderr, "%s: journal resumed at %u after %u rotations, expected %u after %u\n", BENCH_VARIANT,
+                (unsigned)resumed, (unsigned)elapsed, (unsigned)(position + ROTATION_JOURNAL_BATCH),
+                (unsigned)position);
+        return 1;
+    }
+
+    // A write cut short by a reset leaves a record that doesn't check out. It
+    // must be skipped, and the log must continue behind it.
+    if (slot % BENCH_JOURNAL_SLOTS + 4 < BENCH_JOURNAL_SLOTS) {
+        journal_slot(slot + 1)[0] = position + 1000;
+        if (!rotation_journal_init(&resumed, &elapsed) || resumed != position + ROTATION_JOURNAL_BATCH ||
+            elapsed != position) {
+            fprintf(stderr, "%s: torn journal record not skipped\n", BENCH_VARIANT);
+            return 1;
+        }
+
+        // Boot again from the journal.
+        rotation_position = resumed;
+        set_and_advertise_next_key(NULL);
+        settle_rotation();
+        verify_advertised(on_air_index());
+#if !(defined(RANDOM_ROTATE_KEYS) && RANDOM_ROTATE_KEYS == 1) && !(defined(DERIVE_KEYS) && DERIVE_KEYS == 1)
+        if (current_index != resumed % key_count) {
+            fprintf(stderr, "%s: resumed at key %u, expected %u\n", BENCH_VARIANT,
+                    (unsigned)current_index, (unsigned)(resumed % key_count));
+            return 1;
+        }
+#endif
+        uint32_t next_slot;
+        if (journal_scan(&valid, &torn, &next_slot, &journaled) != resumed ||
+            torn != 1 || next_slot != slot + 2) {
+            fprintf(stderr, "%s: journal did not continue behind the torn record\n", BENCH_VARIANT);
+            return 1;
+        }
+
+        // A second reset right away skips another batch of keys, but the
+        // time stays where the first reset left it, as the first record
+        // after a boot holds the elapsed rotations it resumed from.
+        if (!rotation_journal_init(&resumed, &elapsed) || resumed != position + 2 * ROTATION_JOURNAL_BATCH ||
+            elapsed != position) {
+            fprintf(stderr, "%s: second reset resumed at %u after %u rotations, expected %u after %u\n",
+                    BENCH_VARIANT, (unsigned)resumed, (unsigned)elapsed,
+                    (unsigned)(position + 2 * ROTATION_JOURNAL_BATCH), (unsigned)position);
+            return 1;
+        }
+        rotation_position = resumed;
+        set_and_advertise_next_key(NULL);
+        settle_rotation();
+        for (int i = 0; i < ROTATION_JOURNAL_BATCH; i++) {
+            journal_rotate();
+        }
+        uint32_t last = journal_scan(&valid, &torn, &next_slot, &journaled);
+        if (last != resumed + ROTATION_JOURNAL_BATCH || journaled != position + ROTATION_JOURNAL_BATCH) {
+            fprintf(stderr, "%s: journal at %u after %u rotations after two resets, expected %u after %u\n",
+                    BENCH_VARIANT, (unsigned)last, (unsigned)journaled,
+                    (unsigned)(resumed + ROTATION_JOURNAL_BATCH), (unsigned)(position + ROTATION_JOURNAL_BATCH));
+            return 1;
+        }
+    }
+
+    // A write the SoftDevice couldn't fit in is retried with the next rotation.
+    sd_stub_flash_fail = true;
+    for (int i = 0; i < 2 * ROTATION_JOURNAL_BATCH; i++) {
+        journal_rotate();
+    }
+    if (rotation_journal_stats.errors != 1 ||
+        journal_scan(&valid, &torn, &slot, &journaled) + ROTATION_JOURNAL_BATCH < rotation_position) {
+        fprintf(stderr, "%s: failed journal write not retried\n", BENCH_VARIANT);
+        return 1;
+    }
+
+    printf("%-40s journal %u writes, %u erases, %u records, %.3f flash ops/rotation, "
+           "resumes %u keys ahead of the key on air\n",
+           BENCH_VARIANT, (unsigned)writes, (unsigned)erases, (unsigned)valid,
+           (double)(writes + erases) / on_air, (unsigned)(position + ROTATION_JOURNAL_BATCH - on_air));
+    return 0;
+}
+#endif
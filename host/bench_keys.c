@@ -0,0 +1,165 @@
+/*
+ * Host benchmark: the key table, or the master key and key derivation, see bench.h.
+ */
+
+#if defined(DERIVE_KEYS) && DERIVE_KEYS == 1
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/obj_mac.h>
+
+#define BENCH_DERIVE_KEYS 2000
+
+// Keys derived by tools/derive_keys.py from the owner key with the master
+// private key 01 02 ... 1c and the chain key 00 01 ... 1f.
+static const char bench_master_public_key[] =
+    "627b7c0b3a2fb7a478ac5670e9973194a5fda0bc0791b07506a73ddd"
+    "99113b3fdea71bbff9921330d9ce980155eebd620c46be927c214543";
+static const struct {
+    uint32_t index;
+    const char *adv_key;
+} known_keys[] = {
+    { 0, "2860eae5cc90ec4db92b75d3b4c94f6df2815aa5e5e1f280026325a2" },
+    { 1, "fa3c5de23454374890d0bf149c4271774924369c7bde6deac2db903a" },
+    { 1000, "f56f067130126da78128e6f2d8bd04b44d20f47e1e10100c429598e2" },
+};
+
+// Master public key and chain key, as tools/adv_records.py --derive patches them.
+static uint8_t bench_master[DERIVE_MASTER_LEN];
+
+static void hex_to_bytes(const char *hex, uint8_t *bytes, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        sscanf(&hex[2 * i], "%2hhx", &bytes[i]);
+    }
+}
+
+// Reference derivation, straight from the description in tools/derive_keys.py.
+static void expected_key(int index, uint8_t key[28])
+{
+    static const uint8_t order[28] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0x16, 0xA2, 0xE0, 0xB8, 0xF0, 0x3E, 0x13, 0xDD, 0x29, 0x45, 0x5C, 0x5C, 0x2A, 0x3D,
+    };
+    static const uint8_t zero[28];
+    uint8_t message[DERIVE_CHAIN_KEY_LEN + 5];
+    uint8_t digest[32];
+
+    memcpy(message, bench_master + DERIVE_PUBLIC_KEY_LEN, DERIVE_CHAIN_KEY_LEN);
+    for (int i = 0; i < 4; i++) {
+        message[DERIVE_CHAIN_KEY_LEN + i] = (uint8_t)((uint32_t)index >> (8 * i));
+    }
+    for (message[DERIVE_CHAIN_KEY_LEN + 4] = 0;; message[DERIVE_CHAIN_KEY_LEN + 4]++) {
+        EVP_Digest(message, sizeof(message), digest, NULL, EVP_sha256(), NULL);
+        if (memcmp(digest, zero, 28) != 0 && memcmp(digest, order, 28) < 0) {
+            break;
+        }
+    }
+
+    EC_GROUP *group = EC_GROUP_new_by_curve_name(NID_secp224r1);
+    EC_POINT *master = EC_POINT_new(group);
+    EC_POINT *point = EC_POINT_new(group);
+    BIGNUM *u = BN_bin2bn(digest, 28, NULL);
+    BIGNUM *px = BN_bin2bn(bench_master, 28, NULL);
+    BIGNUM *py = BN_bin2bn(bench_master + 28, 28, NULL);
+    BIGNUM *x = BN_new();
+    if (!EC_POINT_set_affine_coordinates(group, master, px, py, NULL) ||
+        !EC_POINT_mul(group, point, NULL, master, u, NULL) ||
+        !EC_POINT_get_affine_coordinates(group, point, x, NULL, NULL) ||
+        BN_bn2binpad(x, key, 28) != 28) {
+        fprintf(stderr, "%s: reference derivation failed\n", BENCH_VARIANT);
+        exit(1);
+    }
+    BN_free(x);
+    BN_free(py);
+    BN_free(px);
+    BN_free(u);
+    EC_POINT_free(point);
+    EC_POINT_free(master);
+    EC_GROUP_free(group);
+}
+
+static void patch_master_key(void)
+{
+    adv_keys_header_t *header = (adv_keys_header_t *)key_region;
+    memcpy(header->magic, DERIVE_MASTER_MAGIC, sizeof(header->magic));
+    header->version = ADV_KEYS_VERSION;
+    header->record_size = DERIVE_MASTER_LEN;
+    header->count = 1;
+
+    hex_to_bytes(bench_master_public_key, bench_master, DERIVE_PUBLIC_KEY_LEN);
+    for (int i = 0; i < DERIVE_CHAIN_KEY_LEN; i++) {
+        bench_master[DERIVE_PUBLIC_KEY_LEN + i] = i;
+    }
+    memcpy(key_region + sizeof(adv_keys_header_t), bench_master, DERIVE_MASTER_LEN);
+}
+
+// The firmware must derive the keys the owner's tool derives, and report the
+// time it takes. This reuses the record slots, so it runs once the advertised
+// key no longer matters.
+static int check_key_derivation(void)
+{
+    for (size_t i = 0; i < sizeof(known_keys) / sizeof(known_keys[0]); i++) {
+        uint8_t key[28];
+        adv_record_t record;
+        hex_to_bytes(known_keys[i].adv_key, key, sizeof(key));
+        key_to_record(key, &record);
+        key_derivation_run(known_keys[i].index);
+        if (memcmp(key_derivation_take(known_keys[i].index), &record, sizeof(record)) != 0) {
+            fprintf(stderr, "%s: derived key %u does not match tools/derive_keys.py\n",
+                    BENCH_VARIANT, (unsigned)known_keys[i].index);
+            return 1;
+        }
+    }
+
+    sd_stub_reset_stats();
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < BENCH_DERIVE_KEYS; i++) {
+        key_derivation_run(i);
+    }
+    uint64_t elapsed = now_ns() - start;
+    printf("%-40s %8.1f us/derived key (%.2f hashes, %.2f point multiplications per key)\n",
+           BENCH_VARIANT, (double)elapsed / 1000.0 / BENCH_DERIVE_KEYS,
+           (double)sd_stub_stats.crypto_hash / BENCH_DERIVE_KEYS,
+           (double)sd_stub_stats.crypto_ecdh / BENCH_DERIVE_KEYS);
+
+    // A master public key off the curve is turned down rather than
+    // multiplied, its keys couldn't be decrypted.
+    uint8_t bad_master[DERIVE_MASTER_LEN];
+    memcpy(bad_master, bench_master, sizeof(bad_master));
+    bad_master[DERIVE_PUBLIC_KEY_LEN - 1] ^= 0x01;
+    if (key_derivation_init(bad_master) || !key_derivation_init(bench_master)) {
+        fprintf(stderr, "%s: master public key off the curve not turned down\n", BENCH_VARIANT);
+        return 1;
+    }
+    return 0;
+}
+#else
+// Deterministic stand-in for generate_keys.py output.
+static void expected_key(int index, uint8_t key[28])
+{
+    uint32_t x = 0x9E3779B9u * (uint32_t)(index + 1);
+    for (int i = 0; i < 28; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        key[i] = (uint8_t)x;
+    }
+}
+
+static void patch_keys(int count)
+{
+    adv_keys_header_t *header = (adv_keys_header_t *)key_region;
+    memcpy(header->magic, ADV_KEYS_MAGIC, sizeof(header->magic));
+    header->version = ADV_KEYS_VERSION;
+    header->record_size = sizeof(adv_record_t);
+    header->count = count;
+
+    adv_record_t *records = (adv_record_t *)(key_region + sizeof(adv_keys_header_t));
+    for (int i = 0; i < count; i++) {
+        uint8_t key[28];
+        expected_key(i, key);
+        key_to_record(key, &records[i]);
+    }
+}
+#endif
@@ -0,0 +1,41 @@
+/*
+ * Host benchmark: low-power pins, see bench.h.
+ */
+
+// Every pin configured once at boot, as the board map of boards.h asks, and
+// the ones it keeps or the chip reserves not at all.
+static int check_low_power_pins(void)
+{
+    for (uint32_t pin = 0; pin < NUMBER_OF_PINS; pin++) {
+        uint32_t mask = 1u << pin;
+        const sd_stub_gpio_t *p_gpio = &sd_stub_gpio[pin];
+        bool ok;
+
+        if (mask & (LOW_POWER_PINS_KEEP | LOW_POWER_PINS_SYSTEM)) {
+            ok = p_gpio->configured == 0;
+        } else if (mask & (LOW_POWER_PINS_OUTPUT_LOW | LOW_POWER_PINS_OUTPUT_HIGH)) {
+            ok = p_gpio->configured == 1 && p_gpio->dir == NRF_GPIO_PIN_DIR_OUTPUT &&
+                 p_gpio->out == ((mask & LOW_POWER_PINS_OUTPUT_HIGH) != 0);
+        } else {
+            nrf_gpio_pin_pull_t pull = (mask & LOW_POWER_PINS_PULLUP)     ? NRF_GPIO_PIN_PULLUP
+                                       : (mask & LOW_POWER_PINS_PULLDOWN) ? NRF_GPIO_PIN_PULLDOWN
+                                                                          : NRF_GPIO_PIN_NOPULL;
+            ok = p_gpio->configured == 1 && p_gpio->dir == NRF_GPIO_PIN_DIR_INPUT &&
+                 p_gpio->input == NRF_GPIO_PIN_INPUT_DISCONNECT && p_gpio->pull == pull;
+        }
+
+        if (!ok) {
+            fprintf(stderr, "%s: pin %u not in its low-power state (configured %u times)\n", BENCH_VARIANT,
+                    (unsigned)pin, (unsigned)p_gpio->configured);
+            return 1;
+        }
+    }
+
+    uint32_t held = __builtin_popcount(LOW_POWER_PINS_HELD);
+    uint32_t left = __builtin_popcount(LOW_POWER_PINS_KEEP | LOW_POWER_PINS_SYSTEM);
+    if (low_power_stats.pins_held != held || low_power_stats.pins_disconnected != NUMBER_OF_PINS - held - left) {
+        fprintf(stderr, "%s: low-power pin stats don't match\n", BENCH_VARIANT);
+        return 1;
+    }
+    return 0;
+}
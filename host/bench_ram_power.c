@@ -0,0 +1,38 @@
+/*
+ * Host benchmark: powering down unused RAM, see bench.h.
+ */
+
+#if defined(RAM_POWER_DOWN) && RAM_POWER_DOWN == 1
+extern uint8_t __ram_used_end[];
+extern uint8_t __ram_end[];
+
+// Sections up to the one holding the top of the stack stay powered and
+// retained, the ones above are off.
+static int check_ram_power(void)
+{
+    uint32_t used = (uint32_t)(uintptr_t)__ram_used_end - RAM_POWER_BASE;
+    uint32_t sections = ((uint32_t)(uintptr_t)__ram_end - RAM_POWER_BASE) / RAM_POWER_SECTION_SIZE;
+    uint32_t off = 0;
+
+    for (uint32_t section = 0; section < SD_STUB_RAM_BLOCKS * RAM_POWER_SECTIONS_PER_BLOCK; section++) {
+        uint32_t mask = (POWER_RAM_POWER_S0POWER_Msk | POWER_RAM_POWER_S0RETENTION_Msk)
+                        << (section % RAM_POWER_SECTIONS_PER_BLOCK);
+        uint32_t state = sd_stub_ram_power[section / RAM_POWER_SECTIONS_PER_BLOCK] & mask;
+        bool in_use = section * RAM_POWER_SECTION_SIZE < used;
+        if (state != (in_use || section >= sections ? mask : 0)) {
+            fprintf(stderr, "%s: RAM section %u %s\n", BENCH_VARIANT, (unsigned)section,
+                    in_use ? "in use powered down" : "left on");
+            return 1;
+        }
+        off += state == 0;
+    }
+    if (ram_power_stats.sections_off != off || ram_power_stats.used_bytes != used) {
+        fprintf(stderr, "%s: RAM power stats don't match\n", BENCH_VARIANT);
+        return 1;
+    }
+
+    printf("%-40s %u bytes of RAM in use, %u of %u sections of %u bytes powered down\n", BENCH_VARIANT,
+           (unsigned)used, (unsigned)off, (unsigned)sections, (unsigned)RAM_POWER_SECTION_SIZE);
+    return 0;
+}
+#endif
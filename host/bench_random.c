@@ -0,0 +1,34 @@
+/*
+ * Host benchmark: random rotation, see bench.h.
+ */
+
+#if defined(RANDOM_ROTATE_KEYS) && RANDOM_ROTATE_KEYS == 1
+// The fallback PRNG must not pick the first key from its fixed seed.
+static int check_rng_seeded(void)
+{
+    if (prng_state == 0x2545F491) {
+        fprintf(stderr, "%s: PRNG not seeded at boot\n", BENCH_VARIANT);
+        return 1;
+    }
+    return 0;
+}
+
+// With the SoftDevice pool dry, picking a key must fall back to the PRNG
+// instead of waiting.
+static int check_rng_pool_empty(void)
+{
+    uint32_t pool_empty = rng_stats.pool_empty;
+    rng_reservoir_len = 0;
+    sd_stub_rand_available = 0;
+    set_and_advertise_next_key(NULL);
+    settle_rotation();
+    verify_advertised(on_air_index());
+    if (rng_stats.pool_empty == pool_empty) {
+        fprintf(stderr, "%s: empty RNG pool not counted\n", BENCH_VARIANT);
+        return 1;
+    }
+    printf("%-40s rng reservoir empty %u times, %u rejections\n",
+           BENCH_VARIANT, (unsigned)rng_stats.pool_empty, (unsigned)rng_stats.rejections);
+    return 0;
+}
+#endif
@@ -0,0 +1,428 @@
+/*
+ * Host benchmark of the key rotation hot path.
+ *
+ * main.c is compiled unchanged into this translation unit (its main() is
+ * renamed to firmware_main) so the benchmark can reach the key table and the
+ * wake-up timer. The key table region the linker scripts reserve at the end
+ * of flash is an array in the adv_keys section here, for which the linker
+ * provides the same __start_adv_keys / __stop_adv_keys symbols. The key table
+ * and its header (or the master key with DERIVE_KEYS=1) are written into it
+ * the same way the patch_target step patches the flash image, the firmware is booted
+ * until it first goes to sleep, and then the wake-up timer is fired
+ * repeatedly, followed by as many battery status updates. With
+ * ROTATION_JOURNAL=1 the journal pages are a rotation_journal section array
+ * too, and the flash operations the SoftDevice stub queues are carried out
+ * after every rotation. With BATTERY_ASYNC=1 the SAADC conversions the stub
+ * starts are completed after every rotation as well.
+ *
+ * This file holds the harness and the timed runs; the checks of each feature
+ * are in bench_<feature>.c, included below (see bench.h).
+ *
+ * Usage: bench_rotation [rotations]
+ */
+#define main firmware_main
+#include "../main.c"
+#undef main
+
+#include "bench.h"
+
+static jmp_buf m_sleep_jmp;
+
+void host_sleep_hook(void)
+{
+    longjmp(m_sleep_jmp, 1);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Same conversion as tools/adv_records.py.
+static void key_to_record(const uint8_t key[28], adv_record_t *record)
+{
+    static const uint8_t head[7] = { 0x1e, 0xff, 0x4c, 0x00, 0x12, 0x19, 0x00 };
+
+    for (int i = 0; i < ADV_RECORD_ADDR_LEN; i++) {
+        record->addr[i] = key[5 - i];
+    }
+    record->addr[5] |= 0xC0;
+    memcpy(record->data, head, sizeof(head));
+    memcpy(&record->data[7], &key[6], 22);
+    record->data[29] = key[0] >> 6;
+    record->data[30] = 0x00;
+}
+
+// Check that the SoftDevice is advertising what the current key dictates.
+static void verify_advertised(int index)
+{
+    uint8_t key[28];
+    expected_key(index, key);
+
+    if (sd_stub_addr[5] != (key[0] | 0xC0) || sd_stub_addr[0] != key[5] ||
+        sd_stub_adv_data == NULL || sd_stub_adv_data_len != 31 || sd_stub_adv_data[0] != 0x1e ||
+        memcmp(&sd_stub_adv_data[7], &key[6], 22) != 0 ||
+        sd_stub_adv_data[29] != (key[0] >> 6)) {
+        fprintf(stderr, "%s: advertised data does not match key %d\n", BENCH_VARIANT, index);
+        exit(1);
+    }
+}
+
+// Run the main loop until the queued rotation is on air.
+static void settle_rotation(void)
+{
+    process_pending_work();
+#if defined(GAPLESS_ROTATION) && GAPLESS_ROTATION == 1
+    // The swap waits for the end of the current advertising event, the
+    // gap measurement for the end of the first one on the new key.
+    sd_stub_adv_event();
+    process_pending_work();
+    sd_stub_adv_event();
+    process_pending_work();
+#endif
+#if defined(ROTATION_JOURNAL) && ROTATION_JOURNAL == 1
+    // The SoftDevice gets to the journal write between advertising events.
+    while (sd_stub_flash_event()) {
+        process_pending_work();
+    }
+#endif
+#if defined(BATTERY_ASYNC) && BATTERY_ASYNC == 1
+    while (sd_stub_saadc_event()) {
+        process_pending_work();
+    }
+#endif
+}
+
+// Fire the wake-up timer until the scheduler queues the job, within
+// max_wakeups. The main loop runs the jobs of the wake-ups before, the timer
+// interrupt must only queue them. Nothing to fire for jobs the firmware
+// didn't add.
+static void fire_until_within(uint8_t job, uint32_t max_wakeups)
+{
+    if (job == UINT8_MAX) {
+        return;
+    }
+    uint32_t runs = wakeup_stats.runs[job];
+    for (uint32_t i = 0; wakeup_stats.runs[job] == runs; i++) {
+        if (i > max_wakeups || !m_wakeup_timer_id->running) {
+            fprintf(stderr, "%s: job %u not run after %u wake-ups\n", BENCH_VARIANT, (unsigned)job, (unsigned)i);
+            exit(1);
+        }
+        if (i > 0) {
+            settle_rotation();
+        }
+        uint32_t calls = sd_stub_softdevice_calls();
+        sd_stub_timer_fire(m_wakeup_timer_id);
+        if (sd_stub_softdevice_calls() != calls) {
+            fprintf(stderr, "%s: SoftDevice called from the timer interrupt\n", BENCH_VARIANT);
+            exit(1);
+        }
+    }
+}
+
+// Within the wake-ups one rotation interval takes: the idle ones of intervals
+// longer than the RTC can time, the bursts and the battery readings.
+static void fire_until(uint8_t job)
+{
+    fire_until_within(job, ROTATION_INTERVAL_TICKS / WAKEUP_MAX_SLEEP_TICKS + ADV_BURSTS + KEY_ROTATION_INTERVAL / 86400);
+}
+
+// Fire the wake-up timer up to the next rotation, which must fall a whole
+// number of rotation intervals after the scheduler started.
+static void fire_rotation_timer(void)
+{
+    fire_until(m_rotation_job);
+    if (m_rotation_job != UINT8_MAX &&
+        sd_stub_rtc_ticks - m_wakeup_start_ticks != (uint32_t)(wakeup_stats.runs[m_rotation_job] * ROTATION_INTERVAL_TICKS)) {
+        fprintf(stderr, "%s: rotation %u at tick %u, %llu ticks apart\n", BENCH_VARIANT,
+                (unsigned)wakeup_stats.runs[m_rotation_job], (unsigned)(sd_stub_rtc_ticks - m_wakeup_start_ticks),
+                (unsigned long long)ROTATION_INTERVAL_TICKS);
+        exit(1);
+    }
+}
+
+// Index of the key on air.
+static int on_air_index(void)
+{
+#if defined(DERIVE_KEYS) && DERIVE_KEYS == 1
+    return (int)rotation_position - 1;
+#else
+    return current_index;
+#endif
+}
+
+static int check_adv_config_on_air(const ble_adv_config_t *p_config)
+{
+#if NRF_SDK_VERSION >= 15
+    uint16_t duration = p_config->duration_s * 100;
+#else
+    uint16_t duration = p_config->duration_s;
+#endif
+    uint8_t channels;
+    switch (p_config->channels) {
+        case ADV_CHANNELS_SINGLE:
+            channels = 1 << (p_config->channel - ADV_CHANNEL_FIRST);
+            break;
+        case ADV_CHANNELS_ROTATE:
+            // Any one of them.
+            channels = (sd_stub_adv_channels & (sd_stub_adv_channels - 1)) == 0 ? sd_stub_adv_channels : 0;
+            break;
+        default:
+            channels = 0x07;
+            break;
+    }
+#if defined(ADV_FULL_POWER_EVERY)
+    // Events between the full-power ones go out at the low power.
+    bool tx_power_ok = sd_stub_tx_power == p_config->tx_power ||
+                       sd_stub_tx_power == ble_adv_low_tx_power(p_config->tx_power);
+#else
+    bool tx_power_ok = sd_stub_tx_power == p_config->tx_power;
+#endif
+    if (!sd_stub_advertising || sd_stub_adv_interval != MSEC_TO_UNITS(p_config->interval_ms, UNIT_0_625_MS) ||
+        sd_stub_adv_duration != duration || !tx_power_ok ||
+        channels == 0 || sd_stub_adv_channels != channels) {
+        fprintf(stderr, "%s: advertising every %u units at %d dBm for %u on channels 0x%x, "
+                "expected %u ms at %d dBm for %u s on profile %u\n",
+                BENCH_VARIANT, (unsigned)sd_stub_adv_interval, sd_stub_tx_power, (unsigned)sd_stub_adv_duration,
+                (unsigned)sd_stub_adv_channels, (unsigned)p_config->interval_ms, p_config->tx_power,
+                (unsigned)p_config->duration_s, (unsigned)p_config->channels);
+        return 1;
+    }
+    verify_advertised(on_air_index());
+    return 0;
+}
+
+#include "bench_keys.c"
+#include "bench_random.c"
+#include "bench_gapless.c"
+#include "bench_wakeup.c"
+#include "bench_journal.c"
+#include "bench_schedule.c"
+#include "bench_adv_config.c"
+#include "bench_tx_schedule.c"
+#include "bench_bursts.c"
+#include "bench_low_power.c"
+#include "bench_ram_power.c"
+#include "bench_fast_find.c"
+#include "bench_governor.c"
+#include "bench_battery_pof.c"
+#include "bench_battery.c"
+
+int main(int argc, char **argv)
+{
+    long rotations = argc > 1 ? strtol(argv[1], NULL, 0) : BENCH_DEFAULT_ROTATIONS;
+
+#if defined(ROTATION_JOURNAL) && ROTATION_JOURNAL == 1
+    memset(journal_region, 0xFF, sizeof(journal_region));
+#endif
+
+#if defined(DERIVE_KEYS) && DERIVE_KEYS == 1
+    const uint16_t boot_key_count = UINT16_MAX;
+    patch_master_key();
+#else
+    const uint16_t boot_key_count = BENCH_KEYS;
+
+    // A table larger than the region must be rejected, one that fills it accepted.
+    patch_keys(BENCH_KEYS);
+    ((adv_keys_header_t *)key_region)->count = BENCH_KEYS + 1;
+    if (key_capacity() != BENCH_KEYS || find_key_count() != 0) {
+        fprintf(stderr, "%s: key table region capacity %u, expected %u\n", BENCH_VARIANT,
+                (unsigned)key_capacity(), (unsigned)BENCH_KEYS);
+        return 1;
+    }
+    patch_keys(BENCH_KEYS);
+#endif
+
+#if defined(ADV_SCHEDULE) && ADV_SCHEDULE == 1
+    patch_schedule();
+#endif
+
+#if defined(POWER_GOVERNOR) && POWER_GOVERNOR == 1
+    // A full battery at boot, the governor steps are checked on their own.
+    sd_stub_vbatt_mv = governor_level_mv[0];
+#endif
+
+    uint64_t boot_start = now_ns();
+    if (setjmp(m_sleep_jmp) == 0) {
+        firmware_main();
+        fprintf(stderr, "%s: firmware returned from main\n", BENCH_VARIANT);
+        return 1;
+    }
+    uint64_t boot_elapsed = now_ns() - boot_start;
+    uint32_t boot_calls = sd_stub_softdevice_calls();
+    uint32_t boot_tx_failed = sd_stub_stats.tx_power_set_failed;
+
+    if (key_count != boot_key_count || !sd_stub_advertising) {
+        fprintf(stderr, "%s: boot failed (key_count %u)\n", BENCH_VARIANT, (unsigned)key_count);
+        return 1;
+    }
+    verify_advertised(on_air_index());
+
+#if defined(RANDOM_ROTATE_KEYS) && RANDOM_ROTATE_KEYS == 1
+    if (check_rng_seeded() != 0) {
+        return 1;
+    }
+#endif
+
+#if defined(BATTERY_ASYNC) && BATTERY_ASYNC == 1
+    if (check_battery_async_boot() != 0) {
+        return 1;
+    }
+#endif
+
+    // Rotations fall on the grid of the rotation interval from here.
+    m_wakeup_start_ticks = m_wakeup_timer_id->start;
+
+#if defined(ADV_SCHEDULE) && ADV_SCHEDULE == 1
+    if (check_adv_schedule() != 0) {
+        return 1;
+    }
+#endif
+
+    sd_stub_reset_stats();
+    uint64_t isr_elapsed = 0;
+    uint64_t start = now_ns();
+    for (long i = 0; i < rotations; i++) {
+        // The timer interrupt must only queue the rotation for the main loop.
+        uint64_t isr_start = now_ns();
+        fire_rotation_timer();
+        isr_elapsed += now_ns() - isr_start;
+        settle_rotation();
+    }
+    uint64_t elapsed = now_ns() - start;
+    verify_advertised(on_air_index());
+
+    double n = (double)rotations;
+    printf("%-40s %8.1f ns/rotation %6.2f sd calls/rotation "
+           "(stop %.2f addr %.2f cfg %.2f data %.2f start %.2f txp %.2f rand %.2f) "
+           "boot %.1f us, %u sd calls, %u txp probes failed, timer isr %.1f ns\n",
+           BENCH_VARIANT, (double)elapsed / n, sd_stub_softdevice_calls() / n,
+           sd_stub_stats.adv_stop / n, sd_stub_stats.addr_set / n,
+           sd_stub_stats.adv_set_configure / n, sd_stub_stats.adv_data_set / n,
+           sd_stub_stats.adv_start / n, sd_stub_stats.tx_power_set / n,
+           (sd_stub_stats.rand_bytes_available_get + sd_stub_stats.rand_vector_get) / n,
+           boot_elapsed / 1000.0, (unsigned)boot_calls, (unsigned)boot_tx_failed,
+           (double)isr_elapsed / n);
+
+#if defined(DERIVE_KEYS) && DERIVE_KEYS == 1
+    // Every key must have been derived in idle slices before its rotation.
+    if (key_derivation_stats.late != 0) {
+        fprintf(stderr, "%s: %u keys derived late\n", BENCH_VARIANT, (unsigned)key_derivation_stats.late);
+        return 1;
+    }
+#endif
+
+#if defined(GAPLESS_ROTATION) && GAPLESS_ROTATION == 1
+    if (check_rotation_gap(rotations) != 0) {
+        return 1;
+    }
+#endif
+
+#if defined(ROTATION_JOURNAL) && ROTATION_JOURNAL == 1
+    if (check_journal() != 0) {
+        return 1;
+    }
+#endif
+
+    if (check_wakeups() != 0) {
+        return 1;
+    }
+
+    if (check_adv_config() != 0) {
+        return 1;
+    }
+
+    if (check_adv_channels() != 0) {
+        return 1;
+    }
+
+    if (check_low_power_pins() != 0) {
+        return 1;
+    }
+
+#if defined(ADV_FULL_POWER_EVERY)
+    if (check_tx_schedule() != 0) {
+        return 1;
+    }
+#endif
+
+#if defined(RAM_POWER_DOWN) && RAM_POWER_DOWN == 1
+    if (check_ram_power() != 0) {
+        return 1;
+    }
+#endif
+
+#if ADV_BURST_DURATION > 0
+    if (check_adv_bursts() != 0) {
+        return 1;
+    }
+#endif
+
+#if defined(FAST_FIND_BUTTON_PIN)
+    if (check_fast_find() != 0) {
+        return 1;
+    }
+#endif
+
+#if defined(POWER_GOVERNOR) && POWER_GOVERNOR == 1
+    if (check_power_governor() != 0) {
+        return 1;
+    }
+#endif
+
+#if defined(BATTERY_POF) && BATTERY_POF == 1
+    if (check_battery_pof() != 0) {
+        return 1;
+    }
+#endif
+
+#if defined(BATTERY_LEVEL) && BATTERY_LEVEL == 1
+    if (check_battery_curve() != 0) {
+        return 1;
+    }
+#endif
+
+#if defined(BATTERY_ASYNC) && BATTERY_ASYNC == 1
+    if (check_battery_async() != 0) {
+        return 1;
+    }
+#endif
+
+#if defined(RANDOM_ROTATE_KEYS) && RANDOM_ROTATE_KEYS == 1
+    if (check_rng_pool_empty() != 0) {
+        return 1;
+    }
+#endif
+
+    // Battery status updates must be published without touching the address
+    // or stopping advertising.
+    sd_stub_reset_stats();
+    start = now_ns();
+    for (long i = 0; i < rotations; i++) {
+        set_battery(i & 1 ? 90 : 40);
+    }
+    elapsed = now_ns() - start;
+    verify_advertised(on_air_index());
+    uint8_t status = (rotations - 1) & 1 ? 0 : STATUS_FLAG_LOW_BATTERY;
+    if (sd_stub_adv_data[6] != status || !sd_stub_advertising ||
+        sd_stub_stats.adv_stop != 0 || sd_stub_stats.addr_set != 0) {
+        fprintf(stderr, "%s: status update interrupted advertising\n", BENCH_VARIANT);
+        return 1;
+    }
+
+    printf("%-40s %8.1f ns/status   %6.2f sd calls/status   "
+           "(stop %.2f addr %.2f cfg %.2f data %.2f start %.2f)\n",
+           BENCH_VARIANT, (double)elapsed / n, sd_stub_softdevice_calls() / n,
+           sd_stub_stats.adv_stop / n, sd_stub_stats.addr_set / n,
+           sd_stub_stats.adv_set_configure / n, sd_stub_stats.adv_data_set / n,
+           sd_stub_stats.adv_start / n);
+
+#if defined(DERIVE_KEYS) && DERIVE_KEYS == 1
+    if (check_key_derivation() != 0) {
+        return 1;
+    }
+#endif
+    return 0;
+}
\ No newline at end of file
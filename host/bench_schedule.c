@@ -0,0 +1,128 @@
+/*
+ * Host benchmark: the advertising schedule, see bench.h.
+ */
+
+#if defined(ADV_SCHEDULE) && ADV_SCHEDULE == 1
+// Patched on Monday 2024-01-01 06:00 local time, on a tag whose RTC runs
+// BENCH_SCHEDULE_DRIFT_PPM fast.
+#define BENCH_SCHEDULE_PROVISIONED (1704067200u + 6 * 60 * 60)
+#define BENCH_SCHEDULE_DRIFT_PPM 250
+
+// What tools/adv_records.py --schedule writes for
+//     mon 07:00
+//     mon 12:00 interval=2000 tx=-8
+//     mon 19:00 off
+//     tue 07:00 interval=500
+static const adv_schedule_entry_t bench_schedule[BENCH_SCHEDULE_ENTRIES] = {
+    { 7 * 60, 0, ADV_SCHEDULE_TX_POWER_BOOT, 0 },
+    { 12 * 60, 2000, -8, 0 },
+    { 19 * 60, 0, ADV_SCHEDULE_TX_POWER_BOOT, ADV_SCHEDULE_OFF },
+    { (24 + 7) * 60, 500, ADV_SCHEDULE_TX_POWER_BOOT, 0 },
+};
+
+
+// Behind the key table or the seed, unaligned, the way the patch step writes it.
+static uint8_t *schedule_region(void)
+{
+    const adv_keys_header_t *header = (const adv_keys_header_t *)key_region;
+    return key_region + sizeof(adv_keys_header_t) + header->count * header->record_size;
+}
+
+static void patch_schedule(void)
+{
+    adv_schedule_header_t header = {
+        .magic = {'H', 'S', 'K', 'S'},
+        .version = ADV_SCHEDULE_VERSION,
+        .count = BENCH_SCHEDULE_ENTRIES,
+        .drift_ppm = BENCH_SCHEDULE_DRIFT_PPM,
+        .provisioned = BENCH_SCHEDULE_PROVISIONED,
+    };
+    memcpy(schedule_region(), &header, sizeof(header));
+    memcpy(schedule_region() + sizeof(header), bench_schedule, sizeof(bench_schedule));
+}
+
+// RTC ticks from the start of the scheduler to seconds after the patch.
+static uint64_t schedule_ticks(uint32_t seconds)
+{
+    uint64_t real = (uint64_t)seconds * COMPAT_APP_TIMER_FREQUENCY;
+    return (real * (1000000 + BENCH_SCHEDULE_DRIFT_PPM) + 999999) / 1000000;
+}
+
+// Configuration of a schedule entry on the boot one.
+static void schedule_entry_config(const adv_schedule_entry_t *p_entry, ble_adv_config_t *p_config)
+{
+    *p_config = m_schedule_base;
+    if (p_entry->interval_ms != 0) {
+        p_config->interval_ms = p_entry->interval_ms;
+    }
+    if (p_entry->tx_power != ADV_SCHEDULE_TX_POWER_BOOT) {
+        p_config->tx_power = p_entry->tx_power;
+    }
+}
+
+// The last entry of the week is in force at boot. Each entry switches the
+// profile at its minute of the week, on the RTC running fast, right away;
+// while advertising is off the keys still rotate. Without a schedule the
+// last switch goes back to the boot configuration, which the other checks
+// run with, and the job doesn't wake the tag up again.
+static int check_adv_schedule(void)
+{
+    const uint32_t max_wakeups = 2 * 7 * DAY_TICKS / MIN(BURST_INTERVAL_TICKS, WAKEUP_MAX_SLEEP_TICKS);
+    uint32_t boot_switches = adv_schedule_stats.switches;
+    ble_adv_config_t config;
+
+    schedule_entry_config(&bench_schedule[BENCH_SCHEDULE_ENTRIES - 1], &config);
+    if (m_schedule_job == UINT8_MAX || adv_schedule_stats.entry != BENCH_SCHEDULE_ENTRIES - 1 ||
+        check_adv_config_on_air(&config) != 0) {
+        fprintf(stderr, "%s: schedule entry %u at boot\n", BENCH_VARIANT, (unsigned)adv_schedule_stats.entry);
+        return 1;
+    }
+
+    for (uint8_t i = 0; i < BENCH_SCHEDULE_ENTRIES; i++) {
+        const adv_schedule_entry_t *p_entry = &bench_schedule[i];
+        uint64_t expected = schedule_ticks((p_entry->start_min - 6 * 60) * 60);
+
+        fire_until_within(m_schedule_job, max_wakeups);
+        settle_rotation();
+        if (wakeup_time() + 1 < expected || wakeup_time() > expected + 1 || adv_schedule_stats.entry != i) {
+            fprintf(stderr, "%s: schedule entry %u at tick %llu, expected %llu\n", BENCH_VARIANT,
+                    (unsigned)adv_schedule_stats.entry, (unsigned long long)wakeup_time(),
+                    (unsigned long long)expected);
+            return 1;
+        }
+
+        if (p_entry->flags & ADV_SCHEDULE_OFF) {
+            fire_rotation_timer();
+            settle_rotation();
+            if (sd_stub_advertising) {
+                fprintf(stderr, "%s: advertising during schedule entry %u\n", BENCH_VARIANT, (unsigned)i);
+                return 1;
+            }
+            continue;
+        }
+
+        schedule_entry_config(p_entry, &config);
+        if (check_adv_config_on_air(&config) != 0) {
+            fprintf(stderr, "%s: schedule entry %u not on air\n", BENCH_VARIANT, (unsigned)i);
+            return 1;
+        }
+    }
+
+    uint32_t switches = adv_schedule_stats.switches - boot_switches;
+    schedule_region()[0] ^= 0xFF;
+    if (adv_schedule_init(schedule_region(), __stop_adv_keys, 0)) {
+        fprintf(stderr, "%s: schedule with a bad header loaded\n", BENCH_VARIANT);
+        return 1;
+    }
+    fire_until_within(m_schedule_job, max_wakeups);
+    settle_rotation();
+    if (check_adv_config_on_air(&m_schedule_base) != 0 || wakeup_count(1u << m_schedule_job, 7 * DAY_TICKS) != 0) {
+        fprintf(stderr, "%s: boot configuration not back without a schedule\n", BENCH_VARIANT);
+        return 1;
+    }
+
+    printf("%-40s %u schedule switches in a week, on time within a tick at %d ppm\n",
+           BENCH_VARIANT, (unsigned)switches, BENCH_SCHEDULE_DRIFT_PPM);
+    return 0;
+}
+#endif
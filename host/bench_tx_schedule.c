@@ -0,0 +1,51 @@
+/*
+ * Host benchmark: the TX power schedule, see bench.h.
+ */
+
+#if defined(ADV_FULL_POWER_EVERY)
+// 1 in ADV_FULL_POWER_EVERY events at the configured TX power from the start
+// of advertising on, the others at the low power, with the main loop running
+// between events as it does on the chip.
+static int check_tx_schedule(void)
+{
+    const uint32_t events = 2 * ADV_FULL_POWER_EVERY;
+    ble_adv_config_t config;
+    ble_adv_config_get(&config);
+    int8_t low = ble_adv_low_tx_power(config.tx_power);
+
+    ble_advertising_restart();
+    sd_stub_reset_stats();
+    for (uint32_t i = 0; i < events; i++) {
+        int8_t expected = i % ADV_FULL_POWER_EVERY == 0 ? config.tx_power : low;
+        if (!sd_stub_advertising || sd_stub_tx_power != expected) {
+            fprintf(stderr, "%s: advertising event %u at %d dBm, expected %d dBm\n", BENCH_VARIANT,
+                    (unsigned)i, sd_stub_tx_power, expected);
+            return 1;
+        }
+        sd_stub_adv_event();
+        process_pending_work();
+    }
+
+    // The main loop only runs for the changes of power, before and after the full-power event.
+    uint32_t wakeups = sd_stub_stats.sched_events;
+    if (sd_stub_stats.tx_power_set != wakeups || wakeups != 2 * events / ADV_FULL_POWER_EVERY) {
+        fprintf(stderr, "%s: %u main loop runs and %u TX power changes in %u advertising events\n", BENCH_VARIANT,
+                (unsigned)wakeups, (unsigned)sd_stub_stats.tx_power_set, (unsigned)events);
+        return 1;
+    }
+
+#if !defined(GAPLESS_ROTATION) || GAPLESS_ROTATION == 0
+    // The first event on a new key goes out at full power.
+    fire_rotation_timer();
+    settle_rotation();
+    if (sd_stub_tx_power != config.tx_power) {
+        fprintf(stderr, "%s: new key advertised at %d dBm first\n", BENCH_VARIANT, sd_stub_tx_power);
+        return 1;
+    }
+#endif
+
+    printf("%-40s 1 in %d advertising events at %d dBm, the others at %d dBm, %u main loop runs in %u events\n",
+           BENCH_VARIANT, ADV_FULL_POWER_EVERY, config.tx_power, low, (unsigned)wakeups, (unsigned)events);
+    return 0;
+}
+#endif
@@ -0,0 +1,45 @@
+/*
+ * Host benchmark: the wake-up scheduler, see bench.h.
+ */
+
+// The scheduler wakes up as often in a day as it projects, and with
+// bursts every rotation restarts advertising once for both.
+static int check_wakeups(void)
+{
+#if defined(ADV_SCHEDULE) && ADV_SCHEDULE == 1
+    const uint8_t jobs[] = {m_battery_job, m_rotation_job, m_burst_job, m_schedule_job};
+#else
+    const uint8_t jobs[] = {m_battery_job, m_rotation_job, m_burst_job};
+#endif
+    uint32_t projected = wakeup_count(WAKEUP_ALL_JOBS, DAY_TICKS);
+    uint32_t separate = 0;
+    for (size_t i = 0; i < sizeof(jobs); i++) {
+        if (jobs[i] != UINT8_MAX) {
+            separate += wakeup_count(1u << jobs[i], DAY_TICKS);
+        }
+    }
+
+    wakeup_stats_t before = wakeup_stats;
+    uint32_t day_start = m_wakeup_timer_id->start;
+    while (m_wakeup_timer_id->running &&
+           m_wakeup_timer_id->start + m_wakeup_timer_id->ticks - day_start <= DAY_TICKS) {
+        sd_stub_timer_fire(m_wakeup_timer_id);
+        settle_rotation();
+    }
+
+    uint32_t wakeups = wakeup_stats.wakeups - before.wakeups;
+    uint32_t merged = wakeup_stats.radio_merged - before.radio_merged;
+    uint32_t rotations = m_rotation_job == UINT8_MAX ? 0 : wakeup_stats.runs[m_rotation_job] - before.runs[m_rotation_job];
+    if (wakeups != projected || projected > separate ||
+        merged != (m_burst_job == UINT8_MAX ? 0 : rotations)) {
+        fprintf(stderr, "%s: %u wake-ups in a day, %u projected, %u with a timer each, %u bursts merged in %u rotations\n",
+                BENCH_VARIANT, (unsigned)wakeups, (unsigned)projected, (unsigned)separate, (unsigned)merged,
+                (unsigned)rotations);
+        return 1;
+    }
+
+    printf("%-40s %u wake-ups a day, %u with a timer per job; %u jobs shared one, %u radio restarts merged\n",
+           BENCH_VARIANT, (unsigned)wakeups, (unsigned)separate,
+           (unsigned)(wakeup_stats.shared - before.shared), (unsigned)merged);
+    return 0;
+}
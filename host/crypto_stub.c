@@ -0,0 +1,118 @@
+/*
+ * nrf_crypto stand-in for the host build, see include/nrf_crypto.h.
+ */
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/obj_mac.h>
+
+#include "nrf_crypto.h"
+
+const nrf_crypto_hash_info_t g_nrf_crypto_hash_sha256_info;
+const nrf_crypto_ecc_curve_info_t g_nrf_crypto_ecc_secp224r1_curve_info;
+
+static EC_GROUP *m_secp224r1;
+
+ret_code_t nrf_crypto_init(void)
+{
+    if (m_secp224r1 == NULL) {
+        m_secp224r1 = EC_GROUP_new_by_curve_name(NID_secp224r1);
+    }
+    return m_secp224r1 != NULL ? NRF_SUCCESS : NRF_ERROR_INTERNAL;
+}
+
+ret_code_t nrf_crypto_hash_calculate(nrf_crypto_hash_context_t *p_context,
+                                     const nrf_crypto_hash_info_t *p_info,
+                                     const uint8_t *p_data, size_t data_size,
+                                     uint8_t *p_digest, size_t *p_digest_size)
+{
+    unsigned int size = 0;
+
+    sd_stub_stats.crypto_hash++;
+    if (*p_digest_size < NRF_CRYPTO_HASH_SIZE_SHA256 ||
+        !EVP_Digest(p_data, data_size, p_digest, &size, EVP_sha256(), NULL)) {
+        return NRF_ERROR_INTERNAL;
+    }
+    *p_digest_size = size;
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_crypto_ecc_private_key_from_raw(const nrf_crypto_ecc_curve_info_t *p_curve_info,
+                                               nrf_crypto_ecc_private_key_t *p_private_key,
+                                               const uint8_t *p_raw_data, size_t raw_data_size)
+{
+    if (raw_data_size != sizeof(p_private_key->raw)) {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    memcpy(p_private_key->raw, p_raw_data, raw_data_size);
+    return NRF_SUCCESS;
+}
+
+// Point of a raw public key, NULL if it isn't on the curve.
+static EC_POINT *public_key_point(const uint8_t *p_raw)
+{
+    BIGNUM *x = BN_bin2bn(p_raw, 28, NULL);
+    BIGNUM *y = BN_bin2bn(p_raw + 28, 28, NULL);
+    EC_POINT *point = EC_POINT_new(m_secp224r1);
+
+    if (x == NULL || y == NULL || point == NULL ||
+        !EC_POINT_set_affine_coordinates(m_secp224r1, point, x, y, NULL) ||
+        EC_POINT_is_on_curve(m_secp224r1, point, NULL) != 1) {
+        EC_POINT_free(point);
+        point = NULL;
+    }
+    BN_free(y);
+    BN_free(x);
+    return point;
+}
+
+ret_code_t nrf_crypto_ecc_public_key_from_raw(const nrf_crypto_ecc_curve_info_t *p_curve_info,
+                                              nrf_crypto_ecc_public_key_t *p_public_key,
+                                              const uint8_t *p_raw_data, size_t raw_data_size)
+{
+    if (raw_data_size != sizeof(p_public_key->raw)) {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    EC_POINT *point = public_key_point(p_raw_data);
+    if (point == NULL) {
+        return NRF_ERROR_INVALID_DATA;
+    }
+    EC_POINT_free(point);
+    memcpy(p_public_key->raw, p_raw_data, raw_data_size);
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_crypto_ecdh_compute(nrf_crypto_ecdh_context_t *p_context,
+                                   const nrf_crypto_ecc_private_key_t *p_private_key,
+                                   const nrf_crypto_ecc_public_key_t *p_public_key,
+                                   uint8_t *p_shared_secret, size_t *p_shared_secret_size)
+{
+    ret_code_t ret = NRF_ERROR_INTERNAL;
+    BIGNUM *d = BN_bin2bn(p_private_key->raw, sizeof(p_private_key->raw), NULL);
+    BIGNUM *x = BN_new();
+    EC_POINT *peer = public_key_point(p_public_key->raw);
+    EC_POINT *point = EC_POINT_new(m_secp224r1);
+
+    sd_stub_stats.crypto_ecdh++;
+    if (*p_shared_secret_size < NRF_CRYPTO_ECDH_SECP224R1_SHARED_SECRET_SIZE) {
+        ret = NRF_ERROR_INVALID_LENGTH;
+    } else if (d != NULL && x != NULL && peer != NULL && point != NULL &&
+               EC_POINT_mul(m_secp224r1, point, NULL, peer, d, NULL) &&
+               EC_POINT_get_affine_coordinates(m_secp224r1, point, x, NULL, NULL) &&
+               BN_bn2binpad(x, p_shared_secret, 28) == 28) {
+        *p_shared_secret_size = NRF_CRYPTO_ECDH_SECP224R1_SHARED_SECRET_SIZE;
+        ret = NRF_SUCCESS;
+    }
+
+    EC_POINT_free(point);
+    EC_POINT_free(peer);
+    BN_free(x);
+    BN_clear_free(d);
+    return ret;
+}
+
+ret_code_t nrf_crypto_ecc_private_key_free(nrf_crypto_ecc_private_key_t *p_private_key)
+{
+    memset(p_private_key, 0, sizeof(*p_private_key));
+    return NRF_SUCCESS;
+}
@@ -0,0 +1,2 @@
+/* Host stand-in, see sd_stub.h. */
+#include "../../../sd_stub.h"
@@ -0,0 +1,12 @@
+/* Host stand-in, see sd_stub.h. */
+#include "sd_stub.h"
+
+/*
+ * Low-power pin map of the bench board: PA/LNA lines held low as on the
+ * yj17024, one pin of each other state and the crystal pins left alone.
+ */
+#define LOW_POWER_PINS_PULLUP      (1u << 5)
+#define LOW_POWER_PINS_PULLDOWN    (1u << 6)
+#define LOW_POWER_PINS_OUTPUT_LOW  ((1u << 24) | (1u << 20))
+#define LOW_POWER_PINS_OUTPUT_HIGH (1u << 7)
+#define LOW_POWER_PINS_KEEP        ((1u << 0) | (1u << 1))
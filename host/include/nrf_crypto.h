@@ -0,0 +1,51 @@
+/*
+ * Host stand-in for the nrf_crypto calls of key_derivation.c, backed by
+ * OpenSSL (host/crypto_stub.c). Only SHA-256 and secp224r1 ECDH are
+ * provided. Calls are counted in sd_stub_stats.
+ */
+#ifndef NRF_CRYPTO_STUB_H
+#define NRF_CRYPTO_STUB_H
+
+#include "sd_stub.h"
+
+#define NRF_CRYPTO_HASH_SIZE_SHA256 32
+#define NRF_CRYPTO_ECC_SECP224R1_RAW_PRIVATE_KEY_SIZE 28
+#define NRF_CRYPTO_ECC_SECP224R1_RAW_PUBLIC_KEY_SIZE 56
+#define NRF_CRYPTO_ECDH_SECP224R1_SHARED_SECRET_SIZE 28
+
+typedef uint8_t nrf_crypto_hash_sha256_digest_t[NRF_CRYPTO_HASH_SIZE_SHA256];
+
+typedef struct { uint8_t unused; } nrf_crypto_hash_context_t;
+typedef struct { uint8_t unused; } nrf_crypto_hash_info_t;
+typedef struct { uint8_t unused; } nrf_crypto_ecc_curve_info_t;
+typedef struct { uint8_t unused; } nrf_crypto_ecdh_context_t;
+
+typedef struct {
+    uint8_t raw[NRF_CRYPTO_ECC_SECP224R1_RAW_PRIVATE_KEY_SIZE];
+} nrf_crypto_ecc_private_key_t;
+
+typedef struct {
+    uint8_t raw[NRF_CRYPTO_ECC_SECP224R1_RAW_PUBLIC_KEY_SIZE];
+} nrf_crypto_ecc_public_key_t;
+
+extern const nrf_crypto_hash_info_t g_nrf_crypto_hash_sha256_info;
+extern const nrf_crypto_ecc_curve_info_t g_nrf_crypto_ecc_secp224r1_curve_info;
+
+ret_code_t nrf_crypto_init(void);
+ret_code_t nrf_crypto_hash_calculate(nrf_crypto_hash_context_t *p_context,
+                                     const nrf_crypto_hash_info_t *p_info,
+                                     const uint8_t *p_data, size_t data_size,
+                                     uint8_t *p_digest, size_t *p_digest_size);
+ret_code_t nrf_crypto_ecc_private_key_from_raw(const nrf_crypto_ecc_curve_info_t *p_curve_info,
+                                               nrf_crypto_ecc_private_key_t *p_private_key,
+                                               const uint8_t *p_raw_data, size_t raw_data_size);
+ret_code_t nrf_crypto_ecc_public_key_from_raw(const nrf_crypto_ecc_curve_info_t *p_curve_info,
+                                              nrf_crypto_ecc_public_key_t *p_public_key,
+                                              const uint8_t *p_raw_data, size_t raw_data_size);
+ret_code_t nrf_crypto_ecdh_compute(nrf_crypto_ecdh_context_t *p_context,
+                                   const nrf_crypto_ecc_private_key_t *p_private_key,
+                                   const nrf_crypto_ecc_public_key_t *p_public_key,
+                                   uint8_t *p_shared_secret, size_t *p_shared_secret_size);
+ret_code_t nrf_crypto_ecc_private_key_free(nrf_crypto_ecc_private_key_t *p_private_key);
+
+#endif // NRF_CRYPTO_STUB_H
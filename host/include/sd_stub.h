@@ -0,0 +1,626 @@
+/*
+ * Host stand-in for the parts of the nRF5 SDK and SoftDevice that main.c and
+ * ble_stack.c use. Every sd_* / app_timer / nrf_pwr_mgmt call is recorded in
+ * sd_stub_stats so the benchmark can count SoftDevice calls per rotation.
+ *
+ * NRF_SD_BLE_API_VERSION selects the S130 (SDK12, API 2) or S112/S132
+ * (SDK15, API 6) flavour of the structures and prototypes, matching the
+ * NRF_SDK_VERSION switch in nrf5x-compat.h.
+ */
+#ifndef SD_STUB_H
+#define SD_STUB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sdk_config.h"
+
+#ifndef NRF_SD_BLE_API_VERSION
+#error "NRF_SD_BLE_API_VERSION must be defined (2 for SDK12, 6 for SDK15)"
+#endif
+
+/* nordic_common.h / app_util.h */
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) < (b) ? (b) : (a))
+#endif
+#define UNUSED_PARAMETER(X) (void)(X)
+#define UNIT_0_625_MS 625
+#define UNIT_1_25_MS  1250
+#define UNIT_10_MS    10000
+#define MSEC_TO_UNITS(TIME, RESOLUTION) (((TIME) * 1000) / (RESOLUTION))
+
+/* sdk_errors.h / nrf_error.h */
+typedef uint32_t ret_code_t;
+#define NRF_SUCCESS                 0
+#define NRF_ERROR_INTERNAL          3
+#define NRF_ERROR_NO_MEM            4
+#define NRF_ERROR_NOT_FOUND         5
+#define NRF_ERROR_NOT_SUPPORTED     6
+#define NRF_ERROR_INVALID_PARAM     7
+#define NRF_ERROR_INVALID_STATE     8
+#define NRF_ERROR_INVALID_LENGTH    9
+#define NRF_ERROR_INVALID_FLAGS     10
+#define NRF_ERROR_INVALID_DATA      11
+#define NRF_ERROR_DATA_SIZE         12
+#define NRF_ERROR_TIMEOUT           13
+#define NRF_ERROR_NULL              14
+#define NRF_ERROR_FORBIDDEN         15
+#define NRF_ERROR_INVALID_ADDR      16
+#define NRF_ERROR_BUSY              17
+#define NRF_ERROR_SOC_RAND_NOT_ENOUGH_VALUES 0x2003
+
+/* app_error.h */
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t *p_file_name);
+#define APP_ERROR_HANDLER(ERR_CODE) app_error_handler((ERR_CODE), __LINE__, (const uint8_t *)__FILE__)
+#define APP_ERROR_CHECK(ERR_CODE)                       \
+    do {                                                \
+        const uint32_t LOCAL_ERR_CODE = (ERR_CODE);     \
+        if (LOCAL_ERR_CODE != NRF_SUCCESS) {            \
+            APP_ERROR_HANDLER(LOCAL_ERR_CODE);          \
+        }                                               \
+    } while (0)
+
+/* nrf_log.h / nrf_log_ctrl.h */
+void nrf_log_stub(const char *fmt, ...);
+#define NRF_LOG_INFO(...)    nrf_log_stub(__VA_ARGS__)
+#define NRF_LOG_DEBUG(...)   nrf_log_stub(__VA_ARGS__)
+#define NRF_LOG_WARNING(...) nrf_log_stub(__VA_ARGS__)
+#define NRF_LOG_ERROR(...)   nrf_log_stub(__VA_ARGS__)
+#define NRF_LOG_INIT(...)    NRF_SUCCESS
+#define NRF_LOG_PROCESS()    false
+#define NRF_LOG_FLUSH()
+#define NRF_LOG_DEFAULT_BACKENDS_INIT()
+
+/* app_timer.h */
+typedef void (*app_timer_timeout_handler_t)(void *p_context);
+typedef enum {
+    APP_TIMER_MODE_SINGLE_SHOT,
+    APP_TIMER_MODE_REPEATED
+} app_timer_mode_t;
+typedef struct {
+    app_timer_timeout_handler_t handler;
+    app_timer_mode_t mode;
+    uint32_t ticks;
+    uint32_t start;     /* sd_stub_rtc_ticks the current timeout counts from */
+    void *p_context;
+    bool running;
+} app_timer_t;
+typedef app_timer_t *app_timer_id_t;
+#define APP_TIMER_DEF(timer_id)                     \
+    static app_timer_t timer_id##_data;             \
+    static const app_timer_id_t timer_id = &timer_id##_data
+#define APP_TIMER_MIN_TIMEOUT_TICKS 5
+// The 24-bit RTC counter. Only the SDK 15 app_timer.h has the macro.
+#define SD_STUB_RTC_MAX_CNT_VAL     0x00FFFFFF
+#if NRF_SD_BLE_API_VERSION > 3
+#define APP_TIMER_MAX_CNT_VAL       SD_STUB_RTC_MAX_CNT_VAL
+#endif
+
+ret_code_t app_timer_create(app_timer_id_t const *p_timer_id, app_timer_mode_t mode,
+                            app_timer_timeout_handler_t timeout_handler);
+ret_code_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void *p_context);
+ret_code_t app_timer_stop(app_timer_id_t timer_id);
+
+#if NRF_SD_BLE_API_VERSION <= 3
+uint32_t app_timer_cnt_get(uint32_t *p_ticks);
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from, uint32_t *p_ticks_diff);
+ret_code_t app_timer_stub_init(uint32_t prescaler);
+#define APP_TIMER_TICKS(MS, PRESCALER) \
+    ((uint32_t)(((uint64_t)(MS) * 32768) / (((PRESCALER) + 1) * 1000)))
+#define APP_TIMER_INIT(PRESCALER, OP_QUEUE_SIZE, SCHEDULER_FUNC) \
+    APP_ERROR_CHECK(app_timer_stub_init(PRESCALER))
+#else
+uint32_t app_timer_cnt_get(void);
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from);
+ret_code_t app_timer_init(void);
+#define APP_TIMER_TICKS(MS) \
+    ((uint32_t)(((uint64_t)(MS) * 32768) / ((APP_TIMER_CONFIG_RTC_FREQUENCY + 1) * 1000)))
+#endif
+
+/* app_scheduler.h */
+typedef void (*app_sched_event_handler_t)(void *p_event_data, uint16_t event_size);
+#define APP_SCHED_INIT(EVENT_SIZE, QUEUE_SIZE) \
+    APP_ERROR_CHECK(app_sched_init((EVENT_SIZE), (QUEUE_SIZE), NULL))
+uint32_t app_sched_init(uint16_t max_event_size, uint16_t queue_size, void *p_evt_buffer);
+uint32_t app_sched_event_put(void const *p_event_data, uint16_t event_size,
+                             app_sched_event_handler_t handler);
+void app_sched_execute(void);
+
+/* nrf_gpio.h */
+typedef enum {
+    NRF_GPIO_PIN_NOPULL = 0,
+    NRF_GPIO_PIN_PULLDOWN = 1,
+    NRF_GPIO_PIN_PULLUP = 3,
+} nrf_gpio_pin_pull_t;
+#define NUMBER_OF_PINS 32
+typedef enum {
+    NRF_GPIO_PIN_DIR_INPUT = 0,
+    NRF_GPIO_PIN_DIR_OUTPUT = 1,
+} nrf_gpio_pin_dir_t;
+typedef enum {
+    NRF_GPIO_PIN_INPUT_CONNECT = 0,
+    NRF_GPIO_PIN_INPUT_DISCONNECT = 1,
+} nrf_gpio_pin_input_t;
+typedef enum {
+    NRF_GPIO_PIN_S0S1 = 0,
+} nrf_gpio_pin_drive_t;
+typedef enum {
+    NRF_GPIO_PIN_NOSENSE = 0,
+} nrf_gpio_pin_sense_t;
+void nrf_gpio_cfg(uint32_t pin_number, nrf_gpio_pin_dir_t dir, nrf_gpio_pin_input_t input,
+                  nrf_gpio_pin_pull_t pull, nrf_gpio_pin_drive_t drive, nrf_gpio_pin_sense_t sense);
+void nrf_gpio_cfg_default(uint32_t pin_number);
+void nrf_gpio_pin_set(uint32_t pin_number);
+void nrf_gpio_pin_clear(uint32_t pin_number);
+
+/* app_button.h */
+#define APP_BUTTON_PUSH        1
+#define APP_BUTTON_RELEASE     0
+#define APP_BUTTON_ACTIVE_HIGH 1
+#define APP_BUTTON_ACTIVE_LOW  0
+typedef void (*app_button_handler_t)(uint8_t pin_no, uint8_t button_action);
+typedef struct {
+    uint8_t pin_no;
+    uint8_t active_state;
+    nrf_gpio_pin_pull_t pull_cfg;
+    app_button_handler_t button_handler;
+} app_button_cfg_t;
+uint32_t app_button_init(app_button_cfg_t const *p_buttons, uint8_t button_count, uint32_t detection_delay);
+uint32_t app_button_enable(void);
+
+/* nrf_pwr_mgmt.h */
+ret_code_t nrf_pwr_mgmt_init(void);
+void nrf_pwr_mgmt_run(void);
+
+/* nrf_soc.h */
+#define NRF_POWER_DCDC_DISABLE 0
+#define NRF_POWER_DCDC_ENABLE  1
+uint32_t sd_power_dcdc_mode_set(uint8_t dcdc_mode);
+#if NRF_SD_BLE_API_VERSION > 3
+#define POWER_RAM_POWER_S0POWER_Msk     (1UL << 0)
+#define POWER_RAM_POWER_S1POWER_Msk     (1UL << 1)
+#define POWER_RAM_POWER_S0RETENTION_Msk (1UL << 16)
+#define POWER_RAM_POWER_S1RETENTION_Msk (1UL << 17)
+uint32_t sd_power_ram_power_clr(uint8_t index, uint32_t ram_powerset);
+#endif
+uint32_t sd_app_evt_wait(void);
+uint32_t sd_rand_application_bytes_available_get(uint8_t *p_bytes_available);
+uint32_t sd_rand_application_vector_get(uint8_t *p_buff, uint8_t length);
+
+/* Power-fail comparator, thresholds as the SoftDevice of each chip numbers them */
+#if defined(NRF51)
+#define NRF_POWER_THRESHOLD_V21 0
+#define NRF_POWER_THRESHOLD_V23 1
+#define NRF_POWER_THRESHOLD_V25 2
+#define NRF_POWER_THRESHOLD_V27 3
+#else
+#define NRF_POWER_THRESHOLD_V17 4
+#define NRF_POWER_THRESHOLD_V18 5
+#define NRF_POWER_THRESHOLD_V19 6
+#define NRF_POWER_THRESHOLD_V20 7
+#define NRF_POWER_THRESHOLD_V21 8
+#define NRF_POWER_THRESHOLD_V22 9
+#define NRF_POWER_THRESHOLD_V23 10
+#define NRF_POWER_THRESHOLD_V24 11
+#define NRF_POWER_THRESHOLD_V25 12
+#define NRF_POWER_THRESHOLD_V26 13
+#define NRF_POWER_THRESHOLD_V27 14
+#define NRF_POWER_THRESHOLD_V28 15
+#endif
+#define NRF_EVT_POWER_FAILURE_WARNING 1
+uint32_t sd_power_pof_enable(uint8_t pof_enable);
+uint32_t sd_power_pof_threshold_set(uint8_t threshold);
+
+/* Flash operations and their SoC events */
+#define NRF_EVT_FLASH_OPERATION_SUCCESS 2
+#define NRF_EVT_FLASH_OPERATION_ERROR   3
+uint32_t sd_flash_write(uint32_t *p_dst, uint32_t const *p_src, uint32_t size);
+uint32_t sd_flash_page_erase(uint32_t page_number);
+
+#if NRF_SD_BLE_API_VERSION > 3
+/* nrf_sdh_soc.h, observers are collected in a section as the SDK does */
+typedef void (*nrf_sdh_soc_evt_handler_t)(uint32_t evt_id, void *p_context);
+typedef struct {
+    nrf_sdh_soc_evt_handler_t handler;
+    void *p_context;
+} nrf_sdh_soc_evt_observer_t;
+#define NRF_SDH_SOC_OBSERVER(_name, _prio, _handler, _context)                    \
+    static const nrf_sdh_soc_evt_observer_t _name                                  \
+        __attribute__((section("sdh_soc_observers"), used, aligned(sizeof(void *)))) = \
+        { _handler, _context }
+#else
+/* softdevice_handler.h */
+typedef void (*sys_evt_handler_t)(uint32_t evt_id);
+uint32_t softdevice_sys_evt_handler_set(sys_evt_handler_t sys_evt_handler);
+#endif
+
+#define NRF_RADIO_NOTIFICATION_TYPE_NONE            0
+#define NRF_RADIO_NOTIFICATION_TYPE_INT_ON_ACTIVE   1
+#define NRF_RADIO_NOTIFICATION_TYPE_INT_ON_INACTIVE 2
+#define NRF_RADIO_NOTIFICATION_TYPE_INT_ON_BOTH     3
+#define NRF_RADIO_NOTIFICATION_DISTANCE_NONE        0
+#define NRF_RADIO_NOTIFICATION_DISTANCE_800US       1
+uint32_t sd_radio_notification_cfg_set(uint8_t type, uint8_t distance);
+
+/* nrf_nvic.h / app_util_platform.h */
+typedef int IRQn_Type;
+#define SWI1_IRQn                       21
+#define RADIO_NOTIFICATION_IRQn         SWI1_IRQn
+#define RADIO_NOTIFICATION_IRQHandler   SWI1_IRQHandler
+#if NRF_SD_BLE_API_VERSION <= 3
+#define APP_IRQ_PRIORITY_LOW            3
+#else
+#define APP_IRQ_PRIORITY_LOW            6
+#endif
+uint32_t sd_nvic_ClearPendingIRQ(IRQn_Type IRQn);
+uint32_t sd_nvic_SetPriority(IRQn_Type IRQn, uint32_t priority);
+uint32_t sd_nvic_EnableIRQ(IRQn_Type IRQn);
+void RADIO_NOTIFICATION_IRQHandler(void);
+
+/* ble_gap.h */
+#define BLE_GAP_ADDR_TYPE_PUBLIC            0x00
+#define BLE_GAP_ADDR_TYPE_RANDOM_STATIC     0x01
+#define BLE_GAP_ADDR_LEN                    6
+#define BLE_GAP_ADV_FP_ANY                  0x00
+#define BLE_GAP_PHY_1MBPS                   0x01
+
+typedef struct {
+#if NRF_SD_BLE_API_VERSION > 3
+    uint8_t addr_id_peer : 1;
+#endif
+    uint8_t addr_type : 7;
+    uint8_t addr[BLE_GAP_ADDR_LEN];
+} ble_gap_addr_t;
+
+#if NRF_SD_BLE_API_VERSION > 3
+#define BLE_GAP_ADV_SET_HANDLE_NOT_SET                          0xFF
+#define BLE_GAP_ADV_SET_DATA_SIZE_MAX                           31
+#define BLE_GAP_ADV_TYPE_NONCONNECTABLE_NONSCANNABLE_UNDIRECTED 0x03
+#define BLE_GAP_TX_POWER_ROLE_ADV                               1
+#define BLE_GAP_CH_MASK_LEN                                     5
+#define BLE_GAP_ADV_INTERVAL_MIN                                0x000020
+#define BLE_GAP_ADV_INTERVAL_MAX                                0x004000
+
+typedef uint8_t ble_gap_ch_mask_t[BLE_GAP_CH_MASK_LEN];
+
+typedef struct {
+    uint8_t type;
+    uint8_t anonymous : 1;
+    uint8_t include_tx_power : 1;
+} ble_gap_adv_properties_t;
+
+typedef struct {
+    ble_gap_adv_properties_t properties;
+    ble_gap_addr_t const *p_peer_addr;
+    uint32_t interval;
+    uint16_t duration;
+    uint8_t max_adv_evts;
+    ble_gap_ch_mask_t channel_mask;
+    uint8_t filter_policy;
+    uint8_t primary_phy;
+    uint8_t secondary_phy;
+    uint8_t set_id : 4;
+    uint8_t scan_req_notification : 1;
+} ble_gap_adv_params_t;
+
+typedef struct {
+    uint8_t *p_data;
+    uint16_t len;
+} ble_data_t;
+
+typedef struct {
+    ble_data_t adv_data;
+    ble_data_t scan_rsp_data;
+} ble_gap_adv_data_t;
+
+uint32_t sd_ble_gap_addr_set(ble_gap_addr_t const *p_addr);
+uint32_t sd_ble_gap_adv_set_configure(uint8_t *p_adv_handle, ble_gap_adv_data_t const *p_adv_data,
+                                      ble_gap_adv_params_t const *p_adv_params);
+uint32_t sd_ble_gap_adv_start(uint8_t adv_handle, uint8_t conn_cfg_tag);
+uint32_t sd_ble_gap_adv_stop(uint8_t adv_handle);
+uint32_t sd_ble_gap_tx_power_set(uint8_t role, uint16_t handle, int8_t tx_power);
+#else
+#define BLE_GAP_ADV_TYPE_ADV_NONCONN_IND    0x03
+#define BLE_GAP_ADDR_CYCLE_MODE_NONE        0x00
+#define BLE_GAP_ADV_INTERVAL_MIN            0x0020
+#define BLE_GAP_ADV_NONCON_INTERVAL_MIN     0x00A0
+#define BLE_GAP_ADV_INTERVAL_MAX            0x4000
+
+typedef struct {
+    uint8_t ch_37_off : 1;
+    uint8_t ch_38_off : 1;
+    uint8_t ch_39_off : 1;
+} ble_gap_adv_ch_mask_t;
+
+typedef struct {
+    uint8_t type;
+    ble_gap_addr_t const *p_peer_addr;
+    uint8_t fp;
+    void const *p_whitelist;
+    uint16_t interval;
+    uint16_t timeout;
+    ble_gap_adv_ch_mask_t channel_mask;
+} ble_gap_adv_params_t;
+
+uint32_t sd_ble_gap_address_set(uint8_t addr_cycle_mode, ble_gap_addr_t const *p_addr);
+uint32_t sd_ble_gap_adv_data_set(uint8_t const *p_data, uint8_t dlen,
+                                 uint8_t const *p_sr_data, uint8_t srdlen);
+uint32_t sd_ble_gap_adv_start(ble_gap_adv_params_t const *p_adv_params);
+uint32_t sd_ble_gap_adv_stop(void);
+uint32_t sd_ble_gap_tx_power_set(int8_t tx_power);
+#endif
+
+/* ble.h */
+#define BLE_COMMON_OPT_PA_LNA 0x01
+typedef struct {
+    uint8_t enable : 1;
+    uint8_t active_high : 1;
+    uint8_t gpio_pin : 6;
+} ble_pa_lna_cfg_t;
+typedef struct {
+    ble_pa_lna_cfg_t pa_cfg;
+    ble_pa_lna_cfg_t lna_cfg;
+    uint8_t ppi_ch_id_set;
+    uint8_t ppi_ch_id_clr;
+    uint8_t gpiote_ch_id;
+} ble_common_opt_pa_lna_t;
+typedef union {
+    struct {
+        ble_common_opt_pa_lna_t pa_lna;
+    } common_opt;
+} ble_opt_t;
+uint32_t sd_ble_opt_set(uint32_t opt_id, ble_opt_t const *p_opt);
+
+/* SoftDevice enable, SDK15 flavour (nrf_sdh.h / nrf_sdh_ble.h) */
+#if NRF_SD_BLE_API_VERSION > 3
+ret_code_t nrf_sdh_enable_request(void);
+ret_code_t nrf_sdh_ble_default_cfg_set(uint8_t conn_cfg_tag, uint32_t *p_ram_start);
+ret_code_t nrf_sdh_ble_enable(uint32_t *p_app_ram_start);
+#else
+/* SoftDevice enable, SDK12 flavour (softdevice_handler.h) */
+typedef struct {
+    uint8_t source;
+    uint8_t rc_ctiv;
+    uint8_t rc_temp_ctiv;
+    uint8_t xtal_accuracy;
+} nrf_clock_lf_cfg_t;
+typedef struct {
+    struct {
+        uint8_t vs_uuid_count;
+    } common_enable_params;
+} ble_enable_params_t;
+#define NRF_CLOCK_LFCLKSRC { .source = 0, .rc_ctiv = 16, .rc_temp_ctiv = 2, .xtal_accuracy = 0 }
+uint32_t softdevice_handler_init(nrf_clock_lf_cfg_t *p_clock_lf_cfg);
+uint32_t softdevice_enable_get_default_config(uint8_t central_links_count,
+                                              uint8_t periph_links_count,
+                                              ble_enable_params_t *p_ble_enable_params);
+uint32_t softdevice_enable(ble_enable_params_t *p_ble_enable_params);
+#define SOFTDEVICE_HANDLER_INIT(CLOCK_SOURCE, EVT_HANDLER) \
+    APP_ERROR_CHECK(softdevice_handler_init(CLOCK_SOURCE))
+#define CHECK_RAM_START_ADDR(C_LINK_CNT, P_LINK_CNT)
+#endif
+
+/* es_battery_voltage.h */
+void es_battery_voltage_init(void);
+void es_battery_voltage_get(uint16_t *p_vbatt);
+
+#if NRF_SD_BLE_API_VERSION > 3
+/* nrfx_saadc.h */
+typedef int16_t nrf_saadc_value_t;
+#define NRF_SAADC_RESOLUTION_10BIT      1
+#define NRF_SAADC_RESOLUTION_12BIT      2
+#define NRF_SAADC_OVERSAMPLE_DISABLED   0
+#define NRF_SAADC_OVERSAMPLE_8X         3
+#define NRF_SAADC_INPUT_VDD             9
+#define NRF_SAADC_GAIN1_6               0
+#define NRF_SAADC_REFERENCE_INTERNAL    0
+#define NRF_SAADC_ACQTIME_10US          2
+#define NRF_SAADC_BURST_DISABLED        0
+#define NRF_SAADC_BURST_ENABLED         1
+typedef struct {
+    uint8_t resolution;
+    uint8_t oversample;
+    uint8_t interrupt_priority;
+    bool low_power_mode;
+} nrfx_saadc_config_t;
+typedef struct {
+    uint8_t gain;
+    uint8_t reference;
+    uint8_t acq_time;
+    uint8_t burst;
+    uint8_t pin_p;
+} nrf_saadc_channel_config_t;
+#define NRFX_SAADC_DEFAULT_CONFIG                                               \
+    { .resolution = NRF_SAADC_RESOLUTION_10BIT, .oversample = NRF_SAADC_OVERSAMPLE_DISABLED, \
+      .interrupt_priority = 6, .low_power_mode = false }
+#define NRFX_SAADC_DEFAULT_CHANNEL_CONFIG_SE(PIN_P)                             \
+    { .gain = NRF_SAADC_GAIN1_6, .reference = NRF_SAADC_REFERENCE_INTERNAL,    \
+      .acq_time = NRF_SAADC_ACQTIME_10US, .burst = NRF_SAADC_BURST_DISABLED, .pin_p = (PIN_P) }
+typedef enum {
+    NRFX_SAADC_EVT_DONE,
+    NRFX_SAADC_EVT_LIMIT,
+    NRFX_SAADC_EVT_CALIBRATEDONE
+} nrfx_saadc_evt_type_t;
+typedef struct {
+    nrfx_saadc_evt_type_t type;
+    union {
+        struct {
+            nrf_saadc_value_t *p_buffer;
+            uint16_t size;
+        } done;
+    } data;
+} nrfx_saadc_evt_t;
+typedef void (*nrfx_saadc_event_handler_t)(nrfx_saadc_evt_t const *p_event);
+ret_code_t nrfx_saadc_init(nrfx_saadc_config_t const *p_config, nrfx_saadc_event_handler_t event_handler);
+ret_code_t nrfx_saadc_channel_init(uint8_t channel, nrf_saadc_channel_config_t const *p_config);
+ret_code_t nrfx_saadc_buffer_convert(nrf_saadc_value_t *buffer, uint16_t size);
+ret_code_t nrfx_saadc_sample(void);
+void nrfx_saadc_uninit(void);
+#endif
+
+/*
+ * Recording side of the stub, used by the host benchmark.
+ */
+typedef struct {
+    uint32_t addr_set;
+    uint32_t adv_set_configure;
+    uint32_t adv_data_set;
+    uint32_t adv_start;
+    uint32_t adv_stop;
+    uint32_t tx_power_set;
+    uint32_t tx_power_set_failed;
+    uint32_t rand_bytes_available_get;
+    uint32_t rand_vector_get;
+    uint32_t opt_set;
+    uint32_t radio_notification;
+    uint32_t power;
+    uint32_t app_timer;
+    uint32_t pwr_mgmt;
+    uint32_t battery_reads;
+    uint32_t log_lines;
+    uint32_t adv_events;
+    uint32_t adv_channel_tx;
+    uint32_t sched_events;
+    uint32_t crypto_hash;
+    uint32_t crypto_ecdh;
+    uint32_t flash_write;
+    uint32_t flash_erase;
+    uint32_t saadc_init;
+    uint32_t saadc_sample;
+    uint32_t app_button;
+} sd_stub_stats_t;
+
+extern sd_stub_stats_t sd_stub_stats;
+
+/* Advertising state as the SoftDevice would see it. */
+extern bool sd_stub_advertising;
+extern uint8_t sd_stub_addr[BLE_GAP_ADDR_LEN];
+extern const uint8_t *sd_stub_adv_data;
+extern uint16_t sd_stub_adv_data_len;
+extern int8_t sd_stub_tx_power;
+/*
+ * Advertising parameters of the last start: interval in 0.625 ms units and
+ * duration in 10 ms units (S132) or seconds (S130), 0 for none. Advertising
+ * stops at the first event past the duration.
+ */
+extern uint32_t sd_stub_adv_interval;
+extern uint16_t sd_stub_adv_duration;
+/*
+ * Primary channels of the last start, bit 0 for channel 37, and the
+ * advertising events sent on each of them.
+ */
+extern uint8_t sd_stub_adv_channels;
+extern uint32_t sd_stub_adv_channel_events[3];
+
+/* Battery voltage returned by es_battery_voltage_get(), in mV. */
+extern uint16_t sd_stub_vbatt_mv;
+
+#if NRF_SD_BLE_API_VERSION > 3
+/*
+ * SAADC state. The conversion started by nrfx_saadc_sample() reads
+ * sd_stub_vbatt_mv plus sd_stub_saadc_noise_mv, which only applies to that one
+ * conversion, and completes in sd_stub_saadc_event(), which returns false if
+ * none was in flight.
+ */
+extern bool sd_stub_saadc_initialized;
+extern nrfx_saadc_config_t sd_stub_saadc_config;
+extern nrf_saadc_channel_config_t sd_stub_saadc_channel_config;
+extern int16_t sd_stub_saadc_noise_mv;
+bool sd_stub_saadc_event(void);
+#endif
+
+/*
+ * Buttons set up with app_button_init(), and the debounce time in RTC ticks.
+ * sd_stub_button_press() presses and releases the button on a pin once it
+ * is enabled, raising the handler as app_button does after debouncing, and
+ * returns false if no enabled button is on the pin.
+ */
+extern const app_button_cfg_t *sd_stub_buttons;
+extern uint8_t sd_stub_button_count;
+extern uint32_t sd_stub_button_detection_delay;
+extern bool sd_stub_buttons_enabled;
+bool sd_stub_button_press(uint8_t pin_no);
+
+/*
+ * PIN_CNF and OUT of every pin, and how often the pin was configured; pins
+ * nothing has configured read as connected inputs, unlike on the chip.
+ */
+typedef struct {
+    nrf_gpio_pin_dir_t dir;
+    nrf_gpio_pin_input_t input;
+    nrf_gpio_pin_pull_t pull;
+    bool out;
+    uint32_t configured;
+} sd_stub_gpio_t;
+extern sd_stub_gpio_t sd_stub_gpio[NUMBER_OF_PINS];
+
+#if NRF_SD_BLE_API_VERSION > 3
+/* POWER->RAM[n].POWER of the nRF52832, every section powered and retained at reset. */
+#define SD_STUB_RAM_BLOCKS 8
+extern uint32_t sd_stub_ram_power[SD_STUB_RAM_BLOCKS];
+#endif
+
+/* Free-running RTC counter behind app_timer_cnt_get(). */
+extern uint32_t sd_stub_rtc_ticks;
+
+/*
+ * Bytes in the SoftDevice RNG pool. Drained by sd_rand_application_vector_get()
+ * and refilled whenever a timer fires, as time passes.
+ */
+#define SD_STUB_RAND_POOL_SIZE 64
+extern uint8_t sd_stub_rand_available;
+
+void sd_stub_reset_stats(void);
+uint32_t sd_stub_softdevice_calls(void);
+
+/*
+ * Fires the handler of a running app_timer, as the RTC interrupt would: the
+ * RTC moves on to the expiry, unless advertising events already took it past.
+ */
+void sd_stub_timer_fire(app_timer_id_t timer_id);
+
+/*
+ * Runs the next advertising event: advances the RTC to its end (one advertising
+ * interval later, or right away after a (re)start) and raises the radio
+ * notification interrupt if it is configured for the end of radio activity.
+ * If the event would fall past the advertising duration, advertising stops
+ * instead.
+ */
+void sd_stub_adv_event(void);
+
+/*
+ * Flash page size of the emulated chip. Page numbers are addresses divided by
+ * it, so the host build is linked without PIE to keep them in 32 bits.
+ */
+#if defined(NRF51)
+#define SD_STUB_FLASH_PAGE_SIZE 1024
+#else
+#define SD_STUB_FLASH_PAGE_SIZE 4096
+#endif
+
+/* Makes the flash operation in flight fail, as a timeout would. */
+extern bool sd_stub_flash_fail;
+
+/*
+ * Carries out the flash operation in flight, as the SoftDevice does between
+ * radio events, and raises its SoC event. Writes can only clear bits.
+ * Returns false if no operation was in flight.
+ */
+bool sd_stub_flash_event(void);
+
+/*
+ * Power-fail comparator state: whether it is enabled, and the threshold set
+ * in mV. sd_stub_supply_drop() drops the supply to mv, raising the power
+ * failure warning if the comparator is enabled and mv is below its threshold,
+ * and returns whether it did.
+ */
+extern bool sd_stub_pof_enabled;
+extern uint16_t sd_stub_pof_threshold_mv;
+bool sd_stub_supply_drop(uint16_t mv);
+
+#endif // SD_STUB_H
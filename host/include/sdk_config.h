@@ -0,0 +1,12 @@
+/*
+ * Host stand-in for the sdk_config.h values the firmware reads directly.
+ * Mirrors the nRF52 configuration (1024 Hz app_timer RTC).
+ */
+#ifndef SDK_CONFIG_H
+#define SDK_CONFIG_H
+
+#ifndef APP_TIMER_CONFIG_RTC_FREQUENCY
+#define APP_TIMER_CONFIG_RTC_FREQUENCY 31
+#endif
+
+#endif // SDK_CONFIG_H
@@ -0,0 +1,917 @@
+/*
+ * Recording SoftDevice / SDK stand-in for the host build. Calls succeed the
+ * way the real SoftDevice would for a non-connectable advertiser and are
+ * counted in sd_stub_stats.
+ */
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sd_stub.h"
+
+sd_stub_stats_t sd_stub_stats;
+
+bool sd_stub_advertising;
+uint8_t sd_stub_addr[BLE_GAP_ADDR_LEN];
+const uint8_t *sd_stub_adv_data;
+uint16_t sd_stub_adv_data_len;
+int8_t sd_stub_tx_power;
+uint16_t sd_stub_vbatt_mv = 3000;
+uint32_t sd_stub_rtc_ticks;
+uint8_t sd_stub_rand_available = SD_STUB_RAND_POOL_SIZE;
+bool sd_stub_flash_fail;
+
+static uint32_t m_rand_state = 0x2545F491;
+
+uint32_t sd_stub_adv_interval;
+uint16_t sd_stub_adv_duration;
+uint8_t sd_stub_adv_channels;
+uint32_t sd_stub_adv_channel_events[3];
+
+// Whether advertising was (re)started since the last event, which makes the
+// next event come at once, and the RTC counter at the start.
+static bool m_adv_restarted;
+static uint32_t m_adv_start_ticks;
+
+static uint8_t m_radio_notification_type = NRF_RADIO_NOTIFICATION_TYPE_NONE;
+static bool m_radio_notification_irq_enabled;
+
+// TX power levels accepted by the SoftDevice of the emulated chip.
+#if defined(S130)
+static const int8_t m_tx_powers[] = { -40, -30, -20, -16, -12, -8, -4, 0, 4 };
+#else
+static const int8_t m_tx_powers[] = { -40, -20, -16, -12, -8, -4, 0, 3, 4 };
+#endif
+
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t *p_file_name)
+{
+    fprintf(stderr, "app_error_handler: 0x%08x at %s:%u\n",
+            (unsigned)error_code, (const char *)p_file_name, (unsigned)line_num);
+    abort();
+}
+
+void nrf_log_stub(const char *fmt, ...)
+{
+    (void)fmt;
+    sd_stub_stats.log_lines++;
+}
+
+void sd_stub_reset_stats(void)
+{
+    memset(&sd_stub_stats, 0, sizeof(sd_stub_stats));
+}
+
+uint32_t sd_stub_softdevice_calls(void)
+{
+    return sd_stub_stats.addr_set + sd_stub_stats.adv_set_configure + sd_stub_stats.adv_data_set +
+           sd_stub_stats.adv_start + sd_stub_stats.adv_stop + sd_stub_stats.tx_power_set +
+           sd_stub_stats.rand_bytes_available_get + sd_stub_stats.rand_vector_get +
+           sd_stub_stats.opt_set + sd_stub_stats.radio_notification + sd_stub_stats.power +
+           sd_stub_stats.flash_write + sd_stub_stats.flash_erase;
+}
+
+/* app_timer */
+
+#if NRF_SD_BLE_API_VERSION <= 3
+ret_code_t app_timer_stub_init(uint32_t prescaler)
+{
+    (void)prescaler;
+    sd_stub_stats.app_timer++;
+    return NRF_SUCCESS;
+}
+#else
+ret_code_t app_timer_init(void)
+{
+    sd_stub_stats.app_timer++;
+    return NRF_SUCCESS;
+}
+#endif
+
+ret_code_t app_timer_create(app_timer_id_t const *p_timer_id, app_timer_mode_t mode,
+                            app_timer_timeout_handler_t timeout_handler)
+{
+    sd_stub_stats.app_timer++;
+    if (timeout_handler == NULL) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    (*p_timer_id)->handler = timeout_handler;
+    (*p_timer_id)->mode = mode;
+    (*p_timer_id)->running = false;
+    return NRF_SUCCESS;
+}
+
+ret_code_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void *p_context)
+{
+    sd_stub_stats.app_timer++;
+    if (timeout_ticks < APP_TIMER_MIN_TIMEOUT_TICKS || timeout_ticks > SD_STUB_RTC_MAX_CNT_VAL) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    timer_id->ticks = timeout_ticks;
+    timer_id->start = sd_stub_rtc_ticks;
+    timer_id->p_context = p_context;
+    timer_id->running = true;
+    return NRF_SUCCESS;
+}
+
+ret_code_t app_timer_stop(app_timer_id_t timer_id)
+{
+    sd_stub_stats.app_timer++;
+    timer_id->running = false;
+    return NRF_SUCCESS;
+}
+
+#if NRF_SD_BLE_API_VERSION <= 3
+uint32_t app_timer_cnt_get(uint32_t *p_ticks)
+{
+    *p_ticks = sd_stub_rtc_ticks & SD_STUB_RTC_MAX_CNT_VAL;
+    return NRF_SUCCESS;
+}
+
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from, uint32_t *p_ticks_diff)
+{
+    *p_ticks_diff = (ticks_to - ticks_from) & SD_STUB_RTC_MAX_CNT_VAL;
+    return NRF_SUCCESS;
+}
+#else
+uint32_t app_timer_cnt_get(void)
+{
+    return sd_stub_rtc_ticks & SD_STUB_RTC_MAX_CNT_VAL;
+}
+
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from)
+{
+    return (ticks_to - ticks_from) & SD_STUB_RTC_MAX_CNT_VAL;
+}
+#endif
+
+void sd_stub_timer_fire(app_timer_id_t timer_id)
+{
+    if (!timer_id->running) {
+        return;
+    }
+    uint32_t expiry = timer_id->start + timer_id->ticks;
+    if ((int32_t)(expiry - sd_stub_rtc_ticks) > 0) {
+        sd_stub_rtc_ticks = expiry;
+    }
+    // A repeated timer counts its next period from the expiry, it doesn't drift.
+    timer_id->start = expiry;
+    // The RNG peripheral refills the SoftDevice pool in the meantime.
+    sd_stub_rand_available = SD_STUB_RAND_POOL_SIZE;
+    if (timer_id->mode == APP_TIMER_MODE_SINGLE_SHOT) {
+        timer_id->running = false;
+    }
+    timer_id->handler(timer_id->p_context);
+}
+
+/* app_scheduler: a plain FIFO drained by app_sched_execute() */
+
+#define SCHED_STUB_MAX_EVENTS     16
+#define SCHED_STUB_MAX_EVENT_SIZE 16
+
+static struct {
+    app_sched_event_handler_t handler;
+    uint16_t size;
+    uint8_t data[SCHED_STUB_MAX_EVENT_SIZE];
+} m_sched_queue[SCHED_STUB_MAX_EVENTS];
+static uint16_t m_sched_max_event_size;
+static uint16_t m_sched_queue_size;
+static uint32_t m_sched_head;
+static uint32_t m_sched_tail;
+
+uint32_t app_sched_init(uint16_t max_event_size, uint16_t queue_size, void *p_evt_buffer)
+{
+    (void)p_evt_buffer;
+    if (max_event_size > SCHED_STUB_MAX_EVENT_SIZE || queue_size > SCHED_STUB_MAX_EVENTS) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    m_sched_max_event_size = max_event_size;
+    m_sched_queue_size = queue_size;
+    m_sched_head = m_sched_tail = 0;
+    return NRF_SUCCESS;
+}
+
+uint32_t app_sched_event_put(void const *p_event_data, uint16_t event_size,
+                             app_sched_event_handler_t handler)
+{
+    if (event_size > m_sched_max_event_size) {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    if (m_sched_tail - m_sched_head >= m_sched_queue_size) {
+        return NRF_ERROR_NO_MEM;
+    }
+    uint32_t i = m_sched_tail++ % SCHED_STUB_MAX_EVENTS;
+    m_sched_queue[i].handler = handler;
+    m_sched_queue[i].size = event_size;
+    if (p_event_data != NULL && event_size > 0) {
+        memcpy(m_sched_queue[i].data, p_event_data, event_size);
+    }
+    sd_stub_stats.sched_events++;
+    return NRF_SUCCESS;
+}
+
+void app_sched_execute(void)
+{
+    while (m_sched_head != m_sched_tail) {
+        uint32_t i = m_sched_head++ % SCHED_STUB_MAX_EVENTS;
+        m_sched_queue[i].handler(m_sched_queue[i].size ? m_sched_queue[i].data : NULL,
+                                 m_sched_queue[i].size);
+    }
+}
+
+/* nrf_pwr_mgmt / sleep */
+
+ret_code_t nrf_pwr_mgmt_init(void)
+{
+    sd_stub_stats.pwr_mgmt++;
+    return NRF_SUCCESS;
+}
+
+/* Sleeping hands control back to the harness, see host_sleep_hook(). */
+extern void host_sleep_hook(void);
+
+void nrf_pwr_mgmt_run(void)
+{
+    sd_stub_stats.pwr_mgmt++;
+    host_sleep_hook();
+}
+
+uint32_t sd_app_evt_wait(void)
+{
+    sd_stub_stats.power++;
+    host_sleep_hook();
+    return NRF_SUCCESS;
+}
+
+/* nrf_soc */
+
+uint32_t sd_power_dcdc_mode_set(uint8_t dcdc_mode)
+{
+    (void)dcdc_mode;
+    sd_stub_stats.power++;
+    return NRF_SUCCESS;
+}
+
+bool sd_stub_pof_enabled;
+uint16_t sd_stub_pof_threshold_mv;
+
+uint32_t sd_power_pof_enable(uint8_t pof_enable)
+{
+    sd_stub_stats.power++;
+    sd_stub_pof_enabled = pof_enable != 0;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_power_pof_threshold_set(uint8_t threshold)
+{
+    sd_stub_stats.power++;
+#if defined(NRF51)
+    if (threshold > NRF_POWER_THRESHOLD_V27) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    sd_stub_pof_threshold_mv = 2100 + 200 * threshold;
+#else
+    if (threshold < NRF_POWER_THRESHOLD_V17 || threshold > NRF_POWER_THRESHOLD_V28) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    sd_stub_pof_threshold_mv = 1700 + 100 * (threshold - NRF_POWER_THRESHOLD_V17);
+#endif
+    return NRF_SUCCESS;
+}
+
+#if NRF_SD_BLE_API_VERSION > 3
+#define RAM_POWER_RESET (POWER_RAM_POWER_S0POWER_Msk | POWER_RAM_POWER_S1POWER_Msk | \
+                         POWER_RAM_POWER_S0RETENTION_Msk | POWER_RAM_POWER_S1RETENTION_Msk)
+uint32_t sd_stub_ram_power[SD_STUB_RAM_BLOCKS] = {
+    RAM_POWER_RESET, RAM_POWER_RESET, RAM_POWER_RESET, RAM_POWER_RESET,
+    RAM_POWER_RESET, RAM_POWER_RESET, RAM_POWER_RESET, RAM_POWER_RESET,
+};
+
+uint32_t sd_power_ram_power_clr(uint8_t index, uint32_t ram_powerset)
+{
+    sd_stub_stats.power++;
+    if (index >= SD_STUB_RAM_BLOCKS) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    sd_stub_ram_power[index] &= ~ram_powerset;
+    return NRF_SUCCESS;
+}
+#endif
+
+sd_stub_gpio_t sd_stub_gpio[NUMBER_OF_PINS];
+
+void nrf_gpio_cfg(uint32_t pin_number, nrf_gpio_pin_dir_t dir, nrf_gpio_pin_input_t input,
+                  nrf_gpio_pin_pull_t pull, nrf_gpio_pin_drive_t drive, nrf_gpio_pin_sense_t sense)
+{
+    assert(pin_number < NUMBER_OF_PINS);
+    sd_stub_gpio[pin_number].dir = dir;
+    sd_stub_gpio[pin_number].input = input;
+    sd_stub_gpio[pin_number].pull = pull;
+    sd_stub_gpio[pin_number].configured++;
+}
+
+void nrf_gpio_cfg_default(uint32_t pin_number)
+{
+    nrf_gpio_cfg(pin_number, NRF_GPIO_PIN_DIR_INPUT, NRF_GPIO_PIN_INPUT_DISCONNECT, NRF_GPIO_PIN_NOPULL,
+                 NRF_GPIO_PIN_S0S1, NRF_GPIO_PIN_NOSENSE);
+}
+
+void nrf_gpio_pin_set(uint32_t pin_number)
+{
+    assert(pin_number < NUMBER_OF_PINS);
+    sd_stub_gpio[pin_number].out = true;
+}
+
+void nrf_gpio_pin_clear(uint32_t pin_number)
+{
+    assert(pin_number < NUMBER_OF_PINS);
+    sd_stub_gpio[pin_number].out = false;
+}
+
+uint32_t sd_rand_application_bytes_available_get(uint8_t *p_bytes_available)
+{
+    sd_stub_stats.rand_bytes_available_get++;
+    *p_bytes_available = sd_stub_rand_available;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_rand_application_vector_get(uint8_t *p_buff, uint8_t length)
+{
+    sd_stub_stats.rand_vector_get++;
+    if (length > sd_stub_rand_available) {
+        return NRF_ERROR_SOC_RAND_NOT_ENOUGH_VALUES;
+    }
+    sd_stub_rand_available -= length;
+    for (uint8_t i = 0; i < length; i++) {
+        m_rand_state ^= m_rand_state << 13;
+        m_rand_state ^= m_rand_state >> 17;
+        m_rand_state ^= m_rand_state << 5;
+        p_buff[i] = (uint8_t)m_rand_state;
+    }
+    return NRF_SUCCESS;
+}
+
+/* ble_gap */
+
+static uint32_t tx_power_check(int8_t tx_power)
+{
+    sd_stub_stats.tx_power_set++;
+    for (size_t i = 0; i < sizeof(m_tx_powers); i++) {
+        if (m_tx_powers[i] == tx_power) {
+            sd_stub_tx_power = tx_power;
+            return NRF_SUCCESS;
+        }
+    }
+    sd_stub_stats.tx_power_set_failed++;
+    return NRF_ERROR_INVALID_PARAM;
+}
+
+#if NRF_SD_BLE_API_VERSION > 3
+static uint8_t m_adv_handle = BLE_GAP_ADV_SET_HANDLE_NOT_SET;
+// Parameters of the advertising set, used from the next start.
+static uint32_t m_adv_interval;
+static uint16_t m_adv_duration;
+static uint8_t m_adv_channels;
+
+uint32_t sd_ble_gap_addr_set(ble_gap_addr_t const *p_addr)
+{
+    sd_stub_stats.addr_set++;
+    if (sd_stub_advertising) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    memcpy(sd_stub_addr, p_addr->addr, BLE_GAP_ADDR_LEN);
+    return NRF_SUCCESS;
+}
+
+// The key table region of the bench, see bench.h.
+extern const uint8_t __start_adv_keys[] __attribute__((weak));
+extern const uint8_t __stop_adv_keys[] __attribute__((weak));
+
+uint32_t sd_ble_gap_adv_set_configure(uint8_t *p_adv_handle, ble_gap_adv_data_t const *p_adv_data,
+                                      ble_gap_adv_params_t const *p_adv_params)
+{
+    sd_stub_stats.adv_set_configure++;
+    if (*p_adv_handle == BLE_GAP_ADV_SET_HANDLE_NOT_SET) {
+        if (m_adv_handle != BLE_GAP_ADV_SET_HANDLE_NOT_SET) {
+            return NRF_ERROR_NO_MEM;
+        }
+        m_adv_handle = 0;
+        *p_adv_handle = m_adv_handle;
+    } else if (*p_adv_handle != m_adv_handle) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    // Parameters can only change while stopped; data can be swapped live
+    // as long as new buffers are supplied. Parameters without data clear it.
+    if (sd_stub_advertising && p_adv_params != NULL) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_adv_data == NULL && p_adv_params != NULL) {
+        // New parameters without data leave the set without any.
+        sd_stub_adv_data = NULL;
+        sd_stub_adv_data_len = 0;
+    } else if (p_adv_data != NULL) {
+        if (sd_stub_advertising && p_adv_data->adv_data.p_data == sd_stub_adv_data) {
+            return NRF_ERROR_INVALID_STATE;
+        }
+        if (p_adv_data->adv_data.len > BLE_GAP_ADV_SET_DATA_SIZE_MAX) {
+            return NRF_ERROR_INVALID_LENGTH;
+        }
+        // The S132 reads the buffer in place with EasyDMA, which only reaches
+        // RAM: the key table region is flash on the target.
+        if ((const uint8_t *)p_adv_data->adv_data.p_data >= __start_adv_keys &&
+            (const uint8_t *)p_adv_data->adv_data.p_data < __stop_adv_keys) {
+            return NRF_ERROR_INVALID_ADDR;
+        }
+        sd_stub_adv_data = p_adv_data->adv_data.p_data;
+        sd_stub_adv_data_len = p_adv_data->adv_data.len;
+    }
+    if (p_adv_params != NULL) {
+        // Channels 37 to 39 are bits 5 to 7 of the last byte, set to leave one out.
+        uint8_t channels = ~(p_adv_params->channel_mask[4] >> 5) & 0x07;
+        if (channels == 0) {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        m_adv_interval = p_adv_params->interval;
+        m_adv_duration = p_adv_params->duration;
+        m_adv_channels = channels;
+    }
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_adv_start(uint8_t adv_handle, uint8_t conn_cfg_tag)
+{
+    (void)conn_cfg_tag;
+    sd_stub_stats.adv_start++;
+    if (adv_handle != m_adv_handle || sd_stub_advertising || sd_stub_adv_data == NULL) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    sd_stub_advertising = true;
+    sd_stub_adv_interval = m_adv_interval;
+    sd_stub_adv_duration = m_adv_duration;
+    sd_stub_adv_channels = m_adv_channels;
+    m_adv_restarted = true;
+    m_adv_start_ticks = sd_stub_rtc_ticks;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_adv_stop(uint8_t adv_handle)
+{
+    sd_stub_stats.adv_stop++;
+    if (adv_handle != m_adv_handle || !sd_stub_advertising) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    sd_stub_advertising = false;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_tx_power_set(uint8_t role, uint16_t handle, int8_t tx_power)
+{
+    if (role != BLE_GAP_TX_POWER_ROLE_ADV || handle != m_adv_handle) {
+        sd_stub_stats.tx_power_set++;
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    return tx_power_check(tx_power);
+}
+#else
+static uint8_t m_adv_data[31];
+
+uint32_t sd_ble_gap_address_set(uint8_t addr_cycle_mode, ble_gap_addr_t const *p_addr)
+{
+    (void)addr_cycle_mode;
+    sd_stub_stats.addr_set++;
+    memcpy(sd_stub_addr, p_addr->addr, BLE_GAP_ADDR_LEN);
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_adv_data_set(uint8_t const *p_data, uint8_t dlen,
+                                 uint8_t const *p_sr_data, uint8_t srdlen)
+{
+    (void)p_sr_data;
+    (void)srdlen;
+    sd_stub_stats.adv_data_set++;
+    if (dlen > sizeof(m_adv_data)) {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    // The S130 copies the payload, so the caller's buffer is free afterwards.
+    memcpy(m_adv_data, p_data, dlen);
+    sd_stub_adv_data = m_adv_data;
+    sd_stub_adv_data_len = dlen;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_adv_start(ble_gap_adv_params_t const *p_adv_params)
+{
+    sd_stub_stats.adv_start++;
+    if (sd_stub_advertising) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    uint8_t channels = (p_adv_params->channel_mask.ch_37_off ? 0 : 1) |
+                       (p_adv_params->channel_mask.ch_38_off ? 0 : 2) |
+                       (p_adv_params->channel_mask.ch_39_off ? 0 : 4);
+    if (channels == 0) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    sd_stub_advertising = true;
+    sd_stub_adv_interval = p_adv_params->interval;
+    sd_stub_adv_duration = p_adv_params->timeout;
+    sd_stub_adv_channels = channels;
+    m_adv_restarted = true;
+    m_adv_start_ticks = sd_stub_rtc_ticks;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_adv_stop(void)
+{
+    sd_stub_stats.adv_stop++;
+    if (!sd_stub_advertising) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    sd_stub_advertising = false;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_tx_power_set(int8_t tx_power)
+{
+    return tx_power_check(tx_power);
+}
+#endif
+
+/* Flash operations */
+
+// Operation waiting for a gap between radio events, one at a time.
+static struct {
+    bool pending;
+    uint32_t *p_dst;
+    uint32_t const *p_src;
+    uint32_t words;         // 0 for a page erase
+} m_flash_op;
+
+#if NRF_SD_BLE_API_VERSION > 3
+extern const nrf_sdh_soc_evt_observer_t __start_sdh_soc_observers[] __attribute__((weak));
+extern const nrf_sdh_soc_evt_observer_t __stop_sdh_soc_observers[] __attribute__((weak));
+#else
+static sys_evt_handler_t m_sys_evt_handler;
+
+uint32_t softdevice_sys_evt_handler_set(sys_evt_handler_t sys_evt_handler)
+{
+    m_sys_evt_handler = sys_evt_handler;
+    return NRF_SUCCESS;
+}
+#endif
+
+// Raises a SoC event, as the SoftDevice interrupt does.
+static void soc_evt_dispatch(uint32_t evt_id)
+{
+#if NRF_SD_BLE_API_VERSION > 3
+    for (const nrf_sdh_soc_evt_observer_t *p_observer = __start_sdh_soc_observers;
+         p_observer < __stop_sdh_soc_observers; p_observer++) {
+        p_observer->handler(evt_id, p_observer->p_context);
+    }
+#else
+    if (m_sys_evt_handler != NULL) {
+        m_sys_evt_handler(evt_id);
+    }
+#endif
+}
+
+uint32_t sd_flash_write(uint32_t *p_dst, uint32_t const *p_src, uint32_t size)
+{
+    sd_stub_stats.flash_write++;
+    if (m_flash_op.pending) {
+        return NRF_ERROR_BUSY;
+    }
+    if (((uintptr_t)p_dst & 3) != 0 || ((uintptr_t)p_src & 3) != 0) {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (size == 0 || size > SD_STUB_FLASH_PAGE_SIZE / sizeof(uint32_t)) {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    m_flash_op.pending = true;
+    m_flash_op.p_dst = p_dst;
+    m_flash_op.p_src = p_src;
+    m_flash_op.words = size;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_flash_page_erase(uint32_t page_number)
+{
+    sd_stub_stats.flash_erase++;
+    if (m_flash_op.pending) {
+        return NRF_ERROR_BUSY;
+    }
+    m_flash_op.pending = true;
+    m_flash_op.p_dst = (uint32_t *)((uintptr_t)page_number * SD_STUB_FLASH_PAGE_SIZE);
+    m_flash_op.p_src = NULL;
+    m_flash_op.words = 0;
+    return NRF_SUCCESS;
+}
+
+bool sd_stub_flash_event(void)
+{
+    if (!m_flash_op.pending) {
+        return false;
+    }
+    m_flash_op.pending = false;
+
+    uint32_t evt_id = NRF_EVT_FLASH_OPERATION_ERROR;
+    if (!sd_stub_flash_fail) {
+        if (m_flash_op.words == 0) {
+            memset(m_flash_op.p_dst, 0xFF, SD_STUB_FLASH_PAGE_SIZE);
+        } else {
+            for (uint32_t i = 0; i < m_flash_op.words; i++) {
+                m_flash_op.p_dst[i] &= m_flash_op.p_src[i];
+            }
+        }
+        evt_id = NRF_EVT_FLASH_OPERATION_SUCCESS;
+    }
+    sd_stub_flash_fail = false;
+
+    soc_evt_dispatch(evt_id);
+    return true;
+}
+
+bool sd_stub_supply_drop(uint16_t mv)
+{
+    if (!sd_stub_pof_enabled || mv >= sd_stub_pof_threshold_mv) {
+        return false;
+    }
+
+    soc_evt_dispatch(NRF_EVT_POWER_FAILURE_WARNING);
+    return true;
+}
+
+/* Radio notification */
+
+uint32_t sd_radio_notification_cfg_set(uint8_t type, uint8_t distance)
+{
+    (void)distance;
+    sd_stub_stats.radio_notification++;
+    if (type > NRF_RADIO_NOTIFICATION_TYPE_INT_ON_BOTH) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    m_radio_notification_type = type;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_nvic_ClearPendingIRQ(IRQn_Type IRQn)
+{
+    (void)IRQn;
+    sd_stub_stats.radio_notification++;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_nvic_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+    (void)IRQn;
+    (void)priority;
+    sd_stub_stats.radio_notification++;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_nvic_EnableIRQ(IRQn_Type IRQn)
+{
+    sd_stub_stats.radio_notification++;
+    if (IRQn == RADIO_NOTIFICATION_IRQn) {
+        m_radio_notification_irq_enabled = true;
+    }
+    return NRF_SUCCESS;
+}
+
+// Overridden by the firmware when it uses radio notifications.
+__attribute__((weak)) void RADIO_NOTIFICATION_IRQHandler(void)
+{
+}
+
+void sd_stub_adv_event(void)
+{
+    if (!sd_stub_advertising) {
+        return;
+    }
+
+    // 0.625 ms units to RTC ticks at 32768 / (APP_TIMER_CONFIG_RTC_FREQUENCY + 1) Hz.
+    uint32_t interval_ticks = (uint32_t)(((uint64_t)sd_stub_adv_interval * 625 * 32768) /
+                                         ((APP_TIMER_CONFIG_RTC_FREQUENCY + 1) * 1000000ull));
+#if NRF_SD_BLE_API_VERSION > 3
+    uint64_t duration_us = (uint64_t)sd_stub_adv_duration * 10000;
+#else
+    uint64_t duration_us = (uint64_t)sd_stub_adv_duration * 1000000;
+#endif
+    uint32_t duration_ticks = (uint32_t)((duration_us * 32768) / ((APP_TIMER_CONFIG_RTC_FREQUENCY + 1) * 1000000ull));
+    uint32_t event_ticks = sd_stub_rtc_ticks + (m_adv_restarted ? 1 : interval_ticks);
+
+    if (sd_stub_adv_duration != 0 && event_ticks - m_adv_start_ticks > duration_ticks) {
+        // The duration ran out before this event.
+        sd_stub_advertising = false;
+        return;
+    }
+    sd_stub_rtc_ticks = event_ticks;
+    m_adv_restarted = false;
+    sd_stub_stats.adv_events++;
+    for (int i = 0; i < 3; i++) {
+        if (sd_stub_adv_channels & (1 << i)) {
+            sd_stub_adv_channel_events[i]++;
+            sd_stub_stats.adv_channel_tx++;
+        }
+    }
+
+    if (m_radio_notification_irq_enabled &&
+        (m_radio_notification_type == NRF_RADIO_NOTIFICATION_TYPE_INT_ON_INACTIVE ||
+         m_radio_notification_type == NRF_RADIO_NOTIFICATION_TYPE_INT_ON_BOTH)) {
+        RADIO_NOTIFICATION_IRQHandler();
+    }
+}
+
+uint32_t sd_ble_opt_set(uint32_t opt_id, ble_opt_t const *p_opt)
+{
+    (void)opt_id;
+    (void)p_opt;
+    sd_stub_stats.opt_set++;
+    return NRF_SUCCESS;
+}
+
+/* SoftDevice enable */
+
+#if NRF_SD_BLE_API_VERSION > 3
+ret_code_t nrf_sdh_enable_request(void)
+{
+    sd_stub_stats.power++;
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_sdh_ble_default_cfg_set(uint8_t conn_cfg_tag, uint32_t *p_ram_start)
+{
+    (void)conn_cfg_tag;
+    *p_ram_start = 0x20002000;
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_sdh_ble_enable(uint32_t *p_app_ram_start)
+{
+    (void)p_app_ram_start;
+    return NRF_SUCCESS;
+}
+#else
+uint32_t softdevice_handler_init(nrf_clock_lf_cfg_t *p_clock_lf_cfg)
+{
+    (void)p_clock_lf_cfg;
+    sd_stub_stats.power++;
+    return NRF_SUCCESS;
+}
+
+uint32_t softdevice_enable_get_default_config(uint8_t central_links_count,
+                                              uint8_t periph_links_count,
+                                              ble_enable_params_t *p_ble_enable_params)
+{
+    (void)central_links_count;
+    (void)periph_links_count;
+    memset(p_ble_enable_params, 0, sizeof(*p_ble_enable_params));
+    return NRF_SUCCESS;
+}
+
+uint32_t softdevice_enable(ble_enable_params_t *p_ble_enable_params)
+{
+    (void)p_ble_enable_params;
+    return NRF_SUCCESS;
+}
+#endif
+
+/* es_battery_voltage */
+
+void es_battery_voltage_init(void)
+{
+}
+
+void es_battery_voltage_get(uint16_t *p_vbatt)
+{
+    sd_stub_stats.battery_reads++;
+    *p_vbatt = sd_stub_vbatt_mv;
+}
+
+#if NRF_SD_BLE_API_VERSION > 3
+/* nrfx_saadc */
+
+bool sd_stub_saadc_initialized;
+nrfx_saadc_config_t sd_stub_saadc_config;
+nrf_saadc_channel_config_t sd_stub_saadc_channel_config;
+int16_t sd_stub_saadc_noise_mv;
+
+static nrfx_saadc_event_handler_t m_saadc_handler;
+static nrf_saadc_value_t *m_saadc_buffer;
+static bool m_saadc_sampling;
+
+ret_code_t nrfx_saadc_init(nrfx_saadc_config_t const *p_config, nrfx_saadc_event_handler_t event_handler)
+{
+    sd_stub_stats.saadc_init++;
+    if (sd_stub_saadc_initialized) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    sd_stub_saadc_initialized = true;
+    sd_stub_saadc_config = *p_config;
+    m_saadc_handler = event_handler;
+    m_saadc_buffer = NULL;
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrfx_saadc_channel_init(uint8_t channel, nrf_saadc_channel_config_t const *p_config)
+{
+    if (!sd_stub_saadc_initialized || channel != 0) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    sd_stub_saadc_channel_config = *p_config;
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrfx_saadc_buffer_convert(nrf_saadc_value_t *buffer, uint16_t size)
+{
+    if (!sd_stub_saadc_initialized || size != 1) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    m_saadc_buffer = buffer;
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrfx_saadc_sample(void)
+{
+    sd_stub_stats.saadc_sample++;
+    if (!sd_stub_saadc_initialized || m_saadc_buffer == NULL || m_saadc_sampling) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    m_saadc_sampling = true;
+    return NRF_SUCCESS;
+}
+
+void nrfx_saadc_uninit(void)
+{
+    sd_stub_saadc_initialized = false;
+    m_saadc_sampling = false;
+    m_saadc_buffer = NULL;
+}
+
+bool sd_stub_saadc_event(void)
+{
+    if (!m_saadc_sampling) {
+        return false;
+    }
+    m_saadc_sampling = false;
+
+    // Gain 1/6 against the 0.6 V reference: 3600 mV full scale, 12 bit.
+    int32_t mv = (int32_t)sd_stub_vbatt_mv + sd_stub_saadc_noise_mv;
+    sd_stub_saadc_noise_mv = 0;
+    m_saadc_buffer[0] = (nrf_saadc_value_t)((mv * 4096 + 1800) / 3600);
+
+    nrfx_saadc_evt_t event = {
+        .type = NRFX_SAADC_EVT_DONE,
+        .data.done = { .p_buffer = m_saadc_buffer, .size = 1 },
+    };
+    m_saadc_handler(&event);
+    return true;
+}
+#endif
+
+/* app_button */
+
+const app_button_cfg_t *sd_stub_buttons;
+uint8_t sd_stub_button_count;
+uint32_t sd_stub_button_detection_delay;
+bool sd_stub_buttons_enabled;
+
+uint32_t app_button_init(app_button_cfg_t const *p_buttons, uint8_t button_count, uint32_t detection_delay)
+{
+    sd_stub_stats.app_button++;
+    if (detection_delay < APP_TIMER_MIN_TIMEOUT_TICKS) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    sd_stub_buttons = p_buttons;
+    sd_stub_button_count = button_count;
+    sd_stub_button_detection_delay = detection_delay;
+    return NRF_SUCCESS;
+}
+
+uint32_t app_button_enable(void)
+{
+    sd_stub_stats.app_button++;
+    if (sd_stub_buttons == NULL) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    sd_stub_buttons_enabled = true;
+    return NRF_SUCCESS;
+}
+
+bool sd_stub_button_press(uint8_t pin_no)
+{
+    if (!sd_stub_buttons_enabled) {
+        return false;
+    }
+    for (uint8_t i = 0; i < sd_stub_button_count; i++) {
+        if (sd_stub_buttons[i].pin_no != pin_no) {
+            continue;
+        }
+        // Reported once the pin has been stable for the detection delay.
+        sd_stub_rtc_ticks += sd_stub_button_detection_delay;
+        sd_stub_buttons[i].button_handler(pin_no, APP_BUTTON_PUSH);
+        sd_stub_rtc_ticks += sd_stub_button_detection_delay;
+        sd_stub_buttons[i].button_handler(pin_no, APP_BUTTON_RELEASE);
+        return true;
+    }
+    return false;
+}
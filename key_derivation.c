@@ -0,0 +1,208 @@
+#include "ble_stack.h"
+#include "key_derivation.h"
+
+#if defined(DERIVE_KEYS) && DERIVE_KEYS == 1
+
+#if NRF_SDK_VERSION < 15
+#error "DERIVE_KEYS needs the nrf_crypto API of SDK15 (nRF52 targets)"
+#endif
+
+#include "nrf_crypto.h"
+
+#define DERIVE_KEY_LEN NRF_CRYPTO_ECC_SECP224R1_RAW_PRIVATE_KEY_SIZE
+
+// Records of the key on air, the key waiting for the end of an advertising
+// event (GAPLESS_ROTATION) and the key being derived.
+#define DERIVE_SLOTS 3
+
+// Order of the secp224r1 base point, big endian. A hash prefix is a valid
+// scalar if it is in [1, n - 1].
+static const uint8_t secp224r1_order[DERIVE_KEY_LEN] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x16, 0xA2, 0xE0, 0xB8, 0xF0, 0x3E, 0x13, 0xDD, 0x29, 0x45, 0x5C, 0x5C, 0x2A, 0x3D,
+};
+
+typedef enum {
+    DERIVE_IDLE,
+    DERIVE_HASH,    // Hash the chain key, the index and the retry counter into a scalar u
+    DERIVE_POINT,   // Multiply the master public key by it, the expensive part
+} derive_stage_t;
+
+key_derivation_stats_t key_derivation_stats;
+
+// Hash input: chain key, index (little endian) and retry counter.
+static uint8_t m_message[DERIVE_CHAIN_KEY_LEN + sizeof(uint32_t) + 1];
+static uint8_t m_scalar[DERIVE_KEY_LEN];
+
+static derive_stage_t m_stage = DERIVE_IDLE;
+static uint32_t m_index;
+
+static adv_record_t m_records[DERIVE_SLOTS];
+static uint32_t m_record_index[DERIVE_SLOTS];
+static bool m_record_valid[DERIVE_SLOTS];
+
+static nrf_crypto_ecc_public_key_t m_master_public_key;
+static nrf_crypto_hash_context_t m_hash_context;
+static nrf_crypto_ecdh_context_t m_ecdh_context;
+
+// Same conversion as key_to_record in tools/adv_records.py.
+static void key_to_record(const uint8_t *p_key, adv_record_t *p_record)
+{
+    static const uint8_t head[7] = { 0x1e, 0xff, 0x4c, 0x00, 0x12, 0x19, 0x00 };
+
+    for (int i = 0; i < ADV_RECORD_ADDR_LEN; i++)
+    {
+        p_record->addr[i] = p_key[5 - i];
+    }
+    p_record->addr[5] |= 0xC0;
+    memcpy(p_record->data, head, sizeof(head));
+    memcpy(&p_record->data[7], &p_key[6], 22);
+    p_record->data[29] = p_key[0] >> 6;
+    p_record->data[30] = 0x00;
+}
+
+static bool scalar_valid(const uint8_t *p_scalar)
+{
+    static const uint8_t zero[DERIVE_KEY_LEN];
+
+    return memcmp(p_scalar, zero, DERIVE_KEY_LEN) != 0 &&
+           memcmp(p_scalar, secp224r1_order, DERIVE_KEY_LEN) < 0;
+}
+
+static void derive_hash(void)
+{
+    nrf_crypto_hash_sha256_digest_t digest;
+    size_t digest_size = sizeof(digest);
+
+    uint32_t err_code = nrf_crypto_hash_calculate(&m_hash_context, &g_nrf_crypto_hash_sha256_info,
+                                                  m_message, sizeof(m_message),
+                                                  digest, &digest_size);
+    APP_ERROR_CHECK(err_code);
+
+    memcpy(m_scalar, digest, DERIVE_KEY_LEN);
+    if (scalar_valid(m_scalar))
+    {
+        m_stage = DERIVE_POINT;
+    }
+    else
+    {
+        // Odds of 2^-112, but the owner's tool would skip it too.
+        key_derivation_stats.retries++;
+        m_message[sizeof(m_message) - 1]++;
+    }
+}
+
+static void derive_point(void)
+{
+    nrf_crypto_ecc_private_key_t scalar;
+    uint8_t x[NRF_CRYPTO_ECDH_SECP224R1_SHARED_SECRET_SIZE];
+    size_t x_size = sizeof(x);
+
+    // The ECDH shared secret of u and the master public key P is the x
+    // coordinate of u * P, the advertisement key. The owner's private key
+    // for it is u * d, with d the master private key.
+    uint32_t err_code = nrf_crypto_ecc_private_key_from_raw(&g_nrf_crypto_ecc_secp224r1_curve_info,
+                                                            &scalar, m_scalar, DERIVE_KEY_LEN);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = nrf_crypto_ecdh_compute(&m_ecdh_context, &scalar, &m_master_public_key, x, &x_size);
+    APP_ERROR_CHECK(err_code);
+
+    nrf_crypto_ecc_private_key_free(&scalar);
+
+    uint8_t slot = m_index % DERIVE_SLOTS;
+    key_to_record(x, &m_records[slot]);
+    m_record_index[slot] = m_index;
+    m_record_valid[slot] = true;
+
+    key_derivation_stats.derived++;
+    m_stage = DERIVE_IDLE;
+}
+
+static void derive_step(void)
+{
+    switch (m_stage)
+    {
+        case DERIVE_HASH:
+            derive_hash();
+            break;
+        case DERIVE_POINT:
+            derive_point();
+            break;
+        default:
+            break;
+    }
+}
+
+static void derive_begin(uint32_t index)
+{
+    m_index = index;
+    memcpy(&m_message[DERIVE_CHAIN_KEY_LEN], &index, sizeof(index));
+    m_message[sizeof(m_message) - 1] = 0;
+
+    // The slot of the new key may hold the key from three rotations ago.
+    m_record_valid[index % DERIVE_SLOTS] = false;
+    m_stage = DERIVE_HASH;
+}
+
+bool key_derivation_init(const uint8_t *p_master)
+{
+    uint32_t err_code = nrf_crypto_init();
+    APP_ERROR_CHECK(err_code);
+
+    memset(m_record_valid, 0, sizeof(m_record_valid));
+    m_stage = DERIVE_IDLE;
+
+    // Also checks that the point is on the curve.
+    err_code = nrf_crypto_ecc_public_key_from_raw(&g_nrf_crypto_ecc_secp224r1_curve_info,
+                                                  &m_master_public_key, p_master, DERIVE_PUBLIC_KEY_LEN);
+    if (err_code != NRF_SUCCESS)
+    {
+        return false;
+    }
+
+    memcpy(m_message, p_master + DERIVE_PUBLIC_KEY_LEN, DERIVE_CHAIN_KEY_LEN);
+    return true;
+}
+
+void key_derivation_run(uint32_t index)
+{
+    derive_begin(index);
+    while (m_stage != DERIVE_IDLE)
+    {
+        derive_step();
+    }
+}
+
+void key_derivation_start(uint32_t index)
+{
+    // A derivation that is still running starts over with the new index.
+    derive_begin(index);
+}
+
+bool key_derivation_step(void)
+{
+    if (m_stage == DERIVE_IDLE)
+    {
+        return false;
+    }
+
+    derive_step();
+    return m_stage != DERIVE_IDLE;
+}
+
+const adv_record_t *key_derivation_take(uint32_t index)
+{
+    uint8_t slot = index % DERIVE_SLOTS;
+
+    if (!m_record_valid[slot] || m_record_index[slot] != index)
+    {
+        COMPAT_NRF_LOG_INFO("[DERIVE] Key %d not ready, deriving it now", index);
+        key_derivation_stats.late++;
+        key_derivation_run(index);
+    }
+
+    return &m_records[slot];
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef _KEY_DERIVATION_H_
+#define _KEY_DERIVATION_H_
+
+// Include after ble_stack.h, for adv_record_t.
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(DERIVE_KEYS) && DERIVE_KEYS == 1
+
+// With DERIVE_KEYS=1 the key table region holds the owner's master public key
+// and a chain key instead of the advertising records, behind a header with
+// this magic and record_size set to their length (see tools/adv_records.py
+// --derive). The master private key stays with the owner: the tag derives the
+// advertisement keys from public material only (see tools/derive_keys.py).
+#define DERIVE_MASTER_MAGIC "HSKP"
+#define DERIVE_PUBLIC_KEY_LEN 56    // x and y of the master public key, big endian
+#define DERIVE_CHAIN_KEY_LEN 32
+#define DERIVE_MASTER_LEN (DERIVE_PUBLIC_KEY_LEN + DERIVE_CHAIN_KEY_LEN)
+
+typedef struct {
+    uint32_t derived;   // Keys derived, in the background or on the spot
+    uint32_t late;      // Rotations whose key wasn't ready and was derived on the spot
+    uint32_t retries;   // Hashes outside of the curve order, hashed again
+} key_derivation_stats_t;
+
+extern key_derivation_stats_t key_derivation_stats;
+
+/**@brief Function for initializing nrf_crypto and loading the master public key and chain key.
+ *
+ * @return False if the master public key is not a point of secp224r1.
+ */
+bool key_derivation_init(const uint8_t *p_master);
+
+/**@brief Function for deriving the key of a rotation index right away. */
+void key_derivation_run(uint32_t index);
+
+/**@brief Function for starting the derivation of a rotation index in the background.
+ *
+ * @details The work is done by key_derivation_step() from the main loop.
+ */
+void key_derivation_start(uint32_t index);
+
+/**@brief Function for running the next stage of the background derivation.
+ *
+ * @details Called from the main loop once the scheduler queue is empty. The
+ *          stages are a hash and a point multiplication, nrf_crypto does the
+ *          latter in one call.
+ *
+ * @return True if stages remain, run the queued work and call again.
+ */
+bool key_derivation_step(void);
+
+/**@brief Function for getting the advertising record of a rotation index.
+ *
+ * @details The record stays valid until the key two rotation indexes later is
+ *          derived, so it can stay on air while the next one is being swapped
+ *          in. If the background derivation hasn't finished it yet, the key is
+ *          derived on the spot and counted as late.
+ */
+const adv_record_t *key_derivation_take(uint32_t index);
+
+#endif
+
+#endif
@@ -0,0 +1,160 @@
+#include "ble_stack.h"
+#include "low_power.h"
+
+#include "nrf_gpio.h"
+
+low_power_stats_t low_power_stats;
+
+void low_power_pins_init(void)
+{
+    for (uint32_t pin = 0; pin < NUMBER_OF_PINS; pin++)
+    {
+        uint32_t mask = 1u << pin;
+
+        if (mask & (LOW_POWER_PINS_KEEP | LOW_POWER_PINS_SYSTEM))
+        {
+            continue;
+        }
+
+        if (mask & (LOW_POWER_PINS_OUTPUT_LOW | LOW_POWER_PINS_OUTPUT_HIGH))
+        {
+            // Level first, so the pin doesn't glitch when its driver turns on.
+            if (mask & LOW_POWER_PINS_OUTPUT_HIGH)
+            {
+                nrf_gpio_pin_set(pin);
+            }
+            else
+            {
+                nrf_gpio_pin_clear(pin);
+            }
+            nrf_gpio_cfg(pin, NRF_GPIO_PIN_DIR_OUTPUT, NRF_GPIO_PIN_INPUT_DISCONNECT, NRF_GPIO_PIN_NOPULL,
+                         NRF_GPIO_PIN_S0S1, NRF_GPIO_PIN_NOSENSE);
+            low_power_stats.pins_held++;
+        }
+        else if (mask & (LOW_POWER_PINS_PULLUP | LOW_POWER_PINS_PULLDOWN))
+        {
+            nrf_gpio_cfg(pin, NRF_GPIO_PIN_DIR_INPUT, NRF_GPIO_PIN_INPUT_DISCONNECT,
+                         (mask & LOW_POWER_PINS_PULLUP) ? NRF_GPIO_PIN_PULLUP : NRF_GPIO_PIN_PULLDOWN,
+                         NRF_GPIO_PIN_S0S1, NRF_GPIO_PIN_NOSENSE);
+            low_power_stats.pins_held++;
+        }
+        else
+        {
+            nrf_gpio_cfg_default(pin);
+            low_power_stats.pins_disconnected++;
+        }
+    }
+
+    COMPAT_NRF_LOG_INFO("[POWER] %d pins disconnected, %d held by the board map",
+                        low_power_stats.pins_disconnected, low_power_stats.pins_held);
+}
+
+#if defined(HAS_DEBUG) && HAS_DEBUG == 1
+
+typedef struct {
+    const char *name;
+    volatile const uint32_t *p_enable;
+} low_power_peripheral_t;
+
+#define PERIPHERAL(name, p_reg) { name, &(p_reg)->ENABLE }
+
+// Peripherals with an ENABLE register the firmware may leave on. Serial
+// instances that share an address are listed under each name and reported once.
+static const low_power_peripheral_t m_peripherals[] = {
+#if defined(NRF_UARTE0)
+    PERIPHERAL("UARTE0", NRF_UARTE0),
+#elif defined(NRF_UART0)
+    PERIPHERAL("UART0", NRF_UART0),
+#endif
+#if defined(NRF_SPIM0)
+    PERIPHERAL("SPIM0", NRF_SPIM0),
+#elif defined(NRF_SPI0)
+    PERIPHERAL("SPI0", NRF_SPI0),
+#endif
+#if defined(NRF_TWIM0)
+    PERIPHERAL("TWIM0", NRF_TWIM0),
+#elif defined(NRF_TWI0)
+    PERIPHERAL("TWI0", NRF_TWI0),
+#endif
+#if defined(NRF_SPIM1)
+    PERIPHERAL("SPIM1", NRF_SPIM1),
+#elif defined(NRF_SPI1)
+    PERIPHERAL("SPI1", NRF_SPI1),
+#endif
+#if defined(NRF_TWIM1)
+    PERIPHERAL("TWIM1", NRF_TWIM1),
+#elif defined(NRF_TWI1)
+    PERIPHERAL("TWI1", NRF_TWI1),
+#endif
+#if defined(NRF_SPIM2)
+    PERIPHERAL("SPIM2", NRF_SPIM2),
+#endif
+#if defined(NRF_SAADC)
+    PERIPHERAL("SAADC", NRF_SAADC),
+#elif defined(NRF_ADC)
+    PERIPHERAL("ADC", NRF_ADC),
+#endif
+#if defined(NRF_PWM0)
+    PERIPHERAL("PWM0", NRF_PWM0),
+#endif
+#if defined(NRF_PWM1)
+    PERIPHERAL("PWM1", NRF_PWM1),
+#endif
+#if defined(NRF_PWM2)
+    PERIPHERAL("PWM2", NRF_PWM2),
+#endif
+#if defined(NRF_QDEC)
+    PERIPHERAL("QDEC", NRF_QDEC),
+#endif
+#if defined(NRF_COMP)
+    PERIPHERAL("COMP", NRF_COMP),
+#endif
+#if defined(NRF_LPCOMP)
+    PERIPHERAL("LPCOMP", NRF_LPCOMP),
+#endif
+#if defined(NRF_I2S)
+    PERIPHERAL("I2S", NRF_I2S),
+#endif
+#if defined(NRF_PDM)
+    PERIPHERAL("PDM", NRF_PDM),
+#endif
+};
+
+#define PERIPHERAL_COUNT (sizeof(m_peripherals) / sizeof(m_peripherals[0]))
+
+uint8_t low_power_audit(void)
+{
+    uint8_t enabled = 0;
+
+    for (uint8_t i = 0; i < PERIPHERAL_COUNT; i++)
+    {
+        bool reported = false;
+        for (uint8_t j = 0; j < i; j++)
+        {
+            reported |= m_peripherals[j].p_enable == m_peripherals[i].p_enable;
+        }
+
+        if (!reported && *m_peripherals[i].p_enable != 0)
+        {
+            COMPAT_NRF_LOG_INFO("[POWER] %s is still enabled", m_peripherals[i].name);
+            enabled++;
+        }
+    }
+
+    // Pins driven by GPIOTE tasks, the PA/LNA assist of HAS_RADIO_PA owns one.
+    for (uint8_t ch = 0; ch < GPIOTE_CH_NUM; ch++)
+    {
+        uint32_t config = NRF_GPIOTE->CONFIG[ch];
+        if ((config & GPIOTE_CONFIG_MODE_Msk) == (GPIOTE_CONFIG_MODE_Task << GPIOTE_CONFIG_MODE_Pos))
+        {
+            COMPAT_NRF_LOG_INFO("[POWER] GPIOTE channel %d drives pin %d", ch,
+                                (config & GPIOTE_CONFIG_PSEL_Msk) >> GPIOTE_CONFIG_PSEL_Pos);
+        }
+    }
+
+    COMPAT_NRF_LOG_INFO("[POWER] %d peripherals left enabled before the first sleep", enabled);
+
+    return enabled;
+}
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef _LOW_POWER_H_
+#define _LOW_POWER_H_
+
+#include <stdint.h>
+
+#include "nrf5x-compat.h"
+#include "boards.h"
+
+// Low-power pin map of the board, masks of P0 pins. At boot every pin is put
+// in its lowest-leakage state: a disconnected input without pull, unless the
+// board header asks for a pull or a level to hold the circuit behind the pin
+// in, or to leave the pin alone (LOW_POWER_PINS_KEEP, e.g. XL1/XL2 with a
+// 32 kHz crystal). Pins the firmware drives itself are configured after the
+// sweep, so they need no entry.
+#ifndef LOW_POWER_PINS_PULLUP
+#define LOW_POWER_PINS_PULLUP 0
+#endif
+#ifndef LOW_POWER_PINS_PULLDOWN
+#define LOW_POWER_PINS_PULLDOWN 0
+#endif
+#ifndef LOW_POWER_PINS_OUTPUT_LOW
+#define LOW_POWER_PINS_OUTPUT_LOW 0
+#endif
+#ifndef LOW_POWER_PINS_OUTPUT_HIGH
+#define LOW_POWER_PINS_OUTPUT_HIGH 0
+#endif
+#ifndef LOW_POWER_PINS_KEEP
+#define LOW_POWER_PINS_KEEP 0
+#endif
+
+// Pins the chip gives another function than GPIO: the pin reset, and the NFC
+// antenna pads of the nRF52832.
+#if defined(CONFIG_GPIO_AS_PINRESET) && NRF_SDK_VERSION >= 15
+#define LOW_POWER_PINS_RESET (1u << 21)
+#else
+#define LOW_POWER_PINS_RESET 0
+#endif
+#if defined(NRF52832_XXAA) && !defined(CONFIG_NFCT_PINS_AS_GPIOS)
+#define LOW_POWER_PINS_NFC ((1u << 9) | (1u << 10))
+#else
+#define LOW_POWER_PINS_NFC 0
+#endif
+#define LOW_POWER_PINS_SYSTEM (LOW_POWER_PINS_RESET | LOW_POWER_PINS_NFC)
+
+#define LOW_POWER_PINS_HELD (LOW_POWER_PINS_PULLUP | LOW_POWER_PINS_PULLDOWN | \
+                             LOW_POWER_PINS_OUTPUT_LOW | LOW_POWER_PINS_OUTPUT_HIGH)
+
+_Static_assert((LOW_POWER_PINS_PULLUP & LOW_POWER_PINS_PULLDOWN) == 0 &&
+                   ((LOW_POWER_PINS_PULLUP | LOW_POWER_PINS_PULLDOWN) &
+                    (LOW_POWER_PINS_OUTPUT_LOW | LOW_POWER_PINS_OUTPUT_HIGH)) == 0 &&
+                   (LOW_POWER_PINS_OUTPUT_LOW & LOW_POWER_PINS_OUTPUT_HIGH) == 0,
+               "A pin is in more than one of the LOW_POWER_PINS_* states.");
+_Static_assert(((LOW_POWER_PINS_HELD) & (LOW_POWER_PINS_KEEP | LOW_POWER_PINS_SYSTEM)) == 0,
+               "A pin is both held in a state and left alone by the low-power pin map.");
+#if defined(FAST_FIND_BUTTON_PIN)
+_Static_assert(((LOW_POWER_PINS_OUTPUT_LOW | LOW_POWER_PINS_OUTPUT_HIGH) & (1u << (FAST_FIND_BUTTON_PIN))) == 0,
+               "The fast-find button pin can't be driven by the low-power pin map.");
+#endif
+
+typedef struct {
+    uint8_t pins_disconnected;  // Pins set to disconnected inputs
+    uint8_t pins_held;          // Pins given a pull or a level by the board map
+} low_power_stats_t;
+
+extern low_power_stats_t low_power_stats;
+
+/**@brief Function for putting every pin in the state of the board's low-power pin map.
+ *
+ * @details Run first thing at boot, before any driver configures its pins.
+ */
+void low_power_pins_init(void);
+
+#if defined(HAS_DEBUG) && HAS_DEBUG == 1
+/**@brief Function for logging the peripherals still enabled, and drawing current, before the first sleep.
+ *
+ * @return Number of peripherals found enabled.
+ */
+uint8_t low_power_audit(void);
+#endif
+
+#endif
@@ -51,8 +51,18 @@
 #include "boards.h"
 #include "app_timer.h"
 #include "app_button.h"
+#include "app_scheduler.h"
 #include "main.h"
-#include "math.h"
+#include "key_derivation.h"
+#include "rotation_journal.h"
+#include "battery_measure.h"
+#include "battery_curve.h"
+#include "battery_pof.h"
+#include "ram_power.h"
+#include "low_power.h"
+#include "power_governor.h"
+#include "wakeup.h"
+#include "adv_schedule.h"
 
 #if defined(BATTERY_LEVEL) && BATTERY_LEVEL == 1
 #if NRF_SDK_VERSION < 15
@@ -62,50 +72,188 @@
 #endif
 #endif
 
-// Create space for MAX_KEYS public keys
-static const char public_key[MAX_KEYS+1][28] = {
-    [0] = "OFFLINEFINDINGPUBLICKEYHERE!",
-    [MAX_KEYS] = "ENDOFKEYSENDOFKEYSENDOFKEYS!",
-};
+// Key table region, from the first free flash page behind the application to
+// the end of flash (see the .adv_keys section of the linker scripts). The patch
+// step writes the header and the advertising records there, so the number of
+// keys is only limited by the free flash of the chip.
+extern const uint8_t __start_adv_keys[];
+extern const uint8_t __stop_adv_keys[];
+
+#define ADV_KEYS_HEADER ((const adv_keys_header_t *)__start_adv_keys)
+#define ADV_KEYS_RECORDS ((const adv_record_t *)(__start_adv_keys + sizeof(adv_keys_header_t)))
+
+// Number of keys to rotate through, UINT16_MAX with DERIVE_KEYS=1 as derived
+// keys don't run out.
+uint16_t key_count = 0;
+uint16_t current_index = 0;
+
+// Rotations since the tag was provisioned, counting the one going on air next.
+// It picks the sequential key and the derived key, and with ROTATION_JOURNAL=1
+// it survives resets.
+uint32_t rotation_position = 0;
+
+// Timer of the wake-up scheduler, which runs all periodic work.
+APP_TIMER_DEF(m_wakeup_timer_id);
+
+// Scheduler jobs, their index in wakeup_stats.runs; UINT8_MAX if not added.
+static uint8_t m_rotation_job = UINT8_MAX;
+static uint8_t m_burst_job = UINT8_MAX;
+static uint8_t m_battery_job = UINT8_MAX;
+
+#if defined(ADV_SCHEDULE) && ADV_SCHEDULE == 1
+static uint8_t m_schedule_job = UINT8_MAX;
+
+// Advertising configuration at boot, which the schedule entries change, and
+// whether the entry in force has advertising off.
+static ble_adv_config_t m_schedule_base;
+static bool m_schedule_off = false;
+static bool m_schedule_loaded = false;
+#endif
+
+#if defined(BATTERY_POF) && BATTERY_POF == 1
+APP_TIMER_DEF(m_pof_confirm_timer_id);
 
-int last_filled_index = -1;
-int current_index = 0;
+// Battery percentage of the status the warning waiting for its reading stands for.
+static uint8_t m_pof_level;
+#endif
 
-// Define timer ID variable
-APP_TIMER_DEF(m_key_change_timer_id);
+#if defined(FAST_FIND_BUTTON_PIN)
+APP_TIMER_DEF(m_fast_find_timer_id);
+
+// Advertising configuration to go back to once fast-find is over.
+static ble_adv_config_t m_fast_find_saved_config;
+static bool m_fast_find_active = false;
+#endif
 
-// Timer interval definition (example: 1000 ms)
-#define TIMER_INTERVAL COMPAT_APP_TIMER_TICKS(KEY_ROTATION_INTERVAL * 1000)  // Timer interval in ticks (assuming 1 second interval)
+// Interrupt handlers only queue work for the main loop. The largest event is
+// the radio notification timestamp (see ble_stack.c).
+#define SCHED_MAX_EVENT_DATA_SIZE sizeof(uint32_t)
+#define SCHED_QUEUE_SIZE 6
+
+#if defined(HAS_DEBUG) && HAS_DEBUG == 1 && defined(DWT_CTRL_CYCCNTENA_Msk)
+#define HAS_ISR_DURATION 1
+// Duration of the wake-up timer interrupt handler in CPU cycles, measured
+// with the DWT cycle counter (Cortex-M4 debug builds only).
+static struct {
+    uint32_t count;
+    uint32_t last;
+    uint32_t max;
+} timer_isr_cycles;
+
+static void isr_duration_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+#endif
 
 #if defined(RANDOM_ROTATE_KEYS) && RANDOM_ROTATE_KEYS == 1
 #include "nrf_drv_rng.h"
 #include "nrf_rng.h"
 
-int randmod(int mod) {
-    if (mod <= 0) {
-        return -1;  // Invalid modulus.
+// Random bytes taken from the SoftDevice pool ahead of time, so picking a key
+// never waits for the RNG.
+#define RNG_RESERVOIR_SIZE 16
+
+static uint8_t rng_reservoir[RNG_RESERVOIR_SIZE];
+static uint8_t rng_reservoir_len = 0;
+// xorshift32 state, stirred with every hardware random word. Only used when
+// the reservoir runs dry.
+static uint32_t prng_state = 0x2545F491;
+
+static struct {
+    uint32_t pool_empty;    // Words taken from the PRNG because the reservoir was empty
+    uint32_t rejections;    // Words discarded by the rejection sampling in randmod
+} rng_stats;
+
+/**@brief Top up the reservoir with whatever the SoftDevice pool has, without waiting.
+ *
+ * @details Called from the main loop before sleeping. Nothing is done while the
+ *          reservoir is at least half full, so it takes a few rotations
+ *          between SoftDevice calls.
+ */
+static void rng_reservoir_fill(void)
+{
+    uint8_t bytes_available = 0;
+    uint32_t err_code;
+
+    if (rng_reservoir_len >= RNG_RESERVOIR_SIZE / 2) {
+        return;
     }
 
-    uint8_t buffer[4];  // Buffer to hold 2 random bytes (16 bits).
-    uint32_t x;
-    const uint32_t R_MAX = (UINT32_MAX / mod) * mod;
+    err_code = sd_rand_application_bytes_available_get(&bytes_available);
+    APP_ERROR_CHECK(err_code);
+
+    uint8_t len = MIN(bytes_available, RNG_RESERVOIR_SIZE - rng_reservoir_len);
+    if (len == 0) {
+        return;
+    }
 
+    err_code = sd_rand_application_vector_get(&rng_reservoir[rng_reservoir_len], len);
+    APP_ERROR_CHECK(err_code);
+    rng_reservoir_len += len;
+}
+
+/**@brief Seed the fallback PRNG from the hardware RNG, once at boot.
+ *
+ * @details Waits for the pool if it has less than a word, the only place
+ *          where waiting is harmless: with the fixed seed, a first key taken
+ *          from the PRNG would be the same after every reset.
+ */
+static void rng_seed(void)
+{
     uint8_t bytes_available = 0;
+    uint32_t seed;
     uint32_t err_code;
 
-    // Wait until there are enough random bytes available (at least 4 bytes).
     do {
         err_code = sd_rand_application_bytes_available_get(&bytes_available);
         APP_ERROR_CHECK(err_code);
-    } while (bytes_available < sizeof(buffer));
+    } while (bytes_available < sizeof(seed));
 
-    do {
-        // Get 4 random bytes and combine them into a 16-bit number.
-        err_code = sd_rand_application_vector_get(buffer, sizeof(buffer));
-        APP_ERROR_CHECK(err_code);
-        // Combine the two bytes into a 32-bit integer.
-        x = (buffer[0] << 24) | (buffer[1] << 16) | (buffer[2] << 8) | buffer[3];
-    } while (x >= R_MAX);  // Discard if the number is out of the acceptable range.
+    err_code = sd_rand_application_vector_get((uint8_t *)&seed, sizeof(seed));
+    APP_ERROR_CHECK(err_code);
+    prng_state ^= seed;
+    if (prng_state == 0) {
+        prng_state = 0x2545F491;
+    }
+}
+
+static uint32_t rng_next_word(void)
+{
+    uint32_t x;
+
+    if (rng_reservoir_len >= sizeof(x)) {
+        rng_reservoir_len -= sizeof(x);
+        memcpy(&x, &rng_reservoir[rng_reservoir_len], sizeof(x));
+        // Keep the fallback seeded from the hardware RNG.
+        prng_state ^= x;
+        if (prng_state == 0) {
+            prng_state = 0x2545F491;
+        }
+        return x;
+    }
+
+    rng_stats.pool_empty++;
+    prng_state ^= prng_state << 13;
+    prng_state ^= prng_state >> 17;
+    prng_state ^= prng_state << 5;
+    return prng_state;
+}
+
+int randmod(int mod) {
+    if (mod <= 0) {
+        return -1;  // Invalid modulus.
+    }
+
+    uint32_t x;
+    const uint32_t R_MAX = (UINT32_MAX / mod) * mod;
+
+    // Discard words out of the acceptable range, so every index is equally likely.
+    while ((x = rng_next_word()) >= R_MAX) {
+        rng_stats.rejections++;
+    }
 
     return x % mod;  // Return the modulo result.
 }
@@ -113,6 +261,12 @@ int randmod(int mod) {
 #endif
 
 #ifdef HAS_RADIO_PA
+#if defined(ADV_FULL_POWER_EVERY)
+// The PA amplifies every event, the low-power ones too, and draws its own
+// current on each: the schedule would save little and not cut their range.
+#error "ADV_FULL_POWER_EVERY lowers the TX power under a PA that stays on, build boards with HAS_RADIO_PA without it"
+#endif
+
 // Credits: https://forum.mysensors.org/topic/10198/nrf51-52-pa-not-support
 static void pa_lna_assist(uint32_t gpio_pa_pin, uint32_t gpio_lna_pin)
 {
@@ -145,64 +299,334 @@ static void pa_lna_assist(uint32_t gpio_pa_pin, uint32_t gpio_lna_pin)
 }
 #endif
 
+#if (defined(POWER_GOVERNOR) && POWER_GOVERNOR == 1) || (defined(ADV_SCHEDULE) && ADV_SCHEDULE == 1)
+// Switch to a new advertising configuration from the next key, or right away.
+// During fast-find it is taken over once fast-find is done.
+static uint32_t adv_config_switch(const ble_adv_config_t *p_config, bool now)
+{
+    #if defined(FAST_FIND_BUTTON_PIN)
+        if (m_fast_find_active) {
+            m_fast_find_saved_config = *p_config;
+            return NRF_SUCCESS;
+        }
+    #endif
+
+    uint32_t err_code = ble_adv_config_set(p_config);
+    if (err_code == NRF_SUCCESS && now) {
+        ble_adv_config_apply();
+    }
+    return err_code;
+}
+#endif
+
 #if defined(BATTERY_LEVEL) && BATTERY_LEVEL == 1
-#define BATTERY_VOLTAGE_MIN (1800.0)
-#define BATTERY_VOLTAGE_MAX (3300.0)
-#define ROTATION_PER_DAY ((24 * 60 * 60) / KEY_ROTATION_INTERVAL)
+uint8_t battery_voltage_percent(uint16_t real_vbatt)
+{
+    // Looked up in the discharge curve of the battery, see battery_curve.c.
+    uint8_t percent = battery_curve_percent(real_vbatt);
+
+    COMPAT_NRF_LOG_INFO("Battery voltage: %d mV, %d%% (curve %d)", real_vbatt, percent, BATTERY_CURVE);
 
+    return percent;
+}
+
+// Publish the battery status, and follow it with the power governor's
+// advertising configuration from the next key, or right away.
+static void battery_status_update(uint8_t battery_level, bool now)
+{
+    set_battery(battery_level);
+
+    #if defined(BATTERY_POF) && BATTERY_POF == 1
+        // Watch the supply for the next lower status.
+        battery_pof_arm(get_battery_status());
+    #endif
+
+    #if defined(POWER_GOVERNOR) && POWER_GOVERNOR == 1
+        ble_adv_config_t config;
+        if (!power_governor_update(get_battery_status(), &config)) {
+            return;
+        }
+        uint32_t err_code = adv_config_switch(&config, now);
+        APP_ERROR_CHECK(err_code);
+    #endif
+}
+
+#if defined(BATTERY_ASYNC) && BATTERY_ASYNC == 1
+// Filtered voltage of a background measurement, see battery_measure.c.
+static void battery_measured(uint16_t vbatt_mv)
+{
+    battery_status_update(battery_voltage_percent(vbatt_mv), false);
+}
+#else
 uint8_t read_nrf_battery_voltage_percent(void)
 {
     uint16_t real_vbatt;
     es_battery_voltage_get(&real_vbatt);
 
-    uint16_t vbatt = MIN(real_vbatt, BATTERY_VOLTAGE_MAX);
-    vbatt = (vbatt - BATTERY_VOLTAGE_MIN) / (BATTERY_VOLTAGE_MAX - BATTERY_VOLTAGE_MIN) * 100;
+    return battery_voltage_percent(real_vbatt);
+}
+#endif
+
+#if defined(BATTERY_POF) && BATTERY_POF == 1
+// Main loop, a while after a warning: a coin cell sags below the threshold
+// under a radio pulse long before it is that low at rest, so the status only
+// steps down if the battery reads that low. A brown-out may be close then, so
+// the governor's step goes on air right away rather than with the next key.
+static void battery_pof_confirm_evt_handler(void *p_event_data, uint16_t event_size)
+{
+    uint8_t battery_level = read_nrf_battery_voltage_percent();
 
-    COMPAT_NRF_LOG_INFO("Battery voltage: %d mV, %d%% (min: %d mV, max: %d mV)", real_vbatt, vbatt, BATTERY_VOLTAGE_MIN, BATTERY_VOLTAGE_MAX);
+    if (battery_level > m_pof_level) {
+        COMPAT_NRF_LOG_INFO("[POF] Battery still at %d%%, warning dismissed", battery_level);
+        battery_pof_arm(get_battery_status());
+        return;
+    }
 
-    return vbatt;
+    battery_status_update(battery_level, true);
 }
 
-void update_battery_level(void)
+// Confirmation timer interrupt.
+static void battery_pof_confirm_timer_handler(void *p_context)
 {
-    static uint32_t rotation = 0;
+    uint32_t err_code = app_sched_event_put(NULL, 0, battery_pof_confirm_evt_handler);
+    APP_ERROR_CHECK(err_code);
+}
 
-    if (rotation == 0) {
-        COMPAT_NRF_LOG_INFO("Updating battery level: %d / %d", rotation, ROTATION_PER_DAY);
-        uint8_t battery_level = read_nrf_battery_voltage_percent();
-        set_battery(battery_level);
-    } else {
-        COMPAT_NRF_LOG_INFO("Skipping battery level update: %d / %d", rotation, ROTATION_PER_DAY);
-    }
+// The supply dropped below the threshold of a lower status: read the battery
+// once it has recovered from the pulse, if that was one.
+static void battery_pof_warned(uint8_t battery_level)
+{
+    m_pof_level = battery_level;
 
-    rotation = (rotation + 1) % ROTATION_PER_DAY;
+    uint32_t err_code = app_timer_start(m_pof_confirm_timer_id, BATTERY_POF_CONFIRM_TICKS, NULL);
+    APP_ERROR_CHECK(err_code);
+}
+#endif
+
+// Read at boot and then once a day, by the wake-up scheduler. With
+// BATTERY_POF=1 each reading arms the power-fail comparator again, and the
+// battery is also read to confirm its warnings.
+void update_battery_level(void)
+{
+    COMPAT_NRF_LOG_INFO("Updating battery level");
+    #if defined(BATTERY_ASYNC) && BATTERY_ASYNC == 1
+        // The rotation doesn't wait, the status follows once the SAADC is done.
+        battery_measure_start();
+    #else
+        uint8_t battery_level = read_nrf_battery_voltage_percent();
+        battery_status_update(battery_level, false);
+    #endif
 }
 #endif
 
 void set_and_advertise_next_key(void *p_context)
 {
+    if (key_count == 0) {
+        COMPAT_NRF_LOG_INFO("No keys to advertise");
+        return;
+    }
+
+    #if defined(DERIVE_KEYS) && DERIVE_KEYS == 1
+        // The key was derived in idle slices since the last rotation.
+        const adv_record_t *p_record = key_derivation_take(rotation_position);
+    #else
+        #if defined(RANDOM_ROTATE_KEYS) && RANDOM_ROTATE_KEYS == 1
+            // Update key index for next advertisement...Back to zero if out of range
+            current_index =  randmod(key_count);
+        #else
+            // rotate to next key in the list modulo the key count
+            current_index = rotation_position % key_count;
+        #endif
+
+        if (current_index >= key_count) {
+            COMPAT_NRF_LOG_INFO("Invalid key index: %d", current_index);
+            current_index = 0;
+        }
+
+        const adv_record_t *p_record = &ADV_KEYS_RECORDS[current_index];
+    #endif
+
+    // Set key to be advertised
+    ble_rotate_advertisement_key(p_record);
+
+    #if defined(ROTATION_JOURNAL) && ROTATION_JOURNAL == 1
+        rotation_journal_record(rotation_position);
+    #endif
+
+    #if defined(DERIVE_KEYS) && DERIVE_KEYS == 1
+        COMPAT_NRF_LOG_INFO("Rotating to derived key: %d (%d late)", rotation_position, key_derivation_stats.late);
+    #else
+        COMPAT_NRF_LOG_INFO("Rotating key: %d", current_index);
+    #endif
+
+    rotation_position++;
+
+    #if defined(DERIVE_KEYS) && DERIVE_KEYS == 1
+        // Derive the key of the next rotation in the background, long before it is due.
+        key_derivation_start(rotation_position);
+    #endif
+
     #if defined(RANDOM_ROTATE_KEYS) && RANDOM_ROTATE_KEYS == 1
-        // Update key index for next advertisement...Back to zero if out of range
-        current_index =  randmod(last_filled_index + 1);
+        COMPAT_NRF_LOG_INFO("[RNG] Reservoir: %d bytes, empty: %d, rejections: %d",
+                rng_reservoir_len, rng_stats.pool_empty, rng_stats.rejections);
+    #endif
+}
+
+// Rotation job of the wake-up scheduler, runs from the main loop.
+static void rotation_job(void)
+{
+    set_and_advertise_next_key(NULL);
+
+    #ifdef HAS_ISR_DURATION
+        COMPAT_NRF_LOG_INFO("[SCHED] Timer ISR: %d us (max %d us, %d runs)",
+                timer_isr_cycles.last / (SystemCoreClock / 1000000),
+                timer_isr_cycles.max / (SystemCoreClock / 1000000),
+                timer_isr_cycles.count);
+    #endif
+}
+
+#if defined(ADV_SCHEDULE) && ADV_SCHEDULE == 1
+// Switch to the schedule entry in force at ticks since wakeup_start(), right
+// away. The power governor steps from the entry's configuration, and during
+// fast-find advertising stays on until it is done.
+static void adv_schedule_switch(uint64_t ticks)
+{
+    ble_adv_config_t config;
+    bool off = adv_schedule_config(ticks, &m_schedule_base, &config);
+
+    #if defined(POWER_GOVERNOR) && POWER_GOVERNOR == 1
+        power_governor_rebase(&config);
+    #endif
+
+    #if defined(FAST_FIND_BUTTON_PIN)
+        bool can_pause = !m_fast_find_active;
     #else
-        // rotate to next key in the list modulo the last filled index
-        current_index = (current_index + 1) % (last_filled_index + 1);
+        bool can_pause = true;
     #endif
 
-    if (current_index < 0 || current_index > last_filled_index) {
-        COMPAT_NRF_LOG_INFO("Invalid key index: %d", current_index);
-        current_index = 0;
+    // Stop first, rather than restart with the new configuration and stop.
+    m_schedule_off = off;
+    if (off && can_pause) {
+        ble_advertising_pause(true);
     }
 
-    #if defined(BATTERY_LEVEL) && BATTERY_LEVEL == 1
-        update_battery_level();
+    if (adv_config_switch(&config, true) != NRF_SUCCESS) {
+        COMPAT_NRF_LOG_INFO("[SCHEDULE] Entry rejected, keeping every %d ms at %d dBm",
+                            m_schedule_base.interval_ms, m_schedule_base.tx_power);
+    }
+
+    if (!off) {
+        ble_advertising_pause(false);
+    }
+}
+
+// Schedule job of the wake-up scheduler, at the start of each entry.
+static void adv_schedule_job(void)
+{
+    adv_schedule_switch(wakeup_time());
+}
+#endif
+
+#if ADV_BURST_DURATION > 0
+// Burst job of the wake-up scheduler: the bursts between rotations advertise
+// the current key again. The one falling on a rotation is left to it.
+static void adv_burst_job(void)
+{
+    COMPAT_NRF_LOG_INFO("[BURST] Advertising for %d s", ADV_BURST_DURATION);
+    ble_advertising_restart();
+}
+#endif
+
+// Wake-up timer interrupt: the scheduler hands the jobs due over to the main loop.
+static void wakeup_timer_handler(void *p_context)
+{
+    #ifdef HAS_ISR_DURATION
+        uint32_t start = DWT->CYCCNT;
     #endif
 
-    // Set key to be advertised
-    ble_set_advertisement_key(public_key[current_index]);
-    COMPAT_NRF_LOG_INFO("Rotating key: %d", current_index);
+    wakeup_timeout();
+
+    #ifdef HAS_ISR_DURATION
+        uint32_t cycles = DWT->CYCCNT - start;
+        timer_isr_cycles.count++;
+        timer_isr_cycles.last = cycles;
+        timer_isr_cycles.max = MAX(timer_isr_cycles.max, cycles);
+    #endif
 }
 
+#if defined(DERIVE_KEYS) && DERIVE_KEYS == 1
+/**@brief Function for loading the master public key and chain key from the key table region.
+ *
+ * @details Derives the first key right away, it goes on air at boot.
+ */
+static bool load_master_key(void)
+{
+    const adv_keys_header_t *header = ADV_KEYS_HEADER;
+
+    if ((size_t)(__stop_adv_keys - __start_adv_keys) < sizeof(adv_keys_header_t) + DERIVE_MASTER_LEN ||
+        memcmp(header->magic, DERIVE_MASTER_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != ADV_KEYS_VERSION ||
+        header->record_size != DERIVE_MASTER_LEN ||
+        header->count != 1)
+    {
+        COMPAT_NRF_LOG_INFO("[KEYS] No valid master key header");
+        return false;
+    }
+
+    if (!key_derivation_init(__start_adv_keys + sizeof(adv_keys_header_t)))
+    {
+        COMPAT_NRF_LOG_INFO("[KEYS] Master public key not on the curve");
+        return false;
+    }
+    key_derivation_run(rotation_position);
+    return true;
+}
+#else
+/**@brief Function for getting the number of records that fit in the key table region.
+ */
+static uint16_t key_capacity(void)
+{
+    uint32_t region_size = __stop_adv_keys - __start_adv_keys;
+
+    if (region_size < sizeof(adv_keys_header_t))
+    {
+        return 0;
+    }
+
+    uint32_t capacity = (region_size - sizeof(adv_keys_header_t)) / sizeof(adv_record_t);
+    return capacity > UINT16_MAX ? UINT16_MAX : capacity;
+}
+
+/**@brief Function for finding the number of keys in the key table.
+ *
+ * @details Patched images carry the key count in the table header. The region
+ *          of an unpatched image is erased flash, which has no valid header.
+ *          There is no scan for headerless records any more: those were
+ *          patched into a placeholder table compiled into older firmware,
+ *          and an image built from this tree has to be patched again.
+ */
+static uint16_t find_key_count(void)
+{
+    const adv_keys_header_t *header = ADV_KEYS_HEADER;
+    uint16_t capacity = key_capacity();
+
+    COMPAT_NRF_LOG_INFO("[KEYS] Key table region: %d bytes, room for %d keys",
+                        __stop_adv_keys - __start_adv_keys, capacity);
+
+    if (memcmp(header->magic, ADV_KEYS_MAGIC, sizeof(header->magic)) == 0 &&
+        header->version == ADV_KEYS_VERSION &&
+        header->record_size == sizeof(adv_record_t) &&
+        header->count > 0 && header->count <= capacity)
+    {
+        COMPAT_NRF_LOG_INFO("[KEYS] Key count from header: %d", header->count);
+        return header->count;
+    }
+
+    COMPAT_NRF_LOG_INFO("[KEYS] No valid key table header, patch the image with tools/adv_records.py");
+    return 0;
+}
+#endif
+
 /**@brief Function for assert macro callback.
  *
  * @details This function will be called in case of an assert in the SoftDevice.
@@ -235,6 +659,21 @@ static void timers_init(void)
     #endif
 }
 
+#if NRF_SDK_VERSION < 15 && \
+    ((defined(ROTATION_JOURNAL) && ROTATION_JOURNAL == 1) || (defined(BATTERY_POF) && BATTERY_POF == 1))
+/**@brief Function for dispatching system events to the modules, SDK 12 takes a single handler.
+ */
+static void sys_evt_dispatch(uint32_t sys_evt)
+{
+    #if defined(ROTATION_JOURNAL) && ROTATION_JOURNAL == 1
+        rotation_journal_on_sys_evt(sys_evt);
+    #endif
+    #if defined(BATTERY_POF) && BATTERY_POF == 1
+        battery_pof_on_sys_evt(sys_evt);
+    #endif
+}
+#endif
+
 /**@brief Function for initializing the BLE stack.
  *
  * @details Initializes the SoftDevice and the BLE event interrupt.
@@ -284,6 +723,13 @@ void ble_stack_init(void)
         err_code = softdevice_enable(&ble_enable_params);
         APP_ERROR_CHECK(err_code);
 
+        #if (defined(ROTATION_JOURNAL) && ROTATION_JOURNAL == 1) || (defined(BATTERY_POF) && BATTERY_POF == 1)
+            // Flash operations of the rotation journal and the power failure
+            // warning report back with system events.
+            err_code = softdevice_sys_evt_handler_set(sys_evt_dispatch);
+            APP_ERROR_CHECK(err_code);
+        #endif
+
     #endif
 }
 
@@ -330,20 +776,214 @@ static void idle_state_handle(void)
     }
 }
 
-// Function to configure the timer
-static void timer_config(void)
+#if defined(FAST_FIND_BUTTON_PIN)
+// Runs a button press from the main loop: advertise fast, for
+// FAST_FIND_DURATION seconds from the last press.
+static void fast_find_evt_handler(void *p_event_data, uint16_t event_size)
 {
     uint32_t err_code;
 
-    // Create the timer. It will trigger the 'set_and_advertise_next_key' function on each timeout.
-    err_code = app_timer_create(&m_key_change_timer_id, APP_TIMER_MODE_REPEATED, set_and_advertise_next_key);
+    if (!m_fast_find_active) {
+        ble_adv_config_get(&m_fast_find_saved_config);
+
+        // Continuously, also between bursts, until the timer ends it.
+        ble_adv_config_t config = m_fast_find_saved_config;
+        config.interval_ms = FAST_FIND_INTERVAL;
+        config.duration_s = 0;
+        err_code = ble_adv_config_set(&config);
+        APP_ERROR_CHECK(err_code);
+        ble_adv_config_apply();
+        m_fast_find_active = true;
+
+        #if defined(ADV_SCHEDULE) && ADV_SCHEDULE == 1
+            // Also while the schedule has advertising off.
+            ble_advertising_pause(false);
+        #endif
+    }
+
+    err_code = app_timer_stop(m_fast_find_timer_id);
+    APP_ERROR_CHECK(err_code);
+    err_code = app_timer_start(m_fast_find_timer_id, FAST_FIND_TIMER_TICKS, NULL);
     APP_ERROR_CHECK(err_code);
 
-    // Start the timer with the specified interval.
-    err_code = app_timer_start(m_key_change_timer_id, TIMER_INTERVAL, NULL);
+    COMPAT_NRF_LOG_INFO("[FIND] Advertising every %d ms for %d s", FAST_FIND_INTERVAL, FAST_FIND_DURATION);
+}
+
+// Runs the end of fast-find from the main loop.
+static void fast_find_end_evt_handler(void *p_event_data, uint16_t event_size)
+{
+    if (!m_fast_find_active) {
+        return;
+    }
+    m_fast_find_active = false;
+
+    #if defined(ADV_SCHEDULE) && ADV_SCHEDULE == 1
+        ble_advertising_pause(m_schedule_off);
+    #endif
+
+    uint32_t err_code = ble_adv_config_set(&m_fast_find_saved_config);
     APP_ERROR_CHECK(err_code);
+    ble_adv_config_apply();
+
+    COMPAT_NRF_LOG_INFO("[FIND] Back to advertising every %d ms", m_fast_find_saved_config.interval_ms);
 }
 
+// Button interrupt, after debouncing: hand the press over to the main loop.
+static void fast_find_button_handler(uint8_t pin_no, uint8_t button_action)
+{
+    if (button_action != APP_BUTTON_PUSH) {
+        return;
+    }
+
+    uint32_t err_code = app_sched_event_put(NULL, 0, fast_find_evt_handler);
+    APP_ERROR_CHECK(err_code);
+}
+
+// Fast-find timer interrupt.
+static void fast_find_timer_handler(void *p_context)
+{
+    uint32_t err_code = app_sched_event_put(NULL, 0, fast_find_end_evt_handler);
+    APP_ERROR_CHECK(err_code);
+}
+
+/**@brief Function for setting up the fast-find button.
+ *
+ * @details app_button watches the pin with a GPIOTE PORT event, from the
+ *          pin's SENSE mechanism, rather than an IN channel: it draws no
+ *          current while the button isn't pressed.
+ */
+static void fast_find_init(void)
+{
+    static app_button_cfg_t buttons[] = {
+        {FAST_FIND_BUTTON_PIN, FAST_FIND_BUTTON_ACTIVE_STATE, FAST_FIND_BUTTON_PULL, fast_find_button_handler},
+    };
+    uint32_t err_code;
+
+    err_code = app_timer_create(&m_fast_find_timer_id, APP_TIMER_MODE_SINGLE_SHOT, fast_find_timer_handler);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = app_button_init(buttons, sizeof(buttons) / sizeof(buttons[0]), FAST_FIND_DEBOUNCE_TICKS);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = app_button_enable();
+    APP_ERROR_CHECK(err_code);
+
+    COMPAT_NRF_LOG_INFO("[FIND] Button on pin %d: every %d ms for %d s when pressed",
+                        FAST_FIND_BUTTON_PIN, FAST_FIND_INTERVAL, FAST_FIND_DURATION);
+}
+#endif
+
+/**@brief Function for running the work queued by interrupt handlers.
+ *
+ * @details Called from the main loop every time the CPU wakes up, right before
+ *          going back to sleep.
+ */
+static void process_pending_work(void)
+{
+    app_sched_execute();
+
+    #if defined(DERIVE_KEYS) && DERIVE_KEYS == 1
+        // The key of the next rotation, one stage at a time, with the work
+        // queued meanwhile run in between.
+        while (key_derivation_step())
+        {
+            app_sched_execute();
+        }
+    #endif
+
+    #if defined(RANDOM_ROTATE_KEYS) && RANDOM_ROTATE_KEYS == 1
+        rng_reservoir_fill();
+    #endif
+}
+
+// Function to configure the timer
+static void timer_config(void)
+{
+    // Single-shot, the scheduler sets each expiry for the next job due.
+    uint32_t err_code = app_timer_create(&m_wakeup_timer_id, APP_TIMER_MODE_SINGLE_SHOT, wakeup_timer_handler);
+    APP_ERROR_CHECK(err_code);
+
+    wakeup_init(m_wakeup_timer_id);
+
+    // The schedule before the radio jobs, it may change the configuration they
+    // restart advertising with. Entries start on the minute, right on time.
+    #if defined(ADV_SCHEDULE) && ADV_SCHEDULE == 1
+        if (m_schedule_loaded)
+        {
+            m_schedule_job = wakeup_job_add(&(wakeup_job_t){
+                .name = "schedule",
+                .handler = adv_schedule_job,
+                .p_next = adv_schedule_next,
+            });
+        }
+    #endif
+
+    // Battery first: a new power governor step goes on air with the key of
+    // the same wake-up. The reading waits up to a rotation, or a day, for one.
+    // BATTERY_POF=1 also has the comparator wake the CPU when it trips, and
+    // reads the battery a while later to confirm it. The daily reading takes
+    // its warnings again after one was dismissed.
+    #if defined(BATTERY_POF) && BATTERY_POF == 1
+        err_code = app_timer_create(&m_pof_confirm_timer_id, APP_TIMER_MODE_SINGLE_SHOT,
+                                    battery_pof_confirm_timer_handler);
+        APP_ERROR_CHECK(err_code);
+    #endif
+    #if defined(BATTERY_LEVEL) && BATTERY_LEVEL == 1
+        m_battery_job = wakeup_job_add(&(wakeup_job_t){
+            .name = "battery",
+            .handler = update_battery_level,
+            .period_ticks = DAY_TICKS,
+            .tolerance_ticks = MIN(ROTATION_INTERVAL_TICKS, DAY_TICKS),
+        });
+    #endif
+
+    // Rotate the key if there are multiple keys, and run the bursts.
+    if (key_count > 1 || ADV_BURST_DURATION > 0)
+    {
+        m_rotation_job = wakeup_job_add(&(wakeup_job_t){
+            .name = "rotation",
+            .handler = rotation_job,
+            .period_ticks = ROTATION_INTERVAL_TICKS,
+            .flags = WAKEUP_JOB_RADIO,
+        });
+
+        #if ADV_BURST_DURATION > 0
+            if (ADV_BURSTS > 1)
+            {
+                m_burst_job = wakeup_job_add(&(wakeup_job_t){
+                    .name = "burst",
+                    .handler = adv_burst_job,
+                    .period_ticks = BURST_INTERVAL_TICKS,
+                    .flags = WAKEUP_JOB_RADIO,
+                });
+            }
+        #endif
+    }
+
+    wakeup_start(DAY_TICKS);
+}
+
+#if ADV_BURST_DURATION > 0
+// Advertising events a day when advertising all the time and in bursts.
+#define ADV_EVENTS_PER_DAY ((uint32_t)((uint64_t)24 * 60 * 60 * 1000 / (ADVERTISING_INTERVAL)))
+#define BURST_ADV_EVENTS_PER_DAY ((uint32_t)((uint64_t)24 * 60 * 60 * 1000 * ADV_BURSTS * ADV_BURST_DURATION / \
+                                             ((uint64_t)(KEY_ROTATION_INTERVAL) * (ADVERTISING_INTERVAL))))
+// Share of the time spent advertising, in 1/1000.
+#define BURST_DUTY_PERMILLE ((uint32_t)((uint64_t)1000 * ADV_BURSTS * ADV_BURST_DURATION / (KEY_ROTATION_INTERVAL)))
+
+static void log_burst_saving(void)
+{
+    // The radio, and the CPU waking up for it, only run during the bursts:
+    // the advertising energy scales with the events.
+    COMPAT_NRF_LOG_INFO("[BURST] %d burst(s) of %d s per %d s rotation: advertising %d.%d%% of the time",
+                        ADV_BURSTS, ADV_BURST_DURATION, KEY_ROTATION_INTERVAL,
+                        BURST_DUTY_PERMILLE / 10, BURST_DUTY_PERMILLE % 10);
+    COMPAT_NRF_LOG_INFO("[BURST] %d advertising events a day instead of %d, %d.%d%% less advertising energy",
+                        BURST_ADV_EVENTS_PER_DAY, ADV_EVENTS_PER_DAY,
+                        (1000 - BURST_DUTY_PERMILLE) / 10, (1000 - BURST_DUTY_PERMILLE) % 10);
+}
+#endif
+
 
 /**@brief Function for application main entry.
  */
@@ -352,29 +992,43 @@ int main(void)
     // Initialize.
     log_init();
 
+    // Unused pins to their lowest-leakage state, before any driver takes its own.
+    low_power_pins_init();
+
     #if defined(BATTERY_LEVEL) && BATTERY_LEVEL == 1
-        es_battery_voltage_init();
+        #if defined(BATTERY_ASYNC) && BATTERY_ASYNC == 1
+            battery_measure_init(battery_measured);
+        #else
+            es_battery_voltage_init();
+        #endif
     #endif
 
-    // Find the last filled index
-    for (int i = MAX_KEYS - 2; i >= 0; i--)
+    #if defined(ROTATION_JOURNAL) && ROTATION_JOURNAL == 1
+        // Resume the rotation where it was before the reset, and count the
+        // time from the rotations elapsed at the last record.
+        uint32_t journal_elapsed;
+        rotation_journal_init(&rotation_position, &journal_elapsed);
+    #endif
+
+#if defined(DERIVE_KEYS) && DERIVE_KEYS == 1
+    if (load_master_key())
     {
-        if (strlen(public_key[i]) > 0)
-        {
-            last_filled_index = i;
-            break;
-        }
+        key_count = UINT16_MAX;
+        COMPAT_NRF_LOG_INFO("[KEYS] Deriving a new key every %d seconds", KEY_ROTATION_INTERVAL);
     }
+#else
+    // Find the number of keys in the key table
+    key_count = find_key_count();
 
     // Precompute necessary values using integer arithmetic
-    uint32_t rotation_interval_sec = last_filled_index * KEY_ROTATION_INTERVAL;
+    uint32_t rotation_interval_sec = key_count * KEY_ROTATION_INTERVAL;
     // Calculate hours scaled by 100 to preserve two decimal places
-    uint32_t rotation_interval_hours_scaled = (rotation_interval_sec * 100) / 3600;
+    uint32_t rotation_interval_hours_scaled = (rotation_interval_sec / 36);
     // Calculate rotations per day scaled by 100
-    uint32_t rotation_per_day_scaled = (86400 * 100) / rotation_interval_sec;
+    uint32_t rotation_per_day_scaled = rotation_interval_sec ? (86400 * 100) / rotation_interval_sec : 0;
 
     // Log the information
-    COMPAT_NRF_LOG_INFO("[KEYS] Last filled index: %d", last_filled_index);
+    COMPAT_NRF_LOG_INFO("[KEYS] Key count: %d", key_count);
 
     COMPAT_NRF_LOG_INFO("[TIMING] Full key rotation interval: %d seconds (%d.%02d hours)",
                     rotation_interval_sec,
@@ -384,16 +1038,41 @@ int main(void)
     COMPAT_NRF_LOG_INFO("[TIMING] Rotation per Day: %d.%02d",
                     rotation_per_day_scaled / 100,
                     rotation_per_day_scaled % 100);
+#endif
+
 
+    #if defined(ADV_SCHEDULE) && ADV_SCHEDULE == 1
+        // Right behind the key records, or the master key. The time of the patch
+        // plus the rotations timed since, as journaled: each reset loses up
+        // to a batch of rotation intervals, and never puts the time ahead.
+        if (key_count > 0)
+        {
+            m_schedule_loaded = adv_schedule_init(__start_adv_keys + sizeof(adv_keys_header_t) +
+                                                      (uint32_t)ADV_KEYS_HEADER->count * ADV_KEYS_HEADER->record_size,
+                                                  __stop_adv_keys, journal_elapsed * (KEY_ROTATION_INTERVAL));
+        }
+    #endif
+
+    // Initialize the scheduler, the timer and radio handlers queue their work there.
+    APP_SCHED_INIT(SCHED_MAX_EVENT_DATA_SIZE, SCHED_QUEUE_SIZE);
+
+    #ifdef HAS_ISR_DURATION
+        isr_duration_init();
+    #endif
 
     // Initialize the timer module.
     timers_init();
 
-    // Configure the timer for key rotation if there are multiple keys
-    if (last_filled_index > 0)
-    {
-        timer_config();
-    }
+    // Configure the wake-up timer for the periodic work.
+    timer_config();
+
+    #if ADV_BURST_DURATION > 0
+        log_burst_saving();
+    #endif
+
+    #if defined(FAST_FIND_BUTTON_PIN)
+        fast_find_init();
+    #endif
 
     // Initialize the power management module.
     power_management_init();
@@ -401,9 +1080,35 @@ int main(void)
     // Initialize the BLE stack.
     ble_stack_init();
 
+    #if defined(RAM_POWER_DOWN) && RAM_POWER_DOWN == 1
+        // Needs the SoftDevice, which owns the POWER peripheral.
+        ram_power_down_unused();
+    #endif
+
     // Initialize advertising.
     ble_advertising_init();
 
+    #if defined(POWER_GOVERNOR) && POWER_GOVERNOR == 1
+        // Steps from the configuration at boot, before the first battery reading.
+        power_governor_init(key_count > 1 || ADV_BURST_DURATION > 0
+                                ? (KEY_ROTATION_INTERVAL) / (ADV_BURST_DURATION > 0 ? ADV_BURSTS : 1)
+                                : 0);
+    #endif
+
+    #if defined(BATTERY_POF) && BATTERY_POF == 1
+        // Thresholds of each status, armed with the first battery reading.
+        battery_pof_init(battery_pof_warned);
+    #endif
+
+    #if defined(ADV_SCHEDULE) && ADV_SCHEDULE == 1
+        // The entry in force at boot, before the first key goes on air.
+        if (m_schedule_loaded)
+        {
+            ble_adv_config_get(&m_schedule_base);
+            adv_schedule_switch(0);
+        }
+    #endif
+
 #ifdef HAS_RADIO_PA
     // Configure the PA/LNA
     pa_lna_assist(GPIO_PA_PIN, GPIO_LNA_PIN);
@@ -418,12 +1123,30 @@ int main(void)
 
     COMPAT_NRF_LOG_INFO("Starting advertising");
 
+    #if defined(RANDOM_ROTATE_KEYS) && RANDOM_ROTATE_KEYS == 1
+        // The SoftDevice is running now, seed the fallback and fill the
+        // reservoir before picking the first key.
+        rng_seed();
+        rng_reservoir_fill();
+    #endif
+
+    #if defined(BATTERY_LEVEL) && BATTERY_LEVEL == 1
+        // The first key goes on air with the battery status.
+        update_battery_level();
+    #endif
+
     // Set the first key to be advertised
     set_and_advertise_next_key(NULL);
 
+    #if defined(HAS_DEBUG) && HAS_DEBUG == 1
+        // Anything left on here keeps drawing current while the tag sleeps.
+        low_power_audit();
+    #endif
+
     // Enter main loop.
     for (;;)
     {
+        process_pending_work();
         idle_state_handle();
     }
 }
@@ -1,14 +1,14 @@
 #include "nrf5x-compat.h"
 #include "ble_stack.h"
 
-#ifndef RANDOM_ROTATE_KEYS
-#define RANDOM_ROTATE_KEYS 1
+#if defined(DERIVE_KEYS) && DERIVE_KEYS == 1
+// Derived keys never repeat, so they are used in order.
+#undef RANDOM_ROTATE_KEYS
+#define RANDOM_ROTATE_KEYS 0
 #endif
 
-#ifndef MAX_KEYS
-// Maximum number of public keys to rotate
-// Can be set during compilation with make MAX_KEYS=10
-#define MAX_KEYS 50
+#ifndef RANDOM_ROTATE_KEYS
+#define RANDOM_ROTATE_KEYS 1
 #endif
 
 #ifndef KEY_ROTATION_INTERVAL
@@ -30,12 +30,90 @@
 // Maximum time before overflow, in seconds
 #define MAX_TIMER_INTERVAL_SECONDS (MAX_RTC_TICKS / RTC_FREQUENCY)
 
+// Periods of the wake-up scheduler jobs (see wakeup.h), which may be longer
+// than the RTC can time in one go, days even. With burst advertising the
+// rotation interval rounds down to a multiple of ADV_BURSTS ticks, so that
+// every rotation falls on a burst and the two share the wake-up.
+#define ROTATION_INTERVAL_TICKS ((uint64_t)(KEY_ROTATION_INTERVAL) * RTC_FREQUENCY / ADV_BURSTS * ADV_BURSTS)
+#define BURST_INTERVAL_TICKS (ROTATION_INTERVAL_TICKS / ADV_BURSTS)
+#define DAY_TICKS ((uint64_t)24 * 60 * 60 * RTC_FREQUENCY)
+
 // Force computation of values using macros
 #define COMPUTED_RTC_FREQUENCY RTC_FREQUENCY
 #define COMPUTED_MAX_TIMER_INTERVAL MAX_TIMER_INTERVAL_SECONDS
 
-// Static assert to ensure that the key rotation interval fits within the max timer interval
-_Static_assert(KEY_ROTATION_INTERVAL <= COMPUTED_MAX_TIMER_INTERVAL, "KEY_ROTATION_INTERVAL exceeds max timer interval for the configured RTC frequency.");
+_Static_assert(KEY_ROTATION_INTERVAL > 0, "KEY_ROTATION_INTERVAL must be at least one second.");
+_Static_assert(ADV_BURSTS > 0, "ADV_BURSTS must be at least 1.");
+_Static_assert(ADV_BURST_DURATION <= BLE_ADV_DURATION_MAX_S, "ADV_BURST_DURATION is longer than the SoftDevice can advertise for.");
+_Static_assert((uint64_t)ADV_BURST_DURATION * ADV_BURSTS < (KEY_ROTATION_INTERVAL),
+               "The advertising bursts fill the rotation interval, advertise continuously instead.");
+_Static_assert(ADV_CHANNELS >= ADV_CHANNELS_ALL && ADV_CHANNELS <= ADV_CHANNELS_ROTATE, "Unknown ADV_CHANNELS profile.");
+_Static_assert(ADV_CHANNEL >= ADV_CHANNEL_FIRST && ADV_CHANNEL <= ADV_CHANNEL_LAST, "ADV_CHANNEL must be 37, 38 or 39.");
+
+// Fast-find button: pressing the button defined as FAST_FIND_BUTTON_PIN in the
+// board header switches advertising to FAST_FIND_INTERVAL ms for
+// FAST_FIND_DURATION seconds, then back. Each press starts the time over.
+// None of the boards here has a button. On one that does, its header sets the
+// pin, and FAST_FIND_BUTTON_ACTIVE_STATE (APP_BUTTON_ACTIVE_LOW or _HIGH) and
+// FAST_FIND_BUTTON_PULL (an NRF_GPIO_PIN_* pull) if it isn't active low with
+// the internal pull-up.
+#if defined(FAST_FIND_BUTTON_PIN)
+#ifndef FAST_FIND_BUTTON_ACTIVE_STATE
+#define FAST_FIND_BUTTON_ACTIVE_STATE APP_BUTTON_ACTIVE_LOW
+#endif
+
+#ifndef FAST_FIND_BUTTON_PULL
+#define FAST_FIND_BUTTON_PULL NRF_GPIO_PIN_PULLUP
+#endif
+
+#ifndef FAST_FIND_INTERVAL
+#if NRF_SDK_VERSION >= 15
+#define FAST_FIND_INTERVAL 20
+#else
+// The S130 doesn't go below 100 ms for non-connectable advertising.
+#define FAST_FIND_INTERVAL 100
+#endif
+#endif
+
+#ifndef FAST_FIND_DURATION
+#define FAST_FIND_DURATION 60
+#endif
+
+// Debounce time of the button, 50 ms.
+#define FAST_FIND_DEBOUNCE_TICKS (50 * RTC_FREQUENCY / 1000)
+
+#define FAST_FIND_TIMER_TICKS ((uint32_t)(FAST_FIND_DURATION) * RTC_FREQUENCY)
+
+_Static_assert(FAST_FIND_DURATION > 0, "FAST_FIND_DURATION must be at least one second.");
+_Static_assert((uint64_t)(FAST_FIND_DURATION) * RTC_FREQUENCY <= MAX_RTC_TICKS,
+               "FAST_FIND_DURATION is longer than the RTC can time in one go.");
+#endif
+
+#if defined(BATTERY_POF) && BATTERY_POF == 1
+// Seconds from a power-fail warning to the battery reading that confirms it,
+// for a coin cell to recover from the radio pulse it sagged under.
+#ifndef BATTERY_POF_CONFIRM_DELAY
+#define BATTERY_POF_CONFIRM_DELAY 10
+#endif
+
+#define BATTERY_POF_CONFIRM_TICKS ((uint32_t)(BATTERY_POF_CONFIRM_DELAY) * RTC_FREQUENCY)
+
+_Static_assert(BATTERY_POF_CONFIRM_DELAY > 0, "BATTERY_POF_CONFIRM_DELAY must be at least one second.");
+#endif
+
+// Header at the start of the key table region, written by tools/adv_records.py
+// from the keyfile so boot doesn't have to scan the table.
+#define ADV_KEYS_MAGIC "HSKT"
+#define ADV_KEYS_VERSION 1
+
+typedef struct {
+    uint8_t magic[4];
+    uint8_t version;
+    uint8_t record_size;
+    uint16_t count;
+} adv_keys_header_t;
+
+_Static_assert(sizeof(adv_keys_header_t) == 8, "adv_keys_header_t must match the layout written by tools/adv_records.py.");
 
 // Helper macro to convert values to string
 #define _STRINGIFY(x) _STRINGIFY_INTERNAL(x)
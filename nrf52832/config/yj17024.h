@@ -55,6 +55,11 @@ extern "C" {
 #define GPIO_PA_PIN 24
 #define GPIO_LNA_PIN 20
 
+// Low-power pin map, see low_power.h: the PA/LNA control lines are held low
+// from boot so the front-end stays off until the SoftDevice drives them.
+// Every other pin is disconnected.
+#define LOW_POWER_PINS_OUTPUT_LOW ((1u << GPIO_PA_PIN) | (1u << GPIO_LNA_PIN))
+
 
 #ifdef __cplusplus
 }
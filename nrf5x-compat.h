@@ -16,10 +16,27 @@
 #if NRF_SDK_VERSION >= 15
 #include "nrf_log_default_backends.h"
 #define COMPAT_APP_TIMER_TICKS(APP_TIMER_MS) APP_TIMER_TICKS(APP_TIMER_MS)
+#define COMPAT_APP_TIMER_PRESCALER APP_TIMER_CONFIG_RTC_FREQUENCY
+#define COMPAT_APP_TIMER_CNT_GET() app_timer_cnt_get()
+#define COMPAT_APP_TIMER_CNT_DIFF(TICKS_TO, TICKS_FROM) app_timer_cnt_diff_compute(TICKS_TO, TICKS_FROM)
+#define COMPAT_APP_TIMER_MAX_CNT_VAL APP_TIMER_MAX_CNT_VAL
 #define COMPAT_NRF_LOG_INFO(...) NRF_LOG_INFO(__VA_ARGS__)
 #else
 #define COMPAT_APP_TIMER_TICKS(APP_TIMER_MS) APP_TIMER_TICKS(APP_TIMER_MS, APP_TIMER_PRESCALER)
+#define COMPAT_APP_TIMER_PRESCALER APP_TIMER_PRESCALER
+#define COMPAT_APP_TIMER_CNT_GET() ({ uint32_t _ticks; APP_ERROR_CHECK(app_timer_cnt_get(&_ticks)); _ticks; })
+#define COMPAT_APP_TIMER_CNT_DIFF(TICKS_TO, TICKS_FROM) \
+    ({ uint32_t _diff; APP_ERROR_CHECK(app_timer_cnt_diff_compute(TICKS_TO, TICKS_FROM, &_diff)); _diff; })
+// The 24-bit RTC counter, private to app_timer.c in SDK 12.
+#define COMPAT_APP_TIMER_MAX_CNT_VAL 0x00FFFFFF
 #define COMPAT_NRF_LOG_INFO(arg, ...) NRF_LOG_INFO(arg "\n", ##__VA_ARGS__)
 #endif
 
+// RTC ticks of the app_timer per second.
+#define COMPAT_APP_TIMER_FREQUENCY (32768 / (COMPAT_APP_TIMER_PRESCALER + 1))
+
+// RTC ticks of the app_timer to milliseconds.
+#define COMPAT_APP_TIMER_TICKS_TO_MS(TICKS) \
+    ((uint32_t)(((uint64_t)(TICKS) * 1000 * (COMPAT_APP_TIMER_PRESCALER + 1)) / 32768))
+
 #endif
@@ -0,0 +1,168 @@
+#include "ble_stack.h"
+#include "power_governor.h"
+
+#if defined(POWER_GOVERNOR) && POWER_GOVERNOR == 1
+
+#if !defined(BATTERY_LEVEL) || BATTERY_LEVEL != 1
+#error "POWER_GOVERNOR needs the battery readings of HAS_BATTERY=1"
+#endif
+
+typedef struct {
+    uint8_t interval_factor;
+    uint8_t tx_drop;
+    uint16_t duration_s;
+} power_governor_step_t;
+
+static const power_governor_step_t m_steps[POWER_GOVERNOR_LEVELS] = {
+    {1, 0, 0},
+    {POWER_GOVERNOR_MEDIUM_INTERVAL_FACTOR, POWER_GOVERNOR_MEDIUM_TX_DROP, POWER_GOVERNOR_MEDIUM_DURATION},
+    {POWER_GOVERNOR_LOW_INTERVAL_FACTOR, POWER_GOVERNOR_LOW_TX_DROP, POWER_GOVERNOR_LOW_DURATION},
+    {POWER_GOVERNOR_CRITICAL_INTERVAL_FACTOR, POWER_GOVERNOR_CRITICAL_TX_DROP, POWER_GOVERNOR_CRITICAL_DURATION},
+};
+
+// Share of the capacity the battery spends at each status, in percent, see set_battery().
+static const uint8_t m_capacity_percent[POWER_GOVERNOR_LEVELS] = {
+    100 - BATTERY_FULL_ABOVE,
+    BATTERY_FULL_ABOVE - BATTERY_MEDIUM_ABOVE,
+    BATTERY_MEDIUM_ABOVE - BATTERY_LOW_ABOVE,
+    BATTERY_LOW_ABOVE,
+};
+
+static const char *const m_level_names[POWER_GOVERNOR_LEVELS] = {"FULL", "MEDIUM", "LOW", "CRITICAL"};
+
+typedef struct {
+    int8_t dbm;
+    uint16_t ua;
+} tx_current_t;
+
+// Radio TX current at each power level, in uA.
+static const tx_current_t m_tx_currents[] = {
+#if defined(NRF51)
+    {-30, 5500}, {-20, 6700}, {-16, 7100}, {-12, 7600}, {-8, 8200}, {-4, 9000}, {0, 10500}, {4, 16000},
+#elif defined(HAS_DCDC)
+    {-40, 2700}, {-20, 3200}, {-16, 3300}, {-12, 3500}, {-8, 3800}, {-4, 4200}, {0, 5300}, {3, 7000}, {4, 7500},
+#else
+    {-40, 5900}, {-20, 7000}, {-16, 7300}, {-12, 7700}, {-8, 8400}, {-4, 9300}, {0, 11600}, {3, 15000}, {4, 16600},
+#endif
+};
+
+#define TX_CURRENTS (sizeof(m_tx_currents) / sizeof(m_tx_currents[0]))
+
+#define INTERVAL_MAX_MS ((uint32_t)BLE_GAP_ADV_INTERVAL_MAX * 5 / 8)
+
+power_governor_stats_t power_governor_stats;
+
+static ble_adv_config_t m_base;
+static uint32_t m_restart_period_s;
+
+static uint32_t tx_current_ua(int8_t tx_power)
+{
+    uint32_t ua = m_tx_currents[0].ua;
+    for (uint8_t i = 0; i < TX_CURRENTS && m_tx_currents[i].dbm <= tx_power; i++)
+    {
+        ua = m_tx_currents[i].ua;
+    }
+    return ua;
+}
+
+// Average radio TX current of an advertising event at tx_power, over the TX power schedule.
+static uint32_t event_tx_current_ua(int8_t tx_power)
+{
+#if defined(ADV_FULL_POWER_EVERY)
+    return (tx_current_ua(tx_power) + (ADV_FULL_POWER_EVERY - 1) * tx_current_ua(ble_adv_low_tx_power(tx_power))) /
+           ADV_FULL_POWER_EVERY;
+#else
+    return tx_current_ua(tx_power);
+#endif
+}
+
+static void step_config(uint8_t level, ble_adv_config_t *p_config)
+{
+    const power_governor_step_t *p_step = &m_steps[level];
+
+    *p_config = m_base;
+    p_config->interval_ms = MIN((uint32_t)m_base.interval_ms * p_step->interval_factor, INTERVAL_MAX_MS);
+    p_config->tx_power = ble_tx_power_at_most(m_base.tx_power - p_step->tx_drop);
+
+    // Without restarts, advertising would stop for good once the duration ran out.
+    if (p_step->duration_s > 0 && m_restart_period_s > 0 &&
+        (m_base.duration_s == 0 || p_step->duration_s < m_base.duration_s))
+    {
+        p_config->duration_s = p_step->duration_s;
+    }
+}
+
+static uint32_t config_current_na(const ble_adv_config_t *p_config)
+{
+    uint32_t channels = p_config->channels == ADV_CHANNELS_ALL ? 3 : 1;
+    // us times uA is pC.
+    uint32_t event_nc = POWER_GOVERNOR_EVENT_NC + channels * ADV_CHANNEL_RADIO_US * event_tx_current_ua(p_config->tx_power) / 1000;
+    uint64_t adv_na = (uint64_t)event_nc * 1000 / p_config->interval_ms;
+
+    if (p_config->duration_s > 0)
+    {
+        adv_na = adv_na * MIN(p_config->duration_s, m_restart_period_s) / m_restart_period_s;
+    }
+
+    return POWER_GOVERNOR_SLEEP_NA + (uint32_t)adv_na;
+}
+
+static uint32_t lifetime_hours(uint32_t current_na, uint8_t capacity_percent)
+{
+    return (uint64_t)POWER_GOVERNOR_CAPACITY_MAH * 1000000 * capacity_percent / 100 / current_na;
+}
+
+void power_governor_init(uint32_t restart_period_s)
+{
+    ble_adv_config_get(&m_base);
+    m_restart_period_s = restart_period_s;
+
+    uint32_t total_hours = 0;
+    for (uint8_t level = 0; level < POWER_GOVERNOR_LEVELS; level++)
+    {
+        ble_adv_config_t config;
+        step_config(level, &config);
+
+        power_governor_stats.current_na[level] = config_current_na(&config);
+        power_governor_stats.lifetime_hours[level] =
+            lifetime_hours(power_governor_stats.current_na[level], m_capacity_percent[level]);
+        total_hours += power_governor_stats.lifetime_hours[level];
+
+        COMPAT_NRF_LOG_INFO("[GOVERNOR] %s: every %d ms at %d dBm for %d s (0: always), %d uA, %d days on %d%% of the battery",
+                            m_level_names[level], config.interval_ms, config.tx_power, config.duration_s,
+                            power_governor_stats.current_na[level] / 1000, power_governor_stats.lifetime_hours[level] / 24,
+                            m_capacity_percent[level]);
+    }
+
+    power_governor_stats.lifetime_hours_fixed = lifetime_hours(power_governor_stats.current_na[0], 100);
+    power_governor_stats.level = 0;
+
+    COMPAT_NRF_LOG_INFO("[GOVERNOR] Projected lifetime on %d mAh: %d days, %d days without the governor",
+                        POWER_GOVERNOR_CAPACITY_MAH, total_hours / 24, power_governor_stats.lifetime_hours_fixed / 24);
+}
+
+bool power_governor_update(uint8_t battery_status, ble_adv_config_t *p_config)
+{
+    uint8_t level = (battery_status & STATUS_FLAG_BATTERY_MASK) >> 6;
+
+    if (level == power_governor_stats.level)
+    {
+        return false;
+    }
+
+    power_governor_stats.level = level;
+    power_governor_stats.changes++;
+    step_config(level, p_config);
+
+    COMPAT_NRF_LOG_INFO("[GOVERNOR] Battery %s: every %d ms at %d dBm for %d s (0: always) from the next key",
+                        m_level_names[level], p_config->interval_ms, p_config->tx_power, p_config->duration_s);
+    return true;
+}
+
+void power_governor_rebase(ble_adv_config_t *p_config)
+{
+    m_base = *p_config;
+    step_config(power_governor_stats.level, p_config);
+}
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef _POWER_GOVERNOR_H_
+#define _POWER_GOVERNOR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "battery_curve.h"
+
+// ble_adv_config_t comes from ble_stack.h, include it first.
+
+#if defined(POWER_GOVERNOR) && POWER_GOVERNOR == 1
+
+// Steps the governor takes at each battery status, from the advertising
+// configuration at boot: the interval is multiplied by the factor, the TX
+// power lowered by the drop in dB (to the next level the radio supports), and
+// with a duration advertising only runs for that many seconds after each key
+// and burst. The MEDIUM steps apply at STATUS_FLAG_MEDIUM_BATTERY, and so on.
+#ifndef POWER_GOVERNOR_MEDIUM_INTERVAL_FACTOR
+#define POWER_GOVERNOR_MEDIUM_INTERVAL_FACTOR 2
+#endif
+#ifndef POWER_GOVERNOR_MEDIUM_TX_DROP
+#define POWER_GOVERNOR_MEDIUM_TX_DROP 0
+#endif
+#ifndef POWER_GOVERNOR_MEDIUM_DURATION
+#define POWER_GOVERNOR_MEDIUM_DURATION 0
+#endif
+
+#ifndef POWER_GOVERNOR_LOW_INTERVAL_FACTOR
+#define POWER_GOVERNOR_LOW_INTERVAL_FACTOR 2
+#endif
+#ifndef POWER_GOVERNOR_LOW_TX_DROP
+#define POWER_GOVERNOR_LOW_TX_DROP 4
+#endif
+#ifndef POWER_GOVERNOR_LOW_DURATION
+#define POWER_GOVERNOR_LOW_DURATION 0
+#endif
+
+#ifndef POWER_GOVERNOR_CRITICAL_INTERVAL_FACTOR
+#define POWER_GOVERNOR_CRITICAL_INTERVAL_FACTOR 2
+#endif
+#ifndef POWER_GOVERNOR_CRITICAL_TX_DROP
+#define POWER_GOVERNOR_CRITICAL_TX_DROP 4
+#endif
+#ifndef POWER_GOVERNOR_CRITICAL_DURATION
+#define POWER_GOVERNOR_CRITICAL_DURATION 60
+#endif
+
+_Static_assert(POWER_GOVERNOR_MEDIUM_INTERVAL_FACTOR > 0 && POWER_GOVERNOR_LOW_INTERVAL_FACTOR > 0 &&
+                   POWER_GOVERNOR_CRITICAL_INTERVAL_FACTOR > 0,
+               "POWER_GOVERNOR_*_INTERVAL_FACTOR must be at least 1.");
+_Static_assert(POWER_GOVERNOR_MEDIUM_DURATION <= BLE_ADV_DURATION_MAX_S && POWER_GOVERNOR_LOW_DURATION <= BLE_ADV_DURATION_MAX_S &&
+                   POWER_GOVERNOR_CRITICAL_DURATION <= BLE_ADV_DURATION_MAX_S,
+               "POWER_GOVERNOR_*_DURATION is longer than the SoftDevice can advertise for.");
+
+// Battery capacity the lifetime is projected from, in mAh.
+#ifndef POWER_GOVERNOR_CAPACITY_MAH
+#if BATTERY_CURVE == BATTERY_CURVE_CR2477 || BATTERY_CURVE == BATTERY_CURVE_AAA2
+#define POWER_GOVERNOR_CAPACITY_MAH 1000
+#elif BATTERY_CURVE == BATTERY_CURVE_LIPO
+#define POWER_GOVERNOR_CAPACITY_MAH 500
+#else
+#define POWER_GOVERNOR_CAPACITY_MAH 225
+#endif
+#endif
+
+// Current model of the projection: the sleep current with the RTC running,
+// and per advertising event a fixed charge for waking up the CPU and starting
+// the crystal, plus the radio at the TX current of its power level for
+// ADV_CHANNEL_RADIO_US per channel. Rough figures from the product
+// specifications, good for comparing the steps.
+#if defined(NRF51)
+#define POWER_GOVERNOR_SLEEP_NA 3000
+#define POWER_GOVERNOR_EVENT_NC 7000
+#else
+#define POWER_GOVERNOR_SLEEP_NA 2000
+#define POWER_GOVERNOR_EVENT_NC 5000
+#endif
+
+// Battery status levels, STATUS_FLAG_*_BATTERY >> 6.
+#define POWER_GOVERNOR_LEVELS 4
+
+typedef struct {
+    uint8_t level;                                      // Step in use, 0 (full) to 3 (critically low)
+    uint32_t changes;                                   // Times the step changed
+    uint32_t current_na[POWER_GOVERNOR_LEVELS];         // Projected average current of each step
+    uint32_t lifetime_hours[POWER_GOVERNOR_LEVELS];     // Time spent in each step, its share of the capacity
+    uint32_t lifetime_hours_fixed;                      // Lifetime at the boot configuration throughout
+} power_governor_stats_t;
+
+extern power_governor_stats_t power_governor_stats;
+
+/**@brief Function for setting up the governor with the advertising configuration at boot.
+ *
+ * @details Logs the configuration and projected lifetime of every step.
+ *
+ * @param[in] restart_period_s  Seconds between the restarts of advertising by the wake-up
+ *                              timer, with every key or burst; 0 if it doesn't run, and the
+ *                              steps can't limit the advertising duration.
+ */
+void power_governor_init(uint32_t restart_period_s);
+
+/**@brief Function for following a new battery status.
+ *
+ * @param[in]  battery_status  STATUS_FLAG_*_BATTERY bits of the status byte.
+ * @param[out] p_config        Advertising configuration of the new step.
+ *
+ * @return true if the step changed, and p_config is to be switched to.
+ */
+bool power_governor_update(uint8_t battery_status, ble_adv_config_t *p_config);
+
+/**@brief Function for stepping from another configuration than the one at boot.
+ *
+ * @details For the advertising schedule. The projections stay the ones of the
+ *          boot configuration.
+ *
+ * @param[in,out] p_config  Configuration to step from, replaced with the one of the current step.
+ */
+void power_governor_rebase(ble_adv_config_t *p_config);
+
+#endif
+
+#endif
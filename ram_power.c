@@ -0,0 +1,45 @@
+#include "ble_stack.h"
+#include "ram_power.h"
+
+#if defined(RAM_POWER_DOWN) && RAM_POWER_DOWN == 1
+
+#if NRF_SDK_VERSION < 15
+#error "RAM_POWER_DOWN needs POWER->RAM[n] (nRF52 targets)"
+#endif
+
+#include "nrf_soc.h"
+
+// End of the RAM in use and of RAM, see the end of the linker scripts.
+extern uint8_t __ram_used_end[];
+extern uint8_t __ram_end[];
+
+ram_power_stats_t ram_power_stats;
+
+void ram_power_down_unused(void)
+{
+    uint32_t used_end = (uint32_t)(uintptr_t)__ram_used_end;
+    uint32_t ram_end = (uint32_t)(uintptr_t)__ram_end;
+
+    // The section holding the top of the stack stays on.
+    uint32_t first = (used_end - RAM_POWER_BASE + RAM_POWER_SECTION_SIZE - 1) / RAM_POWER_SECTION_SIZE;
+    uint32_t sections = (ram_end - RAM_POWER_BASE) / RAM_POWER_SECTION_SIZE;
+
+    for (uint32_t section = first; section < sections; section++)
+    {
+        uint32_t shift = section % RAM_POWER_SECTIONS_PER_BLOCK;
+        uint32_t err_code = sd_power_ram_power_clr(section / RAM_POWER_SECTIONS_PER_BLOCK,
+                                                   (POWER_RAM_POWER_S0POWER_Msk | POWER_RAM_POWER_S0RETENTION_Msk)
+                                                       << shift);
+        APP_ERROR_CHECK(err_code);
+    }
+
+    ram_power_stats.used_bytes = used_end - RAM_POWER_BASE;
+    ram_power_stats.sections = sections;
+    ram_power_stats.sections_off = sections > first ? sections - first : 0;
+
+    COMPAT_NRF_LOG_INFO("[RAM] %d of %d bytes in use, %d of %d sections of %d bytes powered down",
+                        ram_power_stats.used_bytes, ram_end - RAM_POWER_BASE, ram_power_stats.sections_off,
+                        sections, RAM_POWER_SECTION_SIZE);
+}
+
+#endif
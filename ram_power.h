@@ -0,0 +1,34 @@
+#ifndef _RAM_POWER_H_
+#define _RAM_POWER_H_
+
+#include <stdint.h>
+
+#include "nrf5x-compat.h"
+
+#if defined(RAM_POWER_DOWN) && RAM_POWER_DOWN == 1
+
+// nRF52 RAM is made of 8 KB blocks, POWER->RAM[n], of two 4 KB sections each
+// that can be powered and retained separately.
+#define RAM_POWER_BASE 0x20000000u
+#define RAM_POWER_SECTION_SIZE 0x1000u
+#define RAM_POWER_SECTIONS_PER_BLOCK 2
+
+typedef struct {
+    uint32_t used_bytes;        // RAM from the start of RAM up to the top of the stack
+    uint8_t sections_off;       // Sections powered down
+    uint8_t sections;           // Sections of the chip
+} ram_power_stats_t;
+
+extern ram_power_stats_t ram_power_stats;
+
+/**@brief Function for powering down the RAM the application doesn't use.
+ *
+ * @details Every 4 KB section above __ram_used_end, the top of the stack that
+ *          the linker scripts place behind the heap, is switched off and not
+ *          retained in System ON sleep. Needs the SoftDevice enabled.
+ */
+void ram_power_down_unused(void);
+
+#endif
+
+#endif
@@ -0,0 +1,229 @@
+#include "ble_stack.h"
+#include "rotation_journal.h"
+
+#if defined(ROTATION_JOURNAL) && ROTATION_JOURNAL == 1
+
+#include "app_scheduler.h"
+#include "nrf_soc.h"
+
+#if NRF_SDK_VERSION >= 15
+#include "nrf_sdh_soc.h"
+
+#define ROTATION_JOURNAL_SOC_OBSERVER_PRIO 1
+#endif
+
+// The last two flash pages, see the .rotation_journal section of the linker scripts.
+extern const uint8_t __start_rotation_journal[];
+extern const uint8_t __stop_rotation_journal[];
+
+#define JOURNAL_PAGES 2
+#define JOURNAL_PAGE_SIZE ((uint32_t)(__stop_rotation_journal - __start_rotation_journal) / JOURNAL_PAGES)
+#define JOURNAL_SLOTS (JOURNAL_PAGE_SIZE / sizeof(rotation_journal_record_t))
+
+typedef enum {
+    JOURNAL_OP_NONE,
+    JOURNAL_OP_WRITE,
+    JOURNAL_OP_ERASE,
+} journal_op_t;
+
+rotation_journal_stats_t rotation_journal_stats;
+
+static uint8_t m_page;          // Page the log is appended to
+static uint32_t m_slot;         // Next free slot of that page, JOURNAL_SLOTS once it is full
+static uint32_t m_written;      // Position of the last record in flash, UINT32_MAX for none
+static uint32_t m_wanted;       // Position the next record is going to hold
+static uint32_t m_next;         // Position the next record is queued at
+static uint32_t m_skipped;      // Positions skipped by resets, position minus elapsed rotations
+
+static journal_op_t m_op = JOURNAL_OP_NONE;
+// Source of the write in flight, the SoftDevice reads it when it gets to it.
+static rotation_journal_record_t m_record;
+
+static const rotation_journal_record_t *journal_page(uint8_t page)
+{
+    return (const rotation_journal_record_t *)(__start_rotation_journal + page * JOURNAL_PAGE_SIZE);
+}
+
+static bool record_valid(const rotation_journal_record_t *p_record)
+{
+    return (p_record->position ^ p_record->elapsed ^ ROTATION_JOURNAL_MAGIC) == p_record->check;
+}
+
+static bool record_erased(const rotation_journal_record_t *p_record)
+{
+    return p_record->position == UINT32_MAX && p_record->elapsed == UINT32_MAX && p_record->check == UINT32_MAX;
+}
+
+/**@brief Function for starting the next flash operation, if one is due and none is in flight.
+ */
+static void journal_next_op(void)
+{
+    uint32_t err_code;
+    journal_op_t op;
+
+    if (m_op != JOURNAL_OP_NONE || m_wanted == m_written)
+    {
+        return;
+    }
+
+    if (m_slot >= JOURNAL_SLOTS)
+    {
+        // The page is full, the log continues on the other one. Its records
+        // are older than any on this page.
+        const rotation_journal_record_t *p_next = journal_page(m_page ^ 1);
+        err_code = sd_flash_page_erase((uintptr_t)p_next / JOURNAL_PAGE_SIZE);
+        op = JOURNAL_OP_ERASE;
+    }
+    else
+    {
+        m_record.position = m_wanted;
+        m_record.elapsed = m_wanted - m_skipped;
+        m_record.check = m_record.position ^ m_record.elapsed ^ ROTATION_JOURNAL_MAGIC;
+        err_code = sd_flash_write((uint32_t *)&journal_page(m_page)[m_slot], (const uint32_t *)&m_record,
+                                  sizeof(m_record) / sizeof(uint32_t));
+        op = JOURNAL_OP_WRITE;
+    }
+
+    if (err_code == NRF_ERROR_BUSY)
+    {
+        // Another flash operation is pending, try again with the next rotation.
+        rotation_journal_stats.busy++;
+        return;
+    }
+    APP_ERROR_CHECK(err_code);
+    m_op = op;
+}
+
+// Completion of the flash operation in flight, run from the main loop.
+static void journal_evt_handler(void *p_event_data, uint16_t event_size)
+{
+    uint32_t evt_id = *(const uint32_t *)p_event_data;
+    bool success = evt_id == NRF_EVT_FLASH_OPERATION_SUCCESS;
+
+    switch (m_op)
+    {
+        case JOURNAL_OP_WRITE:
+            if (success)
+            {
+                m_written = m_record.position;
+                rotation_journal_stats.writes++;
+            }
+            // Never write over a slot the failed write may have touched.
+            if (success || !record_erased(&journal_page(m_page)[m_slot]))
+            {
+                m_slot++;
+            }
+            break;
+        case JOURNAL_OP_ERASE:
+            if (success)
+            {
+                m_page ^= 1;
+                m_slot = 0;
+                rotation_journal_stats.erases++;
+            }
+            break;
+        default:
+            return;
+    }
+    m_op = JOURNAL_OP_NONE;
+
+    if (success)
+    {
+        // A record queued while the erase or an older write was in flight.
+        journal_next_op();
+    }
+    else
+    {
+        // The SoftDevice couldn't fit the operation between radio events,
+        // try again with the next rotation.
+        rotation_journal_stats.errors++;
+    }
+}
+
+// SoC event interrupt: hand flash completions over to the main loop.
+static void journal_soc_evt(uint32_t evt_id)
+{
+    if (evt_id != NRF_EVT_FLASH_OPERATION_SUCCESS && evt_id != NRF_EVT_FLASH_OPERATION_ERROR)
+    {
+        return;
+    }
+
+    uint32_t err_code = app_sched_event_put(&evt_id, sizeof(evt_id), journal_evt_handler);
+    APP_ERROR_CHECK(err_code);
+}
+
+#if NRF_SDK_VERSION >= 15
+static void rotation_journal_on_soc_evt(uint32_t evt_id, void *p_context)
+{
+    journal_soc_evt(evt_id);
+}
+
+NRF_SDH_SOC_OBSERVER(m_rotation_journal_soc_observer, ROTATION_JOURNAL_SOC_OBSERVER_PRIO,
+                     rotation_journal_on_soc_evt, NULL);
+#else
+void rotation_journal_on_sys_evt(uint32_t evt_id)
+{
+    journal_soc_evt(evt_id);
+}
+#endif
+
+bool rotation_journal_init(uint32_t *p_position, uint32_t *p_elapsed)
+{
+    bool found = false;
+    uint32_t position = 0;
+    uint32_t elapsed = 0;
+
+    m_page = 0;
+    for (uint8_t page = 0; page < JOURNAL_PAGES; page++)
+    {
+        const rotation_journal_record_t *p_records = journal_page(page);
+        for (uint32_t slot = 0; slot < JOURNAL_SLOTS; slot++)
+        {
+            if (record_valid(&p_records[slot]) && (!found || p_records[slot].position > position))
+            {
+                found = true;
+                position = p_records[slot].position;
+                elapsed = p_records[slot].elapsed;
+                m_page = page;
+            }
+        }
+    }
+
+    // Append behind the last slot in use, valid or not.
+    const rotation_journal_record_t *p_records = journal_page(m_page);
+    m_slot = JOURNAL_SLOTS;
+    while (m_slot > 0 && record_erased(&p_records[m_slot - 1]))
+    {
+        m_slot--;
+    }
+
+    // An empty journal gets its first record with the first key.
+    m_written = found ? position : UINT32_MAX;
+    m_wanted = m_written;
+    m_next = found ? position + ROTATION_JOURNAL_BATCH : 0;
+    // The key resumed from goes on air at the time of the record, whatever
+    // the resets before skipped.
+    m_skipped = m_next - elapsed;
+    m_op = JOURNAL_OP_NONE;
+
+    COMPAT_NRF_LOG_INFO("[JOURNAL] %s position %d after %d rotations, page %d, slot %d of %d",
+                        found ? "Resuming at" : "Empty,", m_next, elapsed, m_page, m_slot, JOURNAL_SLOTS);
+
+    *p_position = m_next;
+    *p_elapsed = elapsed;
+    return found;
+}
+
+void rotation_journal_record(uint32_t position)
+{
+    if (position >= m_next)
+    {
+        m_wanted = position;
+        m_next = position + ROTATION_JOURNAL_BATCH;
+    }
+
+    // Also retries an operation turned down since the last rotation.
+    journal_next_op();
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef _ROTATION_JOURNAL_H_
+#define _ROTATION_JOURNAL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf5x-compat.h"
+
+#if defined(ROTATION_JOURNAL) && ROTATION_JOURNAL == 1
+
+// The journal holds the rotation position the firmware resumes from after a
+// reset, and the rotations elapsed up to then. It spans the last two flash
+// pages (see the .rotation_journal section of the linker scripts) and is a
+// log of 12 byte records, appended until the page is full:
+//
+//     word 0: position of the key on air when the record was queued
+//     word 1: rotations actually timed until then, without the keys skipped
+//             by resets
+//     word 2: word 0 ^ word 1 ^ ROTATION_JOURNAL_MAGIC
+//
+// Erased slots read as all ones. A record whose third word doesn't match (a
+// write cut short by a reset) is skipped. Once a page is full, the other page
+// is erased and the log continues there, so a page is erased once every
+// (page size / 12) records and the last record is never lost. The 8 byte
+// records of the format before, with another magic, are not read.
+#define ROTATION_JOURNAL_MAGIC 0x324E524Au  // "JRN2"
+
+// A record is written every ROTATION_JOURNAL_BATCH rotations, and the
+// rotation resumes a batch past its position: a reset skips at most that many
+// keys but never advertises one twice. The elapsed rotations resume from the
+// record as they are, and the first record after a reset holds them again,
+// so resets in a row never put the time ahead.
+#ifndef ROTATION_JOURNAL_BATCH
+#define ROTATION_JOURNAL_BATCH 4
+#endif
+
+typedef struct {
+    uint32_t position;
+    uint32_t elapsed;
+    uint32_t check;
+} rotation_journal_record_t;
+
+typedef struct {
+    uint32_t writes;    // Records written
+    uint32_t erases;    // Pages erased
+    uint32_t busy;      // Flash operations the SoftDevice turned down, retried later
+    uint32_t errors;    // Flash operations that timed out, retried later
+} rotation_journal_stats_t;
+
+extern rotation_journal_stats_t rotation_journal_stats;
+
+/**@brief Function for reading the journal.
+ *
+ * @details Only reads flash, so it can run before the SoftDevice is enabled.
+ *
+ * @param[out] p_position Position to resume the rotation from, 0 on an empty journal.
+ * @param[out] p_elapsed  Rotations timed until the last record, 0 on an empty journal.
+ *
+ * @return True if a valid record was found.
+ */
+bool rotation_journal_init(uint32_t *p_position, uint32_t *p_elapsed);
+
+/**@brief Function for noting the rotation position of the key going on air.
+ *
+ * @details Queues a record once the position reaches the one resumed from
+ *          the last record. Its elapsed rotations leave out the keys skipped
+ *          since the first boot.
+ *          The write is handed to the SoftDevice, which fits it between
+ *          radio events and reports back with a SoC event.
+ */
+void rotation_journal_record(uint32_t position);
+
+#if NRF_SDK_VERSION < 15
+/**@brief Function for handling the system events of the SoftDevice.
+ *
+ * @details Set with softdevice_sys_evt_handler_set() once the SoftDevice
+ *          handler is initialized. With SDK15 the journal registers itself as
+ *          a SoC observer instead.
+ */
+void rotation_journal_on_sys_evt(uint32_t evt_id);
+#endif
+
+#endif
+
+#endif
@@ -0,0 +1,276 @@
+#!/usr/bin/env python3
+"""
+Convert a keyfile produced by generate_keys.py into the table of advertising
+records the firmware reads (see adv_record_t in ble_stack.h).
+
+Each 28 byte advertisement key becomes a 37 byte record: the 6 byte random
+static address, least significant byte first, followed by the complete 31 byte
+Offline Finding advertising payload with a zero status byte. The firmware can
+then hand the record straight to the SoftDevice on every rotation.
+
+The records are preceded by an 8 byte header (see adv_keys_header_t in
+main.h) carrying the key count, so the firmware doesn't scan the table at
+boot. The table is written at the start of the key table region, which the
+linker scripts reserve from the end of the application to the end of flash
+and export as __start_adv_keys / __stop_adv_keys.
+
+For firmware built with ADV_SCHEDULE=1, --schedule appends a weekly advertising
+schedule behind the records (see adv_schedule.h): a 12 byte header carrying
+the local time of the patch, followed by one 6 byte entry per profile switch.
+"""
+
+import argparse
+import struct
+import subprocess
+import sys
+import time
+from pathlib import Path
+
+KEY_LEN = 28
+RECORD_ADDR_LEN = 6
+RECORD_DATA_LEN = 31
+RECORD_LEN = RECORD_ADDR_LEN + RECORD_DATA_LEN
+
+HEADER_MAGIC = b'HSKT'
+MASTER_MAGIC = b'HSKP'
+HEADER_VERSION = 1
+# Master public key and chain key, see tools/derive_keys.py.
+MASTER_LEN = 88
+HEADER_FORMAT = '<4sBBH'
+HEADER_LEN = struct.calcsize(HEADER_FORMAT)
+
+SCHEDULE_MAGIC = b'HSKS'
+SCHEDULE_VERSION = 1
+SCHEDULE_HEADER_FORMAT = '<4sBBhI'
+SCHEDULE_ENTRY_FORMAT = '<HHbB'
+SCHEDULE_MAX_ENTRIES = 64
+SCHEDULE_MAX_DRIFT_PPM = 1000
+SCHEDULE_TX_POWER_BOOT = 127
+SCHEDULE_OFF = 0x01
+# Advertising interval range of the SoftDevices; the firmware keeps its current
+# profile for an entry the radio can't do.
+SCHEDULE_INTERVAL_MS = (20, 10240)
+DAYS = ['mon', 'tue', 'wed', 'thu', 'fri', 'sat', 'sun']
+
+ADV_TEMPLATE_HEAD = bytes([
+    0x1e,        # Length (30)
+    0xff,        # Manufacturer Specific Data (type 0xff)
+    0x4c, 0x00,  # Company ID (Apple)
+    0x12, 0x19,  # Offline Finding type and length
+    0x00,        # State
+])
+
+
+def key_to_record(key):
+    """Build the advertising record for one 28 byte advertisement key."""
+    if len(key) != KEY_LEN:
+        raise ValueError(f"advertisement key must be {KEY_LEN} bytes, got {len(key)}")
+
+    addr = bytes([key[5], key[4], key[3], key[2], key[1], key[0] | 0b11000000])
+    data = ADV_TEMPLATE_HEAD + key[6:KEY_LEN] + bytes([
+        key[0] >> 6,  # First two bits
+        0x00,         # Hint
+    ])
+    assert len(data) == RECORD_DATA_LEN
+    return addr + data
+
+
+def read_keys(keyfile_content):
+    """Split a keyfile (count byte followed by the keys) into keys."""
+    keys = keyfile_content[1:]
+    if len(keys) % KEY_LEN != 0:
+        raise ValueError(f"keyfile size is not a multiple of {KEY_LEN} bytes after the count byte")
+    keys = [keys[i:i + KEY_LEN] for i in range(0, len(keys), KEY_LEN)]
+    if keyfile_content[0] != len(keys) % 256:
+        raise ValueError(f"keyfile count byte ({keyfile_content[0]}) does not match its {len(keys)} keys")
+    return keys
+
+
+def keys_header(count):
+    """Build the key table header for count keys."""
+    if not 0 < count <= 0xFFFF:
+        raise ValueError(f"key count out of range: {count}")
+    return struct.pack(HEADER_FORMAT, HEADER_MAGIC, HEADER_VERSION, RECORD_LEN, count)
+
+
+def keyfile_to_table(keyfile_content):
+    """Convert the content of a keyfile into the key table: header followed by the records.
+
+    The table has to be written at the start of the key table region.
+    """
+    keys = read_keys(keyfile_content)
+    return keys_header(len(keys)) + b''.join(key_to_record(key) for key in keys)
+
+
+def tagkey_to_table(tag_key):
+    """Build the table for firmware built with DERIVE_KEYS=1: header followed by the tag key of tools/derive_keys.py."""
+    if len(tag_key) != MASTER_LEN:
+        raise ValueError(f"tag key must be {MASTER_LEN} bytes, got {len(tag_key)}")
+    return struct.pack(HEADER_FORMAT, MASTER_MAGIC, HEADER_VERSION, MASTER_LEN, 1) + tag_key
+
+
+def parse_days(spec):
+    """Days of the week of a schedule line: daily, a day, a range like mon-fri, or a comma list of those."""
+    if spec == 'daily':
+        return list(range(7))
+    days = []
+    for part in spec.split(','):
+        first, _, last = part.partition('-')
+        if first not in DAYS or (last and last not in DAYS):
+            raise ValueError(f"unknown days: {part}")
+        first = DAYS.index(first)
+        last = DAYS.index(last) if last else first
+        days += [(first + i) % 7 for i in range((last - first) % 7 + 1)]
+    return days
+
+
+def parse_schedule(text):
+    """Parse a schedule file into sorted (minute of the week, interval_ms, tx_power, flags) entries.
+
+    One profile per line, until the next line's time:
+        mon-fri 07:00 interval=1000 tx=0
+        mon-fri 19:00 interval=4000 tx=-8
+        sat-sun 00:00 off
+    interval and tx default to the ones the firmware was built with, so a
+    line with neither goes back to those.
+    """
+    entries = {}
+    for number, line in enumerate(text.splitlines(), 1):
+        fields = line.split('#', 1)[0].split()
+        if not fields:
+            continue
+        try:
+            if len(fields) < 2:
+                raise ValueError("expected: days HH:MM [off|interval=ms tx=dBm]")
+            hours, minutes = (int(x) for x in fields[1].split(':'))
+            if not (0 <= hours < 24 and 0 <= minutes < 60):
+                raise ValueError(f"bad time: {fields[1]}")
+            interval, tx_power, flags = 0, SCHEDULE_TX_POWER_BOOT, 0
+            for field in fields[2:]:
+                key, _, value = field.partition('=')
+                if key == 'off' and not value:
+                    flags |= SCHEDULE_OFF
+                elif key == 'interval':
+                    interval = int(value)
+                    if not SCHEDULE_INTERVAL_MS[0] <= interval <= SCHEDULE_INTERVAL_MS[1]:
+                        raise ValueError(f"interval out of range {SCHEDULE_INTERVAL_MS}: {interval} ms")
+                elif key == 'tx':
+                    tx_power = int(value)
+                    if not -40 <= tx_power <= 8:
+                        raise ValueError(f"TX power out of range: {tx_power} dBm")
+                else:
+                    raise ValueError(f"unknown setting: {field}")
+            for day in parse_days(fields[0]):
+                start = (day * 24 + hours) * 60 + minutes
+                if start in entries:
+                    raise ValueError(f"{DAYS[day]} {fields[1]} is scheduled twice")
+                entries[start] = (start, interval, tx_power, flags)
+        except ValueError as e:
+            raise ValueError(f"schedule line {number}: {e}") from None
+    if not 0 < len(entries) <= SCHEDULE_MAX_ENTRIES:
+        raise ValueError(f"a schedule has 1 to {SCHEDULE_MAX_ENTRIES} entries, got {len(entries)}")
+    return [entries[start] for start in sorted(entries)]
+
+
+def schedule_block(text, provisioned, drift_ppm=0):
+    """Build the schedule the firmware reads behind the key table.
+
+    provisioned is the local time the tag starts from, in seconds since
+    1970-01-01 00:00 local time; drift_ppm how much faster its RTC runs.
+    """
+    entries = parse_schedule(text)
+    if not -SCHEDULE_MAX_DRIFT_PPM <= drift_ppm <= SCHEDULE_MAX_DRIFT_PPM:
+        raise ValueError(f"drift out of range: {drift_ppm} ppm")
+    return struct.pack(SCHEDULE_HEADER_FORMAT, SCHEDULE_MAGIC, SCHEDULE_VERSION, len(entries), drift_ppm,
+                       provisioned) + b''.join(struct.pack(SCHEDULE_ENTRY_FORMAT, *entry) for entry in entries)
+
+
+def local_time(unix_time, utc_offset_min=None):
+    """Local time in seconds since 1970-01-01 00:00 local time, at the UTC offset of this host by default."""
+    if utc_offset_min is None:
+        utc_offset_min = -(time.altzone if time.localtime(unix_time).tm_isdst > 0 else time.timezone) // 60
+    return unix_time + utc_offset_min * 60
+
+
+def key_region(elf, nm='arm-none-eabi-nm'):
+    """Return the (start, stop) flash addresses of the key table region of an application ELF."""
+    symbols = {}
+    output = subprocess.run([nm, str(elf)], check=True, capture_output=True, text=True).stdout
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) == 3 and fields[2] in ('__start_adv_keys', '__stop_adv_keys'):
+            symbols[fields[2]] = int(fields[0], 16)
+    if len(symbols) != 2:
+        raise ValueError(f"{elf} has no key table region (__start_adv_keys / __stop_adv_keys)")
+    return symbols['__start_adv_keys'], symbols['__stop_adv_keys']
+
+
+def patch_image(image, table, region):
+    """Write the key table into a flash image starting at address 0 (application merged with the SoftDevice)."""
+    start, stop = region
+    if len(table) > stop - start:
+        capacity = (stop - start - HEADER_LEN) // RECORD_LEN
+        raise ValueError(f"{(len(table) - HEADER_LEN) // RECORD_LEN} keys don't fit in the key table region "
+                         f"(0x{start:x}-0x{stop:x}, room for {capacity} keys)")
+    with open(image, 'r+b') as f:
+        f.seek(start)
+        f.write(table)
+        f.seek(start)
+        if f.read(len(table)) != table:
+            raise ValueError(f"the key table was not patched correctly into {image}")
+
+
+def add_schedule_arguments(parser):
+    """Add the options of the advertising schedule to an argument parser."""
+    parser.add_argument('--schedule', type=Path, help='Weekly advertising schedule to append, for firmware built with ADV_SCHEDULE=1')
+    parser.add_argument('--provisioned', type=int, default=None, help='Unix time the tag starts its clock from (default: now)')
+    parser.add_argument('--utc-offset', type=int, default=None, help='UTC offset of the schedule in minutes (default: the one of this host)')
+    parser.add_argument('--drift-ppm', type=int, default=0, help='How much faster the RTC of the tag runs, in ppm')
+
+
+def schedule_from_arguments(args):
+    """Schedule block of the parsed schedule options, empty without --schedule."""
+    if not args.schedule:
+        return b''
+    provisioned = args.provisioned if args.provisioned is not None else int(time.time())
+    return schedule_block(args.schedule.read_text(), local_time(provisioned, args.utc_offset), args.drift_ppm)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Convert a keyfile into the firmware key table (header and advertising records).')
+    parser.add_argument('keyfile', type=Path, help='Keyfile produced by generate_keys.py')
+    parser.add_argument('output', type=Path, nargs='?', help='Output file (default: stdout)')
+    parser.add_argument('--patch', type=Path, help='Flash image to write the key table into, instead of writing it to the output')
+    parser.add_argument('--elf', type=Path, help='Application ELF to read the key table region from (required with --patch)')
+    parser.add_argument('--nm', default='arm-none-eabi-nm', help='nm executable used to read the ELF symbols')
+    parser.add_argument('--derive', action='store_true', help='The keyfile is a tag key from derive_keys.py, for firmware built with DERIVE_KEYS=1')
+    add_schedule_arguments(parser)
+    args = parser.parse_args()
+
+    if args.derive:
+        try:
+            table = tagkey_to_table(args.keyfile.read_bytes())
+        except ValueError as e:
+            sys.exit(f"Error: {e}")
+    else:
+        table = keyfile_to_table(args.keyfile.read_bytes())
+    try:
+        table += schedule_from_arguments(args)
+    except ValueError as e:
+        sys.exit(f"Error: {e}")
+
+    if args.patch:
+        if not args.elf:
+            parser.error('--patch requires --elf')
+        try:
+            patch_image(args.patch, table, key_region(args.elf, args.nm))
+        except ValueError as e:
+            sys.exit(f"Error: {e}")
+    elif args.output:
+        args.output.write_bytes(table)
+    else:
+        sys.stdout.buffer.write(table)
+
+
+if __name__ == '__main__':
+    main()
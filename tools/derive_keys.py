@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""
+Key derivation for firmware built with DERIVE_KEYS=1.
+
+Instead of a table of precomputed advertisement keys, the tag stores the
+owner's master public key P = d * G and a 32 byte chain key, which is public
+material only. It derives one SECP224R1 advertisement key per rotation (see
+key_derivation.c):
+
+    for ctr in 0, 1, ...:
+        u = SHA-256(chain key || index (4 bytes, little endian) || ctr (1 byte))[:28]
+        if 0 < u < n: break             (big endian, n = order of secp224r1)
+    advertisement key = x coordinate of u * P (28 bytes, big endian)
+
+The master private key d never leaves the owner. This tool derives the
+private key of each rotation from it:
+
+    private key = u * d mod n
+
+Reading out the tag's flash gives the chain key, which links the keys of the
+tag past and future, but no private key: its location reports stay
+unreadable. The tool has no dependencies beyond the standard library; speed
+is not a concern for a few thousand keys.
+
+    derive_keys.py new-key owner.key tag.key   # write a fresh master key, and the tag's part of it
+    derive_keys.py keys owner.key -n 48 -s 0   # print keys 0 to 47
+
+Keep owner.key off the tag, flash tag.key with
+`make stflash-<target>-patched DERIVE_KEYS=1 ADV_KEYS_FILE=tag.key`.
+"""
+
+import argparse
+import base64
+import hashlib
+import os
+import sys
+from pathlib import Path
+
+CHAIN_KEY_LEN = 32
+KEY_LEN = 28
+# Master private key and chain key.
+OWNER_KEY_LEN = KEY_LEN + CHAIN_KEY_LEN
+# Master public key (x and y) and chain key, see DERIVE_MASTER_LEN in key_derivation.h.
+TAG_KEY_LEN = 2 * KEY_LEN + CHAIN_KEY_LEN
+
+# secp224r1 domain parameters (SEC 2, section 2.5.2)
+P = 0xFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF000000000000000000000001
+A = 0xFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEFFFFFFFFFFFFFFFFFFFFFFFE
+N = 0xFFFFFFFFFFFFFFFFFFFFFFFFFFFF16A2E0B8F03E13DD29455C5C2A3D
+G = (0xB70E0CBD6BB4BF7F321390B94A03C1D356C21122343280D6115C1D21,
+     0xBD376388B5F723FB4C22DFE6CD4375A05A07476444D5819985007E34)
+
+
+def _point_add(p1, p2):
+    if p1 is None:
+        return p2
+    if p2 is None:
+        return p1
+    (x1, y1), (x2, y2) = p1, p2
+    if x1 == x2:
+        if (y1 + y2) % P == 0:
+            return None
+        lam = (3 * x1 * x1 + A) * pow(2 * y1, -1, P) % P
+    else:
+        lam = (y2 - y1) * pow(x2 - x1, -1, P) % P
+    x3 = (lam * lam - x1 - x2) % P
+    return x3, (lam * (x1 - x3) - y1) % P
+
+
+def _scalar_mult(k, point=G):
+    result = None
+    while k:
+        if k & 1:
+            result = _point_add(result, point)
+        point = _point_add(point, point)
+        k >>= 1
+    return result
+
+
+def derive_scalar(chain_key, index):
+    """Derive the scalar u (an integer in [1, n)) for a rotation index, as the tag does."""
+    if len(chain_key) != CHAIN_KEY_LEN:
+        raise ValueError(f"chain key must be {CHAIN_KEY_LEN} bytes, got {len(chain_key)}")
+    for ctr in range(256):
+        digest = hashlib.sha256(chain_key + index.to_bytes(4, 'little') + bytes([ctr])).digest()
+        u = int.from_bytes(digest[:KEY_LEN], 'big')
+        if 0 < u < N:
+            return u
+    raise ValueError(f"no valid scalar for index {index}")
+
+
+def split_owner_key(owner_key):
+    """Return the master private key and the chain key of an owner key file."""
+    if len(owner_key) != OWNER_KEY_LEN:
+        raise ValueError(f"owner key must be {OWNER_KEY_LEN} bytes, got {len(owner_key)}")
+    d = int.from_bytes(owner_key[:KEY_LEN], 'big')
+    if not 0 < d < N:
+        raise ValueError("master private key out of range")
+    return d, owner_key[KEY_LEN:]
+
+
+def tag_key(owner_key):
+    """Return the tag's part of an owner key: the master public key and the chain key."""
+    d, chain_key = split_owner_key(owner_key)
+    x, y = _scalar_mult(d)
+    return x.to_bytes(KEY_LEN, 'big') + y.to_bytes(KEY_LEN, 'big') + chain_key
+
+
+def derive_key(owner_key, index):
+    """Return (private key, advertisement key) for a rotation index, both 28 bytes big endian."""
+    d, chain_key = split_owner_key(owner_key)
+    private_key = derive_scalar(chain_key, index) * d % N
+    x, _ = _scalar_mult(private_key)
+    return private_key.to_bytes(KEY_LEN, 'big'), x.to_bytes(KEY_LEN, 'big')
+
+
+def new_owner_key():
+    """Return a fresh owner key: a random master private key and chain key."""
+    while True:
+        d = int.from_bytes(os.urandom(KEY_LEN), 'big')
+        if 0 < d < N:
+            return d.to_bytes(KEY_LEN, 'big') + os.urandom(CHAIN_KEY_LEN)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Create a master key for key derivation or derive its keys.')
+    sub = parser.add_subparsers(dest='command', required=True)
+
+    new_key = sub.add_parser('new-key', help='Write a new master key, and the part of it the tag stores')
+    new_key.add_argument('ownerfile', type=Path, help='master private key and chain key, keep it off the tag')
+    new_key.add_argument('tagfile', type=Path, help='master public key and chain key, flashed to the tag')
+
+    keys = sub.add_parser('keys', help='Print the keys derived from a master key')
+    keys.add_argument('ownerfile', type=Path)
+    keys.add_argument('-s', '--start', type=int, default=0, help='first rotation index')
+    keys.add_argument('-n', '--nkeys', type=int, default=1, help='number of keys')
+    args = parser.parse_args()
+
+    if args.command == 'new-key':
+        for path in (args.ownerfile, args.tagfile):
+            if path.exists():
+                sys.exit(f"Error: {path} already exists")
+        owner_key = new_owner_key()
+        args.ownerfile.write_bytes(owner_key)
+        args.tagfile.write_bytes(tag_key(owner_key))
+        print(f"Master key written to {args.ownerfile}, the tag's part to {args.tagfile}")
+        return
+
+    owner_key = args.ownerfile.read_bytes()
+    for index in range(args.start, args.start + args.nkeys):
+        priv, adv = derive_key(owner_key, index)
+        print('%d)' % index)
+        print('Private key: %s' % base64.b64encode(priv).decode('ascii'))
+        print('Advertisement key: %s' % base64.b64encode(adv).decode('ascii'))
+        print('Hashed adv key: %s' % base64.b64encode(hashlib.sha256(adv).digest()).decode('ascii'))
+
+
+if __name__ == '__main__':
+    main()
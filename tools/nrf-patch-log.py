@@ -12,6 +12,9 @@ import signal
 import time
 from datetime import datetime
 
+from adv_records import (keyfile_to_table, tagkey_to_table, key_region, patch_image,
+                         add_schedule_arguments, schedule_from_arguments)
+
 try:
     import serial
     from serial.tools import list_ports
@@ -140,6 +143,10 @@ def main():
     parser.add_argument('input_bin', type=Path, help='Input binary file to patch')
     parser.add_argument('keys_bin', type=Path, help='Advertising keys binary file')
     parser.add_argument('output_bin', type=Path, help='Output patched binary file (will also create output ELF file)')
+    parser.add_argument('--elf', type=Path, required=True, help='Application ELF (_build/<target>.out) the binary was built from, to locate the key table region.')
+    parser.add_argument('--nm', default='arm-none-eabi-nm', help='Path to nm executable.')
+    parser.add_argument('--derive', action='store_true', help='keys_bin is a tag key from derive_keys.py, for firmware built with DERIVE_KEYS=1.')
+    add_schedule_arguments(parser)
     parser.add_argument('--flash', action='store_true', help='Flash the device after patching.')
     parser.add_argument('--monitor', action='store_true', help='Monitor the device using GDB.')
     parser.add_argument('--flash-method', choices=['openocd', 'bmp'], default="bmp", help='Method to use for flashing the device.')
@@ -158,45 +165,27 @@ def main():
     # Copy the original binary file to create the patched binary file
     shutil.copyfile(input_file, output_file)
 
-    # Read the advertising keys file, skipping the first byte
-    adv_keys_content = adv_keys_file.read_bytes()[1:]  # Skip the first byte
-
-    # Read the original binary file to find the placeholder and end marker offsets
-    input_data = input_file.read_bytes()
-    placeholder = b'OFFLINEFINDINGPUBLICKEYHERE!'
-    end_marker = b'ENDOFKEYSENDOFKEYSENDOFKEYS!'
+    # Read the advertising keys file and convert the keys into the key table (header and records)
+    if args.derive:
+        adv_keys_content = tagkey_to_table(adv_keys_file.read_bytes())
+    else:
+        adv_keys_content = keyfile_to_table(adv_keys_file.read_bytes())
 
-    start_offset = input_data.find(placeholder)
-    if start_offset == -1:
-        print("Error: Placeholder string not found in the input file.")
+    # The schedule starts its clock now, flash right away with --flash
+    try:
+        adv_keys_content += schedule_from_arguments(args)
+    except ValueError as e:
+        print(f"Error: {e}")
         exit(1)
 
-    end_offset = input_data.find(end_marker, start_offset)
-
-    if end_offset == -1:
-        # End marker not found; warn user and proceed
-        print("Warning: End marker string not found in the input file.")
-        print("Proceeding without end marker; keys may overflow if they don't fit.")
-        # Assume available space is the remaining file after start_offset
-        available_space = len(input_data) - start_offset
-    else:
-        # End marker found; check if keys fit
-        available_space = end_offset - start_offset
-        if len(adv_keys_content) > available_space:
-            print("Error: Advertising keys content does not fit between the start and end markers.")
-            exit(1)
-
-    # Write the advertising keys content into the patched binary at the correct offset
-    with output_file.open('r+b') as f:
-        f.seek(start_offset)
-        f.write(adv_keys_content)
-
-        # Verify that the keys were patched correctly without reopening the file
-        f.seek(start_offset)
-        patched_keys = f.read(len(adv_keys_content))
-        if patched_keys != adv_keys_content:
-            print("The keys were not patched correctly!")
-            exit(1)
+    # Write the key table at the start of the key table region, which runs to the end of flash
+    try:
+        region = key_region(args.elf, args.nm)
+        print(f"Key table region: 0x{region[0]:x}-0x{region[1]:x}")
+        patch_image(output_file, adv_keys_content, region)
+    except (ValueError, subprocess.CalledProcessError) as e:
+        print(f"Error: {e}")
+        exit(1)
 
     # Convert the patched binary into an ELF file using objcopy
     objcopy = 'arm-none-eabi-objcopy'  # Assumes 'arm-none-eabi-objcopy' is in the system's PATH
@@ -0,0 +1,220 @@
+#include "ble_stack.h"
+#include "wakeup.h"
+
+#include "app_scheduler.h"
+
+wakeup_stats_t wakeup_stats;
+
+static app_timer_id_t m_timer_id;
+static wakeup_job_t m_jobs[WAKEUP_MAX_JOBS];
+static uint8_t m_job_count = 0;
+
+// Start of the next period of each job and time of the last wake-up, in
+// ticks since wakeup_start(), with the RTC counter at that wake-up.
+static uint64_t m_due[WAKEUP_MAX_JOBS];
+static uint64_t m_now = 0;
+static uint32_t m_last_cnt;
+
+// Whether any job in job_mask is due to run again.
+static bool any_due(const uint64_t *p_due, uint32_t job_mask)
+{
+    for (uint8_t i = 0; i < m_job_count; i++)
+    {
+        if ((job_mask & (1u << i)) && p_due[i] != WAKEUP_NEVER)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Time of the wake-up after now: the end of the earliest window of the jobs in
+// job_mask, or the longest sleep if that comes first.
+static uint64_t next_wakeup(const uint64_t *p_due, uint32_t job_mask, uint64_t now)
+{
+    uint64_t next = now + WAKEUP_MAX_SLEEP_TICKS;
+
+    for (uint8_t i = 0; i < m_job_count; i++)
+    {
+        if ((job_mask & (1u << i)) && p_due[i] != WAKEUP_NEVER)
+        {
+            next = MIN(next, p_due[i] + m_jobs[i].tolerance_ticks);
+        }
+    }
+
+    return MAX(next, now + APP_TIMER_MIN_TIMEOUT_TICKS);
+}
+
+// Jobs in job_mask whose window has opened by now. Their next period starts
+// on the grid of the first one, or the calendar of the job, after now.
+static uint32_t take_due(uint64_t *p_due, uint32_t job_mask, uint64_t now)
+{
+    uint32_t due = 0;
+
+    for (uint8_t i = 0; i < m_job_count; i++)
+    {
+        if ((job_mask & (1u << i)) && p_due[i] <= now)
+        {
+            due |= 1u << i;
+            if (m_jobs[i].p_next != NULL)
+            {
+                p_due[i] = m_jobs[i].p_next(now);
+                continue;
+            }
+            do
+            {
+                p_due[i] += m_jobs[i].period_ticks;
+            } while (p_due[i] <= now);
+        }
+    }
+
+    return due;
+}
+
+// Once no job is due again, the timer stays off.
+static void timer_start(void)
+{
+    if (!any_due(m_due, WAKEUP_ALL_JOBS))
+    {
+        return;
+    }
+
+    uint32_t err_code = app_timer_start(m_timer_id, (uint32_t)(next_wakeup(m_due, WAKEUP_ALL_JOBS, m_now) - m_now), NULL);
+    APP_ERROR_CHECK(err_code);
+}
+
+// Runs the jobs of a wake-up from the main loop, a single radio job among them.
+static void wakeup_evt_handler(void *p_event_data, uint16_t event_size)
+{
+    uint32_t due = *(const uint32_t *)p_event_data;
+    bool radio = false;
+
+    for (uint8_t i = 0; i < m_job_count; i++)
+    {
+        if (!(due & (1u << i)))
+        {
+            continue;
+        }
+
+        if (m_jobs[i].flags & WAKEUP_JOB_RADIO)
+        {
+            if (radio)
+            {
+                wakeup_stats.radio_merged++;
+                continue;
+            }
+            radio = true;
+        }
+
+        m_jobs[i].handler();
+    }
+}
+
+void wakeup_init(app_timer_id_t timer_id)
+{
+    m_timer_id = timer_id;
+}
+
+uint8_t wakeup_job_add(const wakeup_job_t *p_job)
+{
+    if (m_job_count >= WAKEUP_MAX_JOBS || (p_job->period_ticks == 0 && p_job->p_next == NULL))
+    {
+        APP_ERROR_CHECK(NRF_ERROR_INVALID_PARAM);
+    }
+
+    m_jobs[m_job_count] = *p_job;
+    return m_job_count++;
+}
+
+void wakeup_start(uint64_t day_ticks)
+{
+    m_now = 0;
+    m_last_cnt = COMPAT_APP_TIMER_CNT_GET();
+
+    for (uint8_t i = 0; i < m_job_count; i++)
+    {
+        m_due[i] = m_jobs[i].p_next != NULL ? m_jobs[i].p_next(0) : m_jobs[i].period_ticks;
+    }
+
+    if (m_job_count == 0)
+    {
+        COMPAT_NRF_LOG_INFO("[WAKEUP] No periodic jobs, the timer stays off");
+        return;
+    }
+
+    timer_start();
+
+    uint32_t separate = 0;
+    for (uint8_t i = 0; i < m_job_count; i++)
+    {
+        uint32_t wakeups = wakeup_count(1u << i, day_ticks);
+        separate += wakeups;
+        COMPAT_NRF_LOG_INFO("[WAKEUP] %s: %d wake-ups a day on its own", m_jobs[i].name, wakeups);
+    }
+    COMPAT_NRF_LOG_INFO("[WAKEUP] %d jobs: %d wake-ups a day, %d with a timer each",
+                        m_job_count, wakeup_count(WAKEUP_ALL_JOBS, day_ticks), separate);
+}
+
+void wakeup_timeout(void)
+{
+    uint32_t cnt = COMPAT_APP_TIMER_CNT_GET();
+    m_now += COMPAT_APP_TIMER_CNT_DIFF(cnt, m_last_cnt);
+    m_last_cnt = cnt;
+    wakeup_stats.wakeups++;
+
+    uint32_t due = take_due(m_due, WAKEUP_ALL_JOBS, m_now);
+    if (due == 0)
+    {
+        wakeup_stats.idle++;
+    }
+    else
+    {
+        uint8_t jobs = 0;
+        for (uint8_t i = 0; i < m_job_count; i++)
+        {
+            if (due & (1u << i))
+            {
+                wakeup_stats.runs[i]++;
+                jobs++;
+            }
+        }
+        if (jobs > 1)
+        {
+            wakeup_stats.shared += jobs;
+        }
+
+        uint32_t err_code = app_sched_event_put(&due, sizeof(due), wakeup_evt_handler);
+        APP_ERROR_CHECK(err_code);
+    }
+
+    timer_start();
+}
+
+uint64_t wakeup_time(void)
+{
+    return m_now;
+}
+
+uint32_t wakeup_count(uint32_t job_mask, uint64_t ticks)
+{
+    uint64_t due[WAKEUP_MAX_JOBS];
+    uint64_t now = m_now;
+    uint32_t wakeups = 0;
+
+    memcpy(due, m_due, sizeof(due));
+
+    // Without jobs due, the timer doesn't run.
+    while (any_due(due, job_mask))
+    {
+        now = next_wakeup(due, job_mask, now);
+        if (now > m_now + ticks)
+        {
+            return wakeups;
+        }
+        wakeups++;
+        take_due(due, job_mask, now);
+    }
+
+    return wakeups;
+}
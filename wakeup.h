@@ -0,0 +1,103 @@
+#ifndef _WAKEUP_H_
+#define _WAKEUP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf5x-compat.h"
+#include "app_timer.h"
+
+// Wake-up scheduler: the periodic work of the firmware (key rotation, bursts,
+// battery readings) shares one app_timer. Each job has a period and a
+// tolerance, how much later than its period it may run. The timer is set for
+// the end of the earliest window, and every job whose window has opened by
+// then runs in that wake-up, so jobs with overlapping windows cost one RTC
+// wake-up between them. Due times are kept in absolute RTC ticks since
+// wakeup_start(), so periods don't drift with the time the handlers take.
+//
+// The timer interrupt only queues the jobs due for the main loop. There they
+// run in the order they were added. Jobs flagged WAKEUP_JOB_RADIO restart
+// advertising, and only the first one due in a wake-up runs: the rotation
+// restarts advertising for the burst that falls on it too. Jobs that change
+// the advertising configuration go before it, so it takes their change
+// along with the new key.
+#define WAKEUP_MAX_JOBS 4
+
+#define WAKEUP_JOB_RADIO 0x01
+
+// All jobs, for wakeup_count().
+#define WAKEUP_ALL_JOBS ((1u << WAKEUP_MAX_JOBS) - 1)
+
+// Longest sleep in one go. The RTC counter is 24 bits; the margin keeps the
+// time it is read late from making it wrap between two wake-ups. Longer
+// periods take several wake-ups, the ones in between run no job.
+#define WAKEUP_MAX_SLEEP_TICKS (COMPAT_APP_TIMER_MAX_CNT_VAL - COMPAT_APP_TIMER_MAX_CNT_VAL / 16)
+
+typedef void (*wakeup_job_handler_t)(void);
+
+// Time of the next run of a job after ticks, for jobs on a calendar rather
+// than a period, or WAKEUP_NEVER. Called from the timer interrupt, and must
+// only depend on ticks. Once no job is due again, the timer stays off.
+typedef uint64_t (*wakeup_job_next_t)(uint64_t ticks);
+
+#define WAKEUP_NEVER UINT64_MAX
+
+typedef struct {
+    const char *name;
+    wakeup_job_handler_t handler;   // Runs from the main loop
+    uint64_t period_ticks;          // Unused with p_next
+    wakeup_job_next_t p_next;       // NULL for periodic jobs
+    uint64_t tolerance_ticks;       // How much later than its period the job may run
+    uint8_t flags;                  // WAKEUP_JOB_*
+} wakeup_job_t;
+
+typedef struct {
+    uint32_t wakeups;                   // Timer wake-ups
+    uint32_t idle;                      // Wake-ups that ran no job, within periods longer than one sleep
+    uint32_t runs[WAKEUP_MAX_JOBS];     // Wake-ups each job ran in
+    uint32_t shared;                    // Job runs in a wake-up along with another job
+    uint32_t radio_merged;              // Radio jobs left to another radio job of the same wake-up
+} wakeup_stats_t;
+
+extern wakeup_stats_t wakeup_stats;
+
+/**@brief Function for setting up the scheduler on a single-shot timer.
+ *
+ * @param[in] timer_id  Timer created in single-shot mode, whose handler calls wakeup_timeout().
+ */
+void wakeup_init(app_timer_id_t timer_id);
+
+/**@brief Function for adding a job, before wakeup_start().
+ *
+ * @return Index of the job in wakeup_stats.runs and the job masks.
+ */
+uint8_t wakeup_job_add(const wakeup_job_t *p_job);
+
+/**@brief Function for starting the timer. Every job first runs one period later.
+ *
+ * @details Logs the wake-ups a day, and how many the jobs would take with a timer each.
+ *
+ * @param[in] day_ticks  RTC ticks in a day.
+ */
+void wakeup_start(uint64_t day_ticks);
+
+/**@brief Function for handling the expiry of the timer, from its interrupt handler.
+ */
+void wakeup_timeout(void);
+
+/**@brief Function for getting the time of the last wake-up, the one the jobs running now are from.
+ *
+ * @return RTC ticks since wakeup_start().
+ */
+uint64_t wakeup_time(void);
+
+/**@brief Function for counting the wake-ups the scheduler takes from now on.
+ *
+ * @param[in] job_mask  Jobs to count, as if they were the only ones.
+ * @param[in] ticks     Time to count over.
+ *
+ * @return Wake-ups within ticks from the last one, idle ones included.
+ */
+uint32_t wakeup_count(uint32_t job_mask, uint64_t ticks);
+
+#endif